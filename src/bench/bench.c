@@ -0,0 +1,105 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint32_t state = 1;
+
+static const char *multibyte_words[] = {"\xC3\xA9t\xC3\xA9", "\xE4\xB8\xAD\xE6\x96\x87", "\xF0\x9F\x98\x80", "na\xC3\xAFve"};
+
+static const char *ascii_words[] = {"key", "value", "a", "sequence", "-", "42", "http://example.com/path", "#", "x: y"};
+
+#define WORD_COUNT(words) (sizeof(words) / sizeof(words[0]))
+
+double bench_seconds(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+uint64_t bench_cycles(){
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t low, high;
+	__asm__ __volatile__("rdtsc" : "=a"(low), "=d"(high));
+	return ((uint64_t)high << 32) | low;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+void bench_seed(uint32_t seed){
+	state = seed ? seed : 1;
+}
+
+uint32_t bench_random(uint32_t limit){
+	/* xorshift32 */
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return limit ? state % limit : state;
+}
+
+void bench_fill_text(char *dest, size_t length, uint32_t multibyte_percent){
+	size_t position = 0;
+	size_t line = 0;
+	if(length == 0){
+		return;
+	}
+	while(length - position > 1){
+		const char *word = bench_random(100) < multibyte_percent ? multibyte_words[bench_random(WORD_COUNT(multibyte_words))] : ascii_words[bench_random(WORD_COUNT(ascii_words))];
+		size_t word_length = strlen(word);
+		if(word_length + 1 > length - position - 1){
+			break;
+		}
+		memcpy(dest + position, word, word_length);
+		position += word_length;
+		line += word_length + 1;
+		dest[position++] = line > 72 ? '\n' : ' ';
+		if(line > 72){
+			line = 0;
+		}
+	}
+	/* pads with spaces, a space or a newline was written last */
+	while(position < length - 1){
+		dest[position++] = ' ';
+	}
+	dest[position] = '\n';
+}
+
+size_t bench_size_arg(int arg_count, const char **args, int index, size_t fallback){
+	if(index >= arg_count){
+		return fallback;
+	}
+	char *end;
+	size_t size = (size_t)strtoull(args[index], &end, 10);
+	switch(*end){
+	case 'G':
+	case 'g':
+		size *= 1024;
+		/* fall through */
+	case 'M':
+	case 'm':
+		size *= 1024;
+		/* fall through */
+	case 'K':
+	case 'k':
+		size *= 1024;
+		break;
+	default:
+		break;
+	}
+	return size ? size : fallback;
+}
+
+void *bench_alloc(size_t size){
+	void *result = malloc(size);
+	if(result == NULL){
+		fprintf(stderr, "unable to allocate %zu bytes\n", size);
+		exit(1);
+	}
+	return result;
+}
@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Helpers shared by the benchmark programs, which are built by make bench and not installed. Every program takes
+ * its sizes from the command line, defaulting to the ones quoted in the history, and prints one line per measurement.
+ */
+
+#define BENCH_MB (1024.0 * 1024.0)
+
+/*
+ * Seconds on a monotonic clock
+ */
+double bench_seconds();
+
+/*
+ * The time stamp counter where there is one, nanoseconds on a monotonic clock elsewhere
+ */
+uint64_t bench_cycles();
+
+/*
+ * A deterministic generator, so that runs of a benchmark see the same input
+ */
+void bench_seed(uint32_t seed);
+
+uint32_t bench_random(uint32_t limit);
+
+/*
+ * Fills dest with length bytes of UTF-8 text in lines of words, of which multibyte_percent are not ASCII.
+ * The text ends in a newline and never splits a character.
+ */
+void bench_fill_text(char *dest, size_t length, uint32_t multibyte_percent);
+
+/*
+ * Parses a size argument with an optional K, M or G suffix, returning fallback when there is no argument
+ */
+size_t bench_size_arg(int arg_count, const char **args, int index, size_t fallback);
+
+/*
+ * Allocates or exits with a message, the benchmarks have nothing to do without their buffers
+ */
+void *bench_alloc(size_t size);
+
+#endif
@@ -0,0 +1,87 @@
+#include "bench.h"
+
+#include "yambler_codec.h"
+
+#include <iconv.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Decodes mostly ASCII UTF-8 from memory with the native decoder and with iconv, in 64K character calls.
+ * Usage: bench_codec [size [multibyte percent [runs]]], 64M, 1 and 5 by default. The best run is reported.
+ */
+
+#define CODEC_CHARS 65536
+
+static size_t decode_native(const char *data, size_t length, yambler_char *buffer){
+	const yambler_byte *in = (const yambler_byte *)data;
+	size_t in_remainder = length;
+	size_t count = 0;
+	while(in_remainder != 0){
+		yambler_char *out = buffer;
+		size_t out_remainder = CODEC_CHARS;
+		if(yambler_codec_decode_utf8(&in, &in_remainder, &out, &out_remainder) == YAMBLER_CODEC_INVALID){
+			fprintf(stderr, "the native decoder rejected the input\n");
+			exit(1);
+		}
+		count += CODEC_CHARS - out_remainder;
+	}
+	return count;
+}
+
+static size_t decode_iconv(iconv_t converter, const char *data, size_t length, yambler_char *buffer){
+	char *in = (char *)data;
+	size_t in_remainder = length;
+	size_t count = 0;
+	iconv(converter, NULL, NULL, NULL, NULL);
+	while(in_remainder != 0){
+		char *out = (char *)buffer;
+		size_t out_remainder = CODEC_CHARS * 4;
+		if(iconv(converter, &in, &in_remainder, &out, &out_remainder) == (size_t)-1 && out_remainder == CODEC_CHARS * 4){
+			fprintf(stderr, "iconv rejected the input\n");
+			exit(1);
+		}
+		count += (CODEC_CHARS * 4 - out_remainder) / 4;
+	}
+	return count;
+}
+
+int main(int arg_count, const char **args){
+	size_t length = bench_size_arg(arg_count, args, 1, 64 * 1024 * 1024);
+	uint32_t multibyte_percent = (uint32_t)bench_size_arg(arg_count, args, 2, 1);
+	int runs = (int)bench_size_arg(arg_count, args, 3, 5);
+	char *data = bench_alloc(length);
+	uint32_t *buffer = bench_alloc(CODEC_CHARS * 4);
+	bench_fill_text(data, length, multibyte_percent);
+
+	iconv_t converter = iconv_open("UTF-32LE", "UTF-8");
+	if(converter == (iconv_t)-1){
+		fprintf(stderr, "iconv does not convert UTF-8 to UTF-32LE\n");
+		return 1;
+	}
+	double native_best = 0, iconv_best = 0;
+	size_t native_count = 0, iconv_count = 0;
+	for(int run = 0; run < runs; ++run){
+		double start = bench_seconds();
+		native_count = decode_native(data, length, (yambler_char *)buffer);
+		double native_time = bench_seconds() - start;
+		start = bench_seconds();
+		iconv_count = decode_iconv(converter, data, length, (yambler_char *)buffer);
+		double iconv_time = bench_seconds() - start;
+		if(run == 0 || native_time < native_best){
+			native_best = native_time;
+		}
+		if(run == 0 || iconv_time < iconv_best){
+			iconv_best = iconv_time;
+		}
+	}
+	iconv_close(converter);
+
+	/* iconv produces code points, the native decoder code units of the character build */
+	printf("input   %.1f MB, %u%% multibyte words, %zu characters\n", length / BENCH_MB, multibyte_percent, iconv_count);
+	printf("iconv   %8.1f MB/s\n", length / BENCH_MB / iconv_best);
+	printf("native  %8.1f MB/s (%zu %s)\n", length / BENCH_MB / native_best, native_count, sizeof(yambler_char) == 1 ? "bytes validated" : "characters");
+	free(buffer);
+	free(data);
+	return 0;
+}
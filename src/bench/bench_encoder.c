@@ -0,0 +1,154 @@
+#include "bench.h"
+
+#include "yambler_codec.h"
+#include "yambler_encoder.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+/*
+ * Encodes mostly ASCII characters to a UTF-8 file in 64K character calls with each target of the encoder: a write
+ * callback with a 4 KiB buffer, vectored writes of 16 such blocks and the mapped file, counting the system calls
+ * that write. Each target runs twice and the second run is reported. The file is removed at the end.
+ * Usage: bench_encoder [path [characters [multibyte percent]]], bench_encoder.out, 64M and 1 by default.
+ */
+
+#define ENCODER_BLOCK_SIZE 4096
+#define ENCODER_BLOCK_COUNT 16
+#define ENCODER_CHARS 65536
+#define ENCODER_PATTERN_SIZE (4 * 1024 * 1024)
+
+struct encoder_target{
+	int fd;
+	size_t writes;
+};
+
+static const char *path;
+
+static struct encoder_target target;
+
+static yambler_status open_file(yambler_encoder_state *state){
+	target.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	target.writes = 0;
+	*state = (yambler_encoder_state)&target;
+	return target.fd == -1 ? YAMBLER_ERROR : YAMBLER_OK;
+}
+
+static void close_file(yambler_encoder_state *state){
+	close(((struct encoder_target *)*state)->fd);
+	*state = NULL;
+}
+
+static yambler_status write_file(yambler_encoder_state state, const yambler_byte *buffer, size_t buffer_size, size_t *write_count){
+	struct encoder_target *file = (struct encoder_target *)state;
+	*write_count = 0;
+	while(*write_count < buffer_size){
+		ssize_t count = write(file->fd, buffer + *write_count, buffer_size - *write_count);
+		++file->writes;
+		if(count == -1){
+			return YAMBLER_ERROR;
+		}
+		*write_count += (size_t)count;
+	}
+	return YAMBLER_OK;
+}
+
+static yambler_status writev_file(yambler_encoder_state state, const struct iovec *vectors, int vector_count, size_t *write_count){
+	struct encoder_target *file = (struct encoder_target *)state;
+	size_t length = 0;
+	for(int i = 0; i < vector_count; ++i){
+		length += vectors[i].iov_len;
+	}
+	ssize_t count = writev(file->fd, vectors, vector_count);
+	++file->writes;
+	if(count == -1 || (size_t)count != length){
+		/* a regular file is not written short but for errors */
+		return YAMBLER_ERROR;
+	}
+	*write_count = length;
+	return YAMBLER_OK;
+}
+
+/*
+ * Encodes length characters, repeating the pattern, and returns the time it took including the creation of the encoder
+ */
+static double encode(int kind, const yambler_char *pattern, size_t pattern_length, size_t length){
+	yambler_encoder_p encoder;
+	double start = bench_seconds();
+	yambler_status status;
+	switch(kind){
+	case 0:
+		status = yambler_encoder_create(&encoder, NULL, ENCODER_BLOCK_SIZE, YAMBLER_ENCODING_UTF_8, 0, &write_file, NULL, &open_file, &close_file);
+		break;
+	case 1:
+		status = yambler_encoder_create_vectored(&encoder, NULL, ENCODER_BLOCK_SIZE, ENCODER_BLOCK_COUNT, YAMBLER_ENCODING_UTF_8, 0, &writev_file, NULL, &open_file, &close_file);
+		break;
+	default:
+		target.writes = 0;
+		status = yambler_encoder_create_to_file(&encoder, NULL, path, YAMBLER_ENCODING_UTF_8, 0);
+		break;
+	}
+	if(status == YAMBLER_OK){
+		status = yambler_encoder_open(encoder);
+		size_t position = 0;
+		size_t total = 0;
+		while(status == YAMBLER_OK && total < length){
+			size_t count = pattern_length - position < ENCODER_CHARS ? pattern_length - position : ENCODER_CHARS;
+			size_t write_count;
+			status = yambler_encoder_encode(encoder, pattern + position, count, &write_count);
+			/* a call that ends inside a character leaves it to the next one */
+			position += write_count;
+			total += write_count;
+			if(position == pattern_length){
+				position = 0;
+			}
+		}
+		if(status == YAMBLER_OK){
+			status = yambler_encoder_flush(encoder);
+		}
+		yambler_encoder_close(encoder);
+		yambler_encoder_destroy(&encoder);
+	}
+	if(status != YAMBLER_OK){
+		fprintf(stderr, "encoding failed with '%s'\n", yambler_status_message(status));
+		exit(1);
+	}
+	return bench_seconds() - start;
+}
+
+int main(int arg_count, const char **args){
+	static const char *names[] = {"callback, 4 KiB buffer ", "writev, 16 x 4 KiB     ", "mapped file            "};
+	path = arg_count > 1 ? args[1] : "bench_encoder.out";
+	size_t length = bench_size_arg(arg_count, args, 2, 64 * 1024 * 1024);
+	uint32_t multibyte_percent = (uint32_t)bench_size_arg(arg_count, args, 3, 1);
+
+	char *text = bench_alloc(ENCODER_PATTERN_SIZE);
+	yambler_char *pattern = bench_alloc(ENCODER_PATTERN_SIZE * sizeof(yambler_char));
+	bench_fill_text(text, ENCODER_PATTERN_SIZE, multibyte_percent);
+	const yambler_byte *in = (const yambler_byte *)text;
+	size_t in_remainder = ENCODER_PATTERN_SIZE;
+	yambler_char *out = pattern;
+	size_t out_remainder = ENCODER_PATTERN_SIZE;
+	yambler_codec_decode_utf8(&in, &in_remainder, &out, &out_remainder);
+	size_t pattern_length = ENCODER_PATTERN_SIZE - out_remainder;
+	free(text);
+
+	printf("input                     %.1f M characters, %u%% multibyte words\n", length / BENCH_MB, multibyte_percent);
+	for(int kind = 0; kind < 3; ++kind){
+		encode(kind, pattern, pattern_length, length);
+		double time = encode(kind, pattern, pattern_length, length);
+		off_t size = 0;
+		int fd = open(path, O_RDONLY);
+		if(fd != -1){
+			size = lseek(fd, 0, SEEK_END);
+			close(fd);
+		}
+		printf("%s %8.1f writes/MB %8.3f s\n", names[kind], size ? target.writes / (size / BENCH_MB) : 0.0, time);
+	}
+	unlink(path);
+	free(pattern);
+	return 0;
+}
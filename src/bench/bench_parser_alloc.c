@@ -0,0 +1,69 @@
+#include "bench.h"
+
+#include "yambler_allocator.h"
+#include "yambler_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Counts the allocations of the parser and of its input buffer in steady state. Comment lines are parsed twice with
+ * the same parser, and only the allocations after the first 1,000 events of a round are counted.
+ * Usage: bench_parser_alloc [lines], 100000 by default.
+ */
+
+#define ALLOC_WARM_UP_EVENTS 1000
+#define ALLOC_ROUNDS 2
+
+int main(int arg_count, const char **args){
+	size_t lines = bench_size_arg(arg_count, args, 1, 100000);
+	char *data = bench_alloc(lines * 32);
+	size_t length = 0;
+	for(size_t i = 0; i < lines; ++i){
+		length += (size_t)sprintf(data + length, "#%zu\n", i);
+	}
+
+	struct yambler_counting_allocator parser_counter;
+	yambler_counting_allocator_init(&parser_counter, NULL);
+	yambler_parser_p parser;
+	if(yambler_parser_create(&parser, &parser_counter.allocator)){
+		fprintf(stderr, "unable to create parser\n");
+		return 1;
+	}
+	for(int round = 1; round <= ALLOC_ROUNDS; ++round){
+		struct yambler_counting_allocator buffer_counter;
+		yambler_counting_allocator_init(&buffer_counter, NULL);
+		yambler_input_buffer_p buffer;
+		yambler_status status = yambler_input_buffer_create_from_memory(&buffer, &buffer_counter.allocator, NULL, (const yambler_byte *)data, length, YAMBLER_ENCODING_UTF_8);
+		if(status == YAMBLER_OK){
+			status = yambler_parser_open(parser, buffer);
+		}
+		struct yambler_parser_event event;
+		size_t events = 0;
+		struct yambler_allocator_stats parser_start = parser_counter.stats;
+		struct yambler_allocator_stats buffer_start = buffer_counter.stats;
+		while(status == YAMBLER_OK && (status = yambler_parser_parse(parser, &event)) == YAMBLER_OK){
+			if(++events == ALLOC_WARM_UP_EVENTS){
+				parser_start = parser_counter.stats;
+				buffer_start = buffer_counter.stats;
+			}
+		}
+		if(status != YAMBLER_EMPTY){
+			fprintf(stderr, "parsing ended with '%s'\n", yambler_status_message(status));
+			return 1;
+		}
+		printf("round %d  %8zu events  parser %zu allocations, %zu reallocations, %zu releases  input buffer %zu allocations\n",
+			round, events,
+			parser_counter.stats.allocations - parser_start.allocations,
+			parser_counter.stats.reallocations - parser_start.reallocations,
+			parser_counter.stats.releases - parser_start.releases,
+			buffer_counter.stats.allocations - buffer_start.allocations);
+		yambler_parser_close(parser);
+		yambler_input_buffer_destroy(&buffer);
+	}
+	yambler_parser_destroy(&parser);
+	printf("parser in all %zu allocations, %zu reallocations, %zu releases, %zu bytes left\n", parser_counter.stats.allocations, parser_counter.stats.reallocations, parser_counter.stats.releases, parser_counter.stats.bytes_in_use);
+	free(data);
+	return 0;
+}
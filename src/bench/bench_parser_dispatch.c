@@ -0,0 +1,100 @@
+#include "bench.h"
+
+#include "yambler_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Measures the cycles per byte of parsing from memory, an event at a time. Short comments make the dispatch of parser
+ * states the larger part of the work, long comments leave most of it to scanning. Cycles are read from the time stamp
+ * counter, and are nanoseconds where there is none. The best of the runs is reported.
+ * Usage: bench_parser_dispatch [short comments [long comments [runs [iterations]]]], 2M, 400K, 8 and 25 by default.
+ */
+
+struct dispatch_text{
+	char *data;
+	size_t length;
+};
+
+static void make_short_comments(struct dispatch_text *text, size_t count){
+	text->data = bench_alloc(count * 3);
+	text->length = 0;
+	for(size_t i = 0; i < count; ++i){
+		memcpy(text->data + text->length, "#n\n", 3);
+		text->length += 3;
+	}
+}
+
+static void make_long_comments(struct dispatch_text *text, size_t count){
+	text->data = bench_alloc(count * 202);
+	text->length = 0;
+	for(size_t i = 0; i < count; ++i){
+		size_t length = 10 + bench_random(191);
+		text->data[text->length++] = '#';
+		bench_fill_text(text->data + text->length, length, 0);
+		/* the text ends in a newline, the other lines of it are made spaces to keep a single comment */
+		for(size_t j = 0; j < length - 1; ++j){
+			if(text->data[text->length + j] == '\n'){
+				text->data[text->length + j] = ' ';
+			}
+		}
+		text->length += length;
+	}
+}
+
+static uint64_t parse(yambler_parser_p parser, const struct dispatch_text *text, int iterations){
+	uint64_t start = bench_cycles();
+	for(int i = 0; i < iterations; ++i){
+		yambler_input_buffer_p buffer;
+		yambler_status status = yambler_input_buffer_create_from_memory(&buffer, NULL, NULL, (const yambler_byte *)text->data, text->length, YAMBLER_ENCODING_UTF_8);
+		if(status == YAMBLER_OK){
+			status = yambler_parser_open(parser, buffer);
+		}
+		struct yambler_parser_event event;
+		while(status == YAMBLER_OK){
+			status = yambler_parser_parse(parser, &event);
+		}
+		if(status != YAMBLER_EMPTY){
+			fprintf(stderr, "parsing ended with '%s'\n", yambler_status_message(status));
+			exit(1);
+		}
+		yambler_parser_close(parser);
+		yambler_input_buffer_destroy(&buffer);
+	}
+	return bench_cycles() - start;
+}
+
+static void measure(const char *name, yambler_parser_p parser, const struct dispatch_text *text, int runs, int iterations){
+	uint64_t best = 0;
+	for(int run = 0; run < runs; ++run){
+		uint64_t cycles = parse(parser, text, iterations);
+		if(run == 0 || cycles < best){
+			best = cycles;
+		}
+	}
+	printf("%-16s %8.1f MB  %6.2f cycles/byte\n", name, text->length / BENCH_MB, (double)best / ((double)text->length * iterations));
+}
+
+int main(int arg_count, const char **args){
+	size_t short_count = bench_size_arg(arg_count, args, 1, 2 * 1000 * 1000);
+	size_t long_count = bench_size_arg(arg_count, args, 2, 400 * 1000);
+	int runs = (int)bench_size_arg(arg_count, args, 3, 8);
+	int iterations = (int)bench_size_arg(arg_count, args, 4, 25);
+	struct dispatch_text short_comments, long_comments;
+	make_short_comments(&short_comments, short_count);
+	make_long_comments(&long_comments, long_count);
+
+	yambler_parser_p parser;
+	if(yambler_parser_create(&parser, NULL)){
+		fprintf(stderr, "unable to create parser\n");
+		return 1;
+	}
+	measure("short comments", parser, &short_comments, runs, iterations);
+	measure("long comments", parser, &long_comments, runs, iterations);
+	yambler_parser_destroy(&parser);
+	free(short_comments.data);
+	free(long_comments.data);
+	return 0;
+}
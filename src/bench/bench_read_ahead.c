@@ -0,0 +1,118 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "bench.h"
+
+#include "yambler_decoder.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Decodes a UTF-8 file with the plain decoder and with the read-ahead decoder, first with the file dropped from the
+ * page cache by posix_fadvise and then again from the cache. Dropping only works for files that are not dirty, so the
+ * file is written and synced first, and removed at the end. A memory-backed file system keeps the file cached regardless.
+ * Usage: bench_read_ahead [path [size [multibyte percent]]], bench_read_ahead.txt, 144M and 50 by default.
+ */
+
+#define READ_AHEAD_BUFFER_SIZE (256 * 1024)
+#define READ_AHEAD_CHARS 65536
+
+static const char *path;
+
+static yambler_status open_file(yambler_decoder_state *state){
+	int fd = open(path, O_RDONLY);
+	if(fd == -1){
+		return YAMBLER_ERROR;
+	}
+	*state = (yambler_decoder_state)(intptr_t)fd;
+	return YAMBLER_OK;
+}
+
+static void close_file(yambler_decoder_state *state){
+	close((int)(intptr_t)*state);
+	*state = NULL;
+}
+
+static yambler_status read_file(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count){
+	ssize_t count = read((int)(intptr_t)state, buffer, buffer_size);
+	if(count == -1){
+		return YAMBLER_ERROR;
+	}
+	*read_count = (size_t)count;
+	return YAMBLER_OK;
+}
+
+static int write_file(size_t length, uint32_t multibyte_percent){
+	char *data = bench_alloc(length);
+	bench_fill_text(data, length, multibyte_percent);
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	size_t written = 0;
+	while(fd != -1 && written < length){
+		ssize_t count = write(fd, data + written, length - written);
+		if(count <= 0){
+			break;
+		}
+		written += (size_t)count;
+	}
+	free(data);
+	if(fd == -1 || written != length || fsync(fd) || close(fd)){
+		fprintf(stderr, "unable to write '%s'\n", path);
+		return 1;
+	}
+	return 0;
+}
+
+static void drop_cache(){
+	int fd = open(path, O_RDONLY);
+	if(fd != -1){
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
+
+static double decode(int read_ahead, yambler_char *buffer, size_t *total){
+	yambler_decoder_p decoder;
+	double start = bench_seconds();
+	yambler_status status = read_ahead
+		? yambler_decoder_create_with_read_ahead(&decoder, NULL, READ_AHEAD_BUFFER_SIZE, YAMBLER_ENCODING_UTF_8, &read_file, NULL, &open_file, &close_file)
+		: yambler_decoder_create(&decoder, NULL, READ_AHEAD_BUFFER_SIZE, YAMBLER_ENCODING_UTF_8, &read_file, NULL, &open_file, &close_file);
+	if(status == YAMBLER_OK){
+		status = yambler_decoder_open(decoder);
+		size_t count;
+		*total = 0;
+		while(status == YAMBLER_OK && (status = yambler_decoder_decode(decoder, buffer, READ_AHEAD_CHARS, &count)) == YAMBLER_OK && count != 0){
+			*total += count;
+		}
+		yambler_decoder_close(decoder);
+		yambler_decoder_destroy(&decoder);
+	}
+	if(status != YAMBLER_OK){
+		fprintf(stderr, "decoding failed with '%s'\n", yambler_status_message(status));
+		exit(1);
+	}
+	return bench_seconds() - start;
+}
+
+int main(int arg_count, const char **args){
+	path = arg_count > 1 ? args[1] : "bench_read_ahead.txt";
+	size_t length = bench_size_arg(arg_count, args, 2, 144 * 1024 * 1024);
+	uint32_t multibyte_percent = (uint32_t)bench_size_arg(arg_count, args, 3, 50);
+	if(write_file(length, multibyte_percent)){
+		return 1;
+	}
+	yambler_char *buffer = bench_alloc(READ_AHEAD_CHARS * sizeof(yambler_char));
+	size_t total;
+	printf("input        %.1f MB, %u%% multibyte words\n", length / BENCH_MB, multibyte_percent);
+	for(int read_ahead = 0; read_ahead < 2; ++read_ahead){
+		const char *name = read_ahead ? "read-ahead" : "plain     ";
+		drop_cache();
+		double cold = decode(read_ahead, buffer, &total);
+		double warm = decode(read_ahead, buffer, &total);
+		printf("%s   dropped %.3f s, cached %.3f s, %zu characters\n", name, cold, warm, total);
+	}
+	free(buffer);
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,121 @@
+#include "yambler_allocator.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+static void *default_allocate(void *state, size_t size){
+	(void)state;
+	return malloc(size);
+}
+
+static void *default_reallocate(void *state, void *data, size_t size){
+	(void)state;
+	return realloc(data, size);
+}
+
+static void default_release(void *state, void *data){
+	(void)state;
+	free(data);
+}
+
+static const struct yambler_allocator default_allocator = {&default_allocate, &default_reallocate, &default_release, NULL};
+
+const struct yambler_allocator *yambler_default_allocator(void){
+	return &default_allocator;
+}
+
+const struct yambler_allocator *yambler_allocator_or_default(const struct yambler_allocator *allocator){
+	return allocator ? allocator : &default_allocator;
+}
+
+void *yambler_allocate(const struct yambler_allocator *allocator, size_t size){
+	assert(allocator != NULL);
+	return (*allocator->allocate)(allocator->state, size);
+}
+
+void *yambler_reallocate(const struct yambler_allocator *allocator, void *data, size_t size){
+	assert(allocator != NULL);
+	return (*allocator->reallocate)(allocator->state, data, size);
+}
+
+void yambler_release(const struct yambler_allocator *allocator, void *data){
+	assert(allocator != NULL);
+	if(data){
+		(*allocator->release)(allocator->state, data);
+	}
+}
+
+/*
+ * The counting allocator prefixes every block with its size, padded so that the data stays aligned for any type
+ */
+
+union yambler_counting_header{
+	size_t size;
+	long double float_value;
+	long long int_value;
+	void *pointer;
+};
+
+#define HEADER_SIZE sizeof(union yambler_counting_header)
+
+static void count_allocation(struct yambler_counting_allocator *counter, size_t size){
+	counter->stats.bytes_in_use += size;
+	counter->stats.total_bytes += size;
+	if(counter->stats.bytes_in_use > counter->stats.peak_bytes_in_use){
+		counter->stats.peak_bytes_in_use = counter->stats.bytes_in_use;
+	}
+}
+
+static void *counting_allocate(void *state, size_t size){
+	struct yambler_counting_allocator *counter = (struct yambler_counting_allocator *)state;
+	union yambler_counting_header *header = yambler_allocate(counter->parent, HEADER_SIZE + size);
+	if(header == NULL){
+		return NULL;
+	}
+	header->size = size;
+	++counter->stats.allocations;
+	count_allocation(counter, size);
+	return header + 1;
+}
+
+static void *counting_reallocate(void *state, void *data, size_t size){
+	struct yambler_counting_allocator *counter = (struct yambler_counting_allocator *)state;
+	if(data == NULL){
+		return counting_allocate(state, size);
+	}
+	union yambler_counting_header *header = (union yambler_counting_header *)data - 1;
+	size_t old_size = header->size;
+	header = yambler_reallocate(counter->parent, header, HEADER_SIZE + size);
+	if(header == NULL){
+		return NULL;
+	}
+	header->size = size;
+	++counter->stats.reallocations;
+	counter->stats.bytes_in_use -= old_size;
+	count_allocation(counter, size);
+	return header + 1;
+}
+
+static void counting_release(void *state, void *data){
+	struct yambler_counting_allocator *counter = (struct yambler_counting_allocator *)state;
+	union yambler_counting_header *header = (union yambler_counting_header *)data - 1;
+	++counter->stats.releases;
+	counter->stats.bytes_in_use -= header->size;
+	yambler_release(counter->parent, header);
+}
+
+void yambler_counting_allocator_init(struct yambler_counting_allocator *counter, const struct yambler_allocator *parent){
+	assert(counter != NULL);
+
+	counter->allocator.allocate = &counting_allocate;
+	counter->allocator.reallocate = &counting_reallocate;
+	counter->allocator.release = &counting_release;
+	counter->allocator.state = counter;
+	counter->parent = yambler_allocator_or_default(parent);
+	counter->stats.allocations = 0;
+	counter->stats.reallocations = 0;
+	counter->stats.releases = 0;
+	counter->stats.bytes_in_use = 0;
+	counter->stats.peak_bytes_in_use = 0;
+	counter->stats.total_bytes = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef YAMBLER_ALLOCATOR_H
+#define YAMBLER_ALLOCATOR_H
+
+#include "yambler_type.h"
+
+#include <stddef.h>
+
+/*
+ * Every create function takes an allocator, which is used for all memory of the object it creates and
+ * of the objects created on its behalf. A NULL allocator selects the default one, which uses malloc, realloc and free.
+ * The allocator must outlive the objects created with it. The functions follow the contracts of malloc,
+ * realloc and free, the state is passed to each of them.
+ */
+
+struct yambler_allocator{
+	void *(*allocate)(void *state, size_t size);
+	void *(*reallocate)(void *state, void *data, size_t size);
+	void (*release)(void *state, void *data);
+	void *state;
+};
+
+const struct yambler_allocator *yambler_default_allocator(void);
+
+/*
+ * Resolves a NULL allocator to the default one
+ */
+const struct yambler_allocator *yambler_allocator_or_default(const struct yambler_allocator *allocator);
+
+void *yambler_allocate(const struct yambler_allocator *allocator, size_t size);
+
+void *yambler_reallocate(const struct yambler_allocator *allocator, void *data, size_t size);
+
+void yambler_release(const struct yambler_allocator *allocator, void *data);
+
+/*
+ * The counting allocator forwards to a parent allocator and keeps statistics on the memory passing through it,
+ * which attributes memory use to the objects created with it. It is not synchronized, objects created with it
+ * must be used from one thread at a time.
+ */
+
+struct yambler_allocator_stats{
+	size_t allocations;
+	size_t reallocations;
+	size_t releases;
+	size_t bytes_in_use;
+	size_t peak_bytes_in_use;
+	size_t total_bytes;
+};
+
+struct yambler_counting_allocator{
+	struct yambler_allocator allocator;
+	const struct yambler_allocator *parent;
+	struct yambler_allocator_stats stats;
+};
+
+/*
+ * Initializes a counting allocator on top of parent, NULL for the default allocator.
+ * Objects are created with &counter->allocator.
+ */
+void yambler_counting_allocator_init(struct yambler_counting_allocator *counter, const struct yambler_allocator *parent);
+
+#endif
@@ -0,0 +1,158 @@
+#include "yambler_arena.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The data of a block follows its header. The blocks behind current are reused in order after a reset,
+ * a block too small for an allocation is skipped and stays in the chain for later.
+ */
+
+union yambler_arena_align{
+	long double float_value;
+	long long int_value;
+	void *pointer;
+	void (*function)(void);
+};
+
+struct yambler_arena_align_probe{
+	char c;
+	union yambler_arena_align value;
+};
+
+#define ALIGNMENT offsetof(struct yambler_arena_align_probe, value)
+#define ALIGN(size) (((size) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+/* empty allocations take up space too, so that no two allocations share an address */
+#define ALLOCATION_SIZE(size) ((size) ? ALIGN(size) : ALIGNMENT)
+#define HEADER_SIZE ALIGN(sizeof(struct yambler_arena_block))
+#define BLOCK_DATA(block) ((char *)(block) + HEADER_SIZE)
+
+#define DEFAULT_BLOCK_SIZE 65536
+
+struct yambler_arena_block{
+	struct yambler_arena_block *next;
+	size_t size;
+};
+
+struct yambler_arena{
+	const struct yambler_allocator *allocator;
+	struct yambler_arena_block *first;
+	struct yambler_arena_block *current;
+	size_t offset;
+	void *last;
+	size_t block_size;
+};
+
+yambler_status yambler_arena_create(yambler_arena_p *dest, const struct yambler_allocator *allocator, size_t block_size){
+	assert(dest != NULL);
+
+	if(block_size == 0){
+		block_size = DEFAULT_BLOCK_SIZE;
+	}
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_arena_p arena = yambler_allocate(allocator, sizeof(struct yambler_arena));
+	if(arena == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	arena->allocator = allocator;
+	arena->first = NULL;
+	arena->current = NULL;
+	arena->offset = 0;
+	arena->last = NULL;
+	arena->block_size = ALIGN(block_size);
+	*dest = arena;
+	return YAMBLER_OK;
+}
+
+/*
+ * Makes current a block with at least size bytes free, moving on to a reused or a new block when needed
+ */
+static int yambler_arena_reserve(yambler_arena_p arena, size_t size){
+	if(arena->current && arena->current->size - arena->offset >= size){
+		return 1;
+	}
+	struct yambler_arena_block *previous = arena->current;
+	struct yambler_arena_block *block = previous ? previous->next : arena->first;
+	while(block && block->size < size){
+		previous = block;
+		block = block->next;
+	}
+	if(block == NULL){
+		size_t block_size = size > arena->block_size ? size : arena->block_size;
+		block = yambler_allocate(arena->allocator, HEADER_SIZE + block_size);
+		if(block == NULL){
+			return 0;
+		}
+		block->size = block_size;
+		block->next = NULL;
+		if(previous){
+			previous->next = block;
+		}else{
+			arena->first = block;
+		}
+	}
+	arena->current = block;
+	arena->offset = 0;
+	return 1;
+}
+
+void *yambler_arena_alloc(yambler_arena_p arena, size_t size){
+	assert(arena != NULL);
+
+	size = ALLOCATION_SIZE(size);
+	if(!yambler_arena_reserve(arena, size)){
+		return NULL;
+	}
+	void *data = BLOCK_DATA(arena->current) + arena->offset;
+	arena->offset += size;
+	arena->last = data;
+	return data;
+}
+
+void *yambler_arena_resize(yambler_arena_p arena, void *data, size_t old_size, size_t new_size){
+	assert(arena != NULL);
+
+	if(data == NULL){
+		return yambler_arena_alloc(arena, new_size);
+	}
+	if(data == arena->last){
+		size_t begin = (char *)data - BLOCK_DATA(arena->current);
+		if(arena->current->size - begin >= ALLOCATION_SIZE(new_size)){
+			arena->offset = begin + ALLOCATION_SIZE(new_size);
+			return data;
+		}
+	}
+	void *new_data = yambler_arena_alloc(arena, new_size);
+	if(new_data){
+		memcpy(new_data, data, old_size < new_size ? old_size : new_size);
+	}
+	return new_data;
+}
+
+void yambler_arena_reset(yambler_arena_p arena){
+	assert(arena != NULL);
+
+	arena->current = NULL;
+	arena->offset = 0;
+	arena->last = NULL;
+}
+
+void yambler_arena_destroy(yambler_arena_p *src){
+	assert(src != NULL);
+
+	yambler_arena_p arena = *src;
+
+	assert(arena != NULL);
+
+	struct yambler_arena_block *block = arena->first;
+	while(block){
+		struct yambler_arena_block *next = block->next;
+		yambler_release(arena->allocator, block);
+		block = next;
+	}
+	yambler_release(arena->allocator, arena);
+
+	*src = NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef YAMBLER_ARENA_H
+#define YAMBLER_ARENA_H
+
+#include "yambler_type.h"
+#include "yambler_allocator.h"
+
+#include <stddef.h>
+
+/*
+ * An arena hands out memory by bumping an offset through a chain of blocks. Allocations are not freed one by one,
+ * a reset releases all of them at once by rewinding to the first block. The blocks are kept for reuse, so an arena
+ * that has grown to the size of its largest document no longer allocates.
+ */
+
+struct yambler_arena;
+
+typedef struct yambler_arena * yambler_arena_p;
+
+yambler_status yambler_arena_create(yambler_arena_p *dest, const struct yambler_allocator *allocator, size_t block_size);
+
+/*
+ * Returns size bytes aligned for any type, or NULL when no block can be allocated.
+ */
+void *yambler_arena_alloc(yambler_arena_p arena, size_t size);
+
+/*
+ * Resizes an allocation from old_size to new_size bytes and returns its new address.
+ * The most recent allocation is resized in place when its block has room, any other is copied.
+ */
+void *yambler_arena_resize(yambler_arena_p arena, void *data, size_t old_size, size_t new_size);
+
+void yambler_arena_reset(yambler_arena_p arena);
+
+void yambler_arena_destroy(yambler_arena_p *src);
+
+#endif
@@ -0,0 +1,477 @@
+#define _GNU_SOURCE
+
+#include "yambler_async_file.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#define YAMBLER_ASYNC_FILE_URING
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#define BLOCK_ALIGNMENT 4096
+#define DEFAULT_BLOCK_SIZE (256 * 1024)
+#define DEFAULT_DEPTH 4
+
+struct yambler_async_file_slot{
+	void *block;
+	yambler_byte *data;
+	off_t offset;
+	size_t expected;
+	size_t filled;
+	int pending;
+};
+
+#ifdef YAMBLER_ASYNC_FILE_URING
+
+struct yambler_async_file_ring{
+	int fd;
+	void *sq_mapping;
+	size_t sq_mapping_size;
+	void *cq_mapping;
+	size_t cq_mapping_size;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned *sq_head;
+	unsigned *sq_tail;
+	unsigned *sq_mask;
+	unsigned *sq_array;
+
+	unsigned *cq_head;
+	unsigned *cq_tail;
+	unsigned *cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+#endif
+
+struct yambler_async_file{
+	const struct yambler_allocator *allocator;
+	char *path;
+	yambler_async_file_flag options;
+	size_t block_size;
+	size_t depth;
+	struct yambler_async_file_slot *slots;
+
+	int fd;
+	int uring;
+	int direct;
+	off_t size;
+	off_t next_offset;
+	size_t current;
+	size_t current_offset;
+	size_t pending;
+	int failed;
+
+#ifdef YAMBLER_ASYNC_FILE_URING
+	struct yambler_async_file_ring ring;
+#endif
+};
+
+yambler_status yambler_async_file_create(yambler_async_file_p *dest, const struct yambler_allocator *allocator, const char *path, size_t block_size, size_t depth, yambler_async_file_flag options){
+	assert(dest != NULL);
+	assert(path != NULL);
+
+	if(block_size == 0){
+		block_size = DEFAULT_BLOCK_SIZE;
+	}
+	block_size = ((block_size + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT) * BLOCK_ALIGNMENT;
+	if(depth == 0){
+		depth = DEFAULT_DEPTH;
+	}
+
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_async_file_p file = yambler_allocate(allocator, sizeof(struct yambler_async_file));
+	if(file == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	file->allocator = allocator;
+	file->path = yambler_allocate(allocator, strlen(path) + 1);
+	if(file->path == NULL){
+		yambler_release(allocator, file);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	strcpy(file->path, path);
+	file->slots = yambler_allocate(allocator, sizeof(struct yambler_async_file_slot) * depth);
+	if(file->slots == NULL){
+		yambler_release(allocator, file->path);
+		yambler_release(allocator, file);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	for(size_t i = 0; i < depth; ++i){
+		/* the allocator makes no promise beyond the alignment of malloc, the block is aligned within a larger allocation */
+		void *block = yambler_allocate(allocator, block_size + BLOCK_ALIGNMENT - 1);
+		if(block == NULL){
+			while(i != 0){
+				yambler_release(allocator, file->slots[--i].block);
+			}
+			yambler_release(allocator, file->slots);
+			yambler_release(allocator, file->path);
+			yambler_release(allocator, file);
+			return YAMBLER_ALLOC_ERROR;
+		}
+		file->slots[i].block = block;
+		file->slots[i].data = (yambler_byte *)(((uintptr_t)block + BLOCK_ALIGNMENT - 1) & ~(uintptr_t)(BLOCK_ALIGNMENT - 1));
+	}
+	file->options = options;
+	file->block_size = block_size;
+	file->depth = depth;
+	file->fd = -1;
+	file->uring = 0;
+	file->direct = 0;
+	*dest = file;
+	return YAMBLER_OK;
+}
+
+#ifdef YAMBLER_ASYNC_FILE_URING
+
+static int ring_setup(struct yambler_async_file_ring *ring, unsigned entries){
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if(fd < 0){
+		return -1;
+	}
+
+	ring->sq_mapping_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring->cq_mapping_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if(params.features & IORING_FEAT_SINGLE_MMAP){
+		if(ring->cq_mapping_size > ring->sq_mapping_size){
+			ring->sq_mapping_size = ring->cq_mapping_size;
+		}
+		ring->cq_mapping_size = ring->sq_mapping_size;
+	}
+	ring->sq_mapping = mmap(NULL, ring->sq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if(ring->sq_mapping == MAP_FAILED){
+		close(fd);
+		return -1;
+	}
+	if(params.features & IORING_FEAT_SINGLE_MMAP){
+		ring->cq_mapping = ring->sq_mapping;
+	}else{
+		ring->cq_mapping = mmap(NULL, ring->cq_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if(ring->cq_mapping == MAP_FAILED){
+			munmap(ring->sq_mapping, ring->sq_mapping_size);
+			close(fd);
+			return -1;
+		}
+	}
+	ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if(ring->sqes == MAP_FAILED){
+		if(ring->cq_mapping != ring->sq_mapping){
+			munmap(ring->cq_mapping, ring->cq_mapping_size);
+		}
+		munmap(ring->sq_mapping, ring->sq_mapping_size);
+		close(fd);
+		return -1;
+	}
+
+	char *sq = (char *)ring->sq_mapping;
+	ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+	ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+
+	char *cq = (char *)ring->cq_mapping;
+	ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+	ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	ring->fd = fd;
+	return 0;
+}
+
+static void ring_teardown(struct yambler_async_file_ring *ring){
+	munmap(ring->sqes, ring->sqes_size);
+	if(ring->cq_mapping != ring->sq_mapping){
+		munmap(ring->cq_mapping, ring->cq_mapping_size);
+	}
+	munmap(ring->sq_mapping, ring->sq_mapping_size);
+	close(ring->fd);
+}
+
+/*
+ * Passes every queued submission to the kernel, including one left behind by an earlier enter that failed
+ */
+static int ring_enter(struct yambler_async_file_ring *ring, unsigned min_complete){
+	unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+	for(;;){
+		unsigned queued = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+		if(syscall(__NR_io_uring_enter, ring->fd, queued, min_complete, flags, NULL, 0) >= 0){
+			return 0;
+		}
+		if(errno == EINTR && min_complete){
+			/* the caller reaps and waits again if nothing completed */
+			return 0;
+		}
+		if(errno != EINTR && errno != EAGAIN){
+			return -1;
+		}
+	}
+}
+
+static int ring_submit_read(yambler_async_file_p file, size_t index){
+	struct yambler_async_file_ring *ring = &file->ring;
+	struct yambler_async_file_slot *slot = file->slots + index;
+
+	unsigned tail = *ring->sq_tail;
+	unsigned position = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = ring->sqes + position;
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = file->fd;
+	sqe->addr = (unsigned long)(slot->data + slot->filled);
+	sqe->len = (unsigned)(file->block_size - slot->filled);
+	sqe->off = (unsigned long long)(slot->offset + slot->filled);
+	sqe->user_data = index;
+	ring->sq_array[position] = position;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	/* once the tail has moved the kernel may consume the read on any later enter, so its completion is counted now */
+	slot->pending = 1;
+	++file->pending;
+	return ring_enter(ring, 0);
+}
+
+static int ring_reap(yambler_async_file_p file, int wait){
+	struct yambler_async_file_ring *ring = &file->ring;
+	unsigned head = *ring->cq_head;
+	if(head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)){
+		if(!wait){
+			return 0;
+		}
+		if(ring_enter(ring, 1)){
+			return -1;
+		}
+	}
+	while(head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)){
+		struct io_uring_cqe *cqe = ring->cqes + (head & *ring->cq_mask);
+		struct yambler_async_file_slot *slot = file->slots + cqe->user_data;
+		int result = cqe->res;
+		++head;
+		__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+		slot->pending = 0;
+		--file->pending;
+		if(result < 0){
+			file->failed = 1;
+		}else if(result != 0 && slot->filled + (size_t)result < slot->expected){
+			size_t filled = slot->filled + (size_t)result;
+			if(file->direct){
+				/* direct reads must start at an aligned offset, so the unaligned end of a short read is read again */
+				size_t aligned = filled & ~(size_t)(BLOCK_ALIGNMENT - 1);
+				if(aligned > slot->filled){
+					filled = aligned;
+				}else if(fcntl(file->fd, F_SETFL, fcntl(file->fd, F_GETFL) & ~O_DIRECT) == 0){
+					/* a short read that gains no aligned offset would be repeated forever, the rest is read buffered */
+					file->direct = 0;
+				}else{
+					file->failed = 1;
+					continue;
+				}
+			}
+			slot->filled = filled;
+			if(ring_submit_read(file, (size_t)(slot - file->slots))){
+				file->failed = 1;
+			}
+		}else{
+			slot->filled += (size_t)result;
+		}
+	}
+	return 0;
+}
+
+#endif
+
+static void schedule(yambler_async_file_p file, size_t index){
+	struct yambler_async_file_slot *slot = file->slots + index;
+	slot->filled = 0;
+	slot->pending = 0;
+	if(file->next_offset >= file->size){
+		slot->offset = -1;
+		slot->expected = 0;
+		return;
+	}
+	slot->offset = file->next_offset;
+	slot->expected = file->size - file->next_offset < (off_t)file->block_size ? (size_t)(file->size - file->next_offset) : file->block_size;
+	file->next_offset += file->block_size;
+#ifdef YAMBLER_ASYNC_FILE_URING
+	if(ring_submit_read(file, index)){
+		file->failed = 1;
+	}
+#endif
+}
+
+yambler_status yambler_async_file_open(yambler_decoder_state *state){
+	assert(state != NULL);
+	yambler_async_file_p file = (yambler_async_file_p)*state;
+	assert(file != NULL);
+
+	if(file->fd != -1){
+		yambler_async_file_close(state);
+	}
+
+	file->uring = 0;
+	file->direct = 0;
+	file->fd = -1;
+#ifdef YAMBLER_ASYNC_FILE_URING
+	if(ring_setup(&file->ring, (unsigned)file->depth) == 0){
+		file->uring = 1;
+		if(file->options & YAMBLER_ASYNC_FILE_DIRECT){
+			file->fd = open(file->path, O_RDONLY | O_DIRECT);
+			file->direct = file->fd != -1;
+		}
+	}
+#endif
+	if(file->fd == -1){
+		file->fd = open(file->path, O_RDONLY);
+	}
+	if(file->fd == -1){
+#ifdef YAMBLER_ASYNC_FILE_URING
+		if(file->uring){
+			ring_teardown(&file->ring);
+			file->uring = 0;
+		}
+#endif
+		return YAMBLER_ERROR;
+	}
+	struct stat file_stat;
+	if(fstat(file->fd, &file_stat) == -1){
+		yambler_async_file_close(state);
+		return YAMBLER_ERROR;
+	}
+	file->size = file_stat.st_size;
+	file->next_offset = 0;
+	file->current = 0;
+	file->current_offset = 0;
+	file->pending = 0;
+	file->failed = 0;
+
+	if(file->uring){
+		for(size_t i = 0; i < file->depth; ++i){
+			schedule(file, i);
+		}
+	}else{
+		posix_fadvise(file->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	return file->failed ? YAMBLER_ERROR : YAMBLER_OK;
+}
+
+static yambler_status read_synchronous(yambler_async_file_p file, yambler_byte *buffer, size_t buffer_size, size_t *read_count){
+	ssize_t result;
+	do{
+		result = pread(file->fd, buffer, buffer_size, file->next_offset);
+	}while(result == -1 && errno == EINTR);
+	if(result == -1){
+		return YAMBLER_ERROR;
+	}
+	file->next_offset += result;
+	*read_count = (size_t)result;
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_async_file_read(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count){
+	yambler_async_file_p file = (yambler_async_file_p)state;
+	assert(file != NULL);
+	assert(file->fd != -1);
+
+	*read_count = 0;
+	if(!file->uring){
+		return read_synchronous(file, buffer, buffer_size, read_count);
+	}
+#ifdef YAMBLER_ASYNC_FILE_URING
+	struct yambler_async_file_slot *slot = file->slots + file->current;
+	if(slot->offset == -1){
+		return YAMBLER_OK;
+	}
+	while(slot->pending && !file->failed){
+		if(ring_reap(file, 1)){
+			return YAMBLER_ERROR;
+		}
+	}
+	if(file->failed){
+		return YAMBLER_ERROR;
+	}
+	if(slot->filled == 0){
+		slot->offset = -1;
+		return YAMBLER_OK;
+	}
+	size_t count = slot->filled - file->current_offset;
+	if(count > buffer_size){
+		count = buffer_size;
+	}
+	memcpy(buffer, slot->data + file->current_offset, count);
+	file->current_offset += count;
+	if(file->current_offset == slot->filled){
+		file->current_offset = 0;
+		schedule(file, file->current);
+		file->current = (file->current + 1) % file->depth;
+		ring_reap(file, 0);
+	}
+	*read_count = count;
+	return file->failed ? YAMBLER_ERROR : YAMBLER_OK;
+#else
+	return YAMBLER_ERROR;
+#endif
+}
+
+void yambler_async_file_close(yambler_decoder_state *state){
+	assert(state != NULL);
+	yambler_async_file_p file = (yambler_async_file_p)*state;
+	assert(file != NULL);
+
+#ifdef YAMBLER_ASYNC_FILE_URING
+	if(file->uring){
+		/* the kernel may still write into the slots, so wait for every read in flight */
+		while(file->pending != 0){
+			if(ring_reap(file, 1)){
+				break;
+			}
+		}
+		ring_teardown(&file->ring);
+		file->uring = 0;
+	}
+#endif
+	if(file->fd != -1){
+		close(file->fd);
+		file->fd = -1;
+	}
+}
+
+int yambler_async_file_uses_uring(yambler_async_file_p file){
+	assert(file != NULL);
+	return file->uring;
+}
+
+void yambler_async_file_destroy(yambler_async_file_p *src){
+	assert(src != NULL);
+
+	yambler_async_file_p file = *src;
+
+	assert(file != NULL);
+
+	yambler_decoder_state state = file;
+	yambler_async_file_close(&state);
+
+	const struct yambler_allocator *allocator = file->allocator;
+	for(size_t i = 0; i < file->depth; ++i){
+		yambler_release(allocator, file->slots[i].block);
+	}
+	yambler_release(allocator, file->slots);
+	yambler_release(allocator, file->path);
+	yambler_release(allocator, file);
+	*src = NULL;
+}
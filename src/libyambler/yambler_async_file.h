@@ -0,0 +1,31 @@
+#ifndef YAMBLER_ASYNC_FILE_H
+#define YAMBLER_ASYNC_FILE_H
+
+#include "yambler_type.h"
+#include "yambler_allocator.h"
+#include "yambler_decoder.h"
+
+#include <stddef.h>
+
+/*
+ * Asynchronous file source that keeps several block reads in flight ahead of the decoder through io_uring.
+ * When io_uring is unavailable the source falls back to synchronous pread.
+ */
+
+struct yambler_async_file;
+
+typedef struct yambler_async_file * yambler_async_file_p;
+
+yambler_status yambler_async_file_create(yambler_async_file_p *dest, const struct yambler_allocator *allocator, const char *path, size_t block_size, size_t depth, yambler_async_file_flag options);
+
+yambler_status yambler_async_file_open(yambler_decoder_state *state);
+
+yambler_status yambler_async_file_read(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count);
+
+void yambler_async_file_close(yambler_decoder_state *state);
+
+int yambler_async_file_uses_uring(yambler_async_file_p file);
+
+void yambler_async_file_destroy(yambler_async_file_p *src);
+
+#endif
@@ -4,11 +4,12 @@
 #include <assert.h>
 #include <string.h>
 
-yambler_status yambler_byte_buffer_create(struct yambler_byte_buffer *buffer, size_t size){
+yambler_status yambler_byte_buffer_create(struct yambler_byte_buffer *buffer, const struct yambler_allocator *allocator, size_t size){
 	assert(buffer != NULL);
 	assert(size != 0);
 
-	buffer->data = malloc(sizeof(yambler_byte) * size);
+	buffer->allocator = yambler_allocator_or_default(allocator);
+	buffer->data = yambler_allocate(buffer->allocator, sizeof(yambler_byte) * size);
 	if(buffer->data == NULL){
 		return YAMBLER_ALLOC_ERROR;
 	}
@@ -19,6 +20,7 @@ yambler_status yambler_byte_buffer_create(struct yambler_byte_buffer *buffer, si
 void yambler_byte_buffer_create_unready(struct yambler_byte_buffer *buffer){
 	assert(buffer != NULL);
 
+	buffer->allocator = yambler_default_allocator();
 	buffer->data = NULL;
 	buffer->size = 0;
 }
@@ -38,12 +40,13 @@ int yambler_byte_buffer_ready(const struct yambler_byte_buffer *buffer){
 
 void yambler_byte_buffer_destroy(struct yambler_byte_buffer *buffer){
 	assert(buffer != NULL);
-	free(buffer->data);
+	yambler_release(buffer->allocator, buffer->data);
 }
 
-yambler_status yambler_char_buffer_create(struct yambler_char_buffer *buffer, size_t initial_size){
+yambler_status yambler_char_buffer_create(struct yambler_char_buffer *buffer, const struct yambler_allocator *allocator, size_t initial_size){
 	assert(buffer != NULL);
-	buffer->data = malloc(sizeof(yambler_char) * initial_size);
+	buffer->allocator = yambler_allocator_or_default(allocator);
+	buffer->data = yambler_allocate(buffer->allocator, sizeof(yambler_char) * initial_size);
 	if(buffer->data == NULL){
 		return YAMBLER_ALLOC_ERROR;
 	}
@@ -55,26 +58,31 @@ yambler_status yambler_char_buffer_create(struct yambler_char_buffer *buffer, si
 
 void yambler_char_buffer_shift(struct yambler_char_buffer *buffer){
 	memmove(buffer->data, buffer->get, buffer->length * sizeof(yambler_char));
+	buffer->get = buffer->data;
 	buffer->put = buffer->get + buffer->length;
 }
 
 yambler_status yambler_char_buffer_grow(struct yambler_char_buffer *buffer, size_t min_capacity){
 	if(min_capacity > buffer->size){
-		yambler_char *data = malloc(sizeof(yambler_char) * min_capacity);
+		size_t size = buffer->size * 2;
+		if(size < min_capacity){
+			size = min_capacity;
+		}
+		yambler_char *data = yambler_allocate(buffer->allocator, sizeof(yambler_char) * size);
 		if(data == NULL){
 			return YAMBLER_ALLOC_ERROR;
 		}
-		memcpy(data, buffer->get, buffer->length);
-		free(buffer->data);
+		memcpy(data, buffer->get, buffer->length * sizeof(yambler_char));
+		yambler_release(buffer->allocator, buffer->data);
 		buffer->data = data;
 		buffer->get = data;
 		buffer->put = data + buffer->length;
-		buffer->size = min_capacity;
+		buffer->size = size;
 	}
 	return YAMBLER_OK;
 }
 
 void yambler_char_buffer_destroy(struct yambler_char_buffer *buffer){
 	assert(buffer != NULL);
-	free(buffer->data);
+	yambler_release(buffer->allocator, buffer->data);
 }
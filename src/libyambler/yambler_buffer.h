@@ -2,16 +2,18 @@
 #define YAMBLER_BUFFER_H
 
 #include "yambler_type.h"
+#include "yambler_allocator.h"
 
 #include <stddef.h>
 
 struct yambler_byte_buffer{
+	const struct yambler_allocator *allocator;
 	yambler_byte *data;
 	size_t size;
 	size_t length;
 };
 
-yambler_status yambler_byte_buffer_create(struct yambler_byte_buffer *buffer, size_t size);
+yambler_status yambler_byte_buffer_create(struct yambler_byte_buffer *buffer, const struct yambler_allocator *allocator, size_t size);
 
 void yambler_byte_buffer_create_unready(struct yambler_byte_buffer *buffer);
 
@@ -26,6 +28,7 @@ enum yambler_buffer_mode{
 };
 
 struct yambler_char_buffer{
+	const struct yambler_allocator *allocator;
 	yambler_char *data;
 	size_t size;
 	size_t length;
@@ -33,7 +36,7 @@ struct yambler_char_buffer{
 	yambler_char *put;
 };
 
-yambler_status yambler_char_buffer_create(struct yambler_char_buffer *buffer, size_t initial_size);
+yambler_status yambler_char_buffer_create(struct yambler_char_buffer *buffer, const struct yambler_allocator *allocator, size_t initial_size);
 
 yambler_status yambler_char_buffer_grow(struct yambler_char_buffer *buffer, size_t min_capacity);
 
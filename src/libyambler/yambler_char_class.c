@@ -0,0 +1,54 @@
+#include "yambler_char_class.h"
+
+/*
+ * Generated from the productions of the YAML 1.2 specification, the rows hold 16 characters each
+ */
+const yambler_char_class yambler_char_class_table[256] = {
+#ifdef YAMBLER_UTF8_CHARS
+	/* 0x00 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0005, 0x0006, 0x0000, 0x0000, 0x0006, 0x0000, 0x0000,
+	/* 0x10 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0x20 */ 0x0005, 0x041C, 0x401C, 0x1C1C, 0x0C0C, 0x0C1C, 0x0C1C, 0x4C1C, 0x0C0C, 0x0C0C, 0x0C1C, 0x0C0C, 0x043C, 0x0E1C, 0x0C0C, 0x0C0C,
+	/* 0x30 */ 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x2C1C, 0x0C0C, 0x000C, 0x0C0C, 0x001C, 0x0C1C,
+	/* 0x40 */ 0x0C1C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C,
+	/* 0x50 */ 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x043C, 0x400C, 0x043C, 0x000C, 0x0C0C,
+	/* 0x60 */ 0x001C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C,
+	/* 0x70 */ 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x003C, 0x001C, 0x003C, 0x0C0C, 0x0000,
+	/* 0x80 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0x90 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xA0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xB0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xC0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xD0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xE0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xF0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C
+#else
+	/* 0x00 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0005, 0x0006, 0x0000, 0x0000, 0x0006, 0x0000, 0x0000,
+	/* 0x10 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0x20 */ 0x0005, 0x041C, 0x401C, 0x1C1C, 0x0C0C, 0x0C1C, 0x0C1C, 0x4C1C, 0x0C0C, 0x0C0C, 0x0C1C, 0x0C0C, 0x043C, 0x0E1C, 0x0C0C, 0x0C0C,
+	/* 0x30 */ 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x0ECC, 0x2C1C, 0x0C0C, 0x000C, 0x0C0C, 0x001C, 0x0C1C,
+	/* 0x40 */ 0x0C1C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C,
+	/* 0x50 */ 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x043C, 0x400C, 0x043C, 0x000C, 0x0C0C,
+	/* 0x60 */ 0x001C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F8C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C,
+	/* 0x70 */ 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x0F0C, 0x003C, 0x001C, 0x003C, 0x0C0C, 0x0000,
+	/* 0x80 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x000C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0x90 */ 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	/* 0xA0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xB0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xC0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xD0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xE0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C,
+	/* 0xF0 */ 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C, 0x000C
+#endif
+};
+
+#ifndef YAMBLER_UTF8_CHARS
+
+yambler_char_class yambler_char_class_wide(yambler_char c){
+	if((c >= 0x100 && c <= 0xD7FF) || (c >= 0xE000 && c <= 0xFFFD) || (c >= 0x10000 && c <= 0x10FFFF)){
+		/* the byte order mark is printable, but not part of any token */
+		return c == 0xFEFF ? YAMBLER_CLASS_PRINTABLE : YAMBLER_CLASS_PRINTABLE | YAMBLER_CLASS_NON_SPACE;
+	}
+	return 0;
+}
+
+#endif
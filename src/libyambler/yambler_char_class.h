@@ -0,0 +1,47 @@
+#ifndef YAMBLER_CHAR_CLASS_H
+#define YAMBLER_CHAR_CLASS_H
+
+#include "yambler_type.h"
+
+#include <stdint.h>
+
+/*
+ * Character classes of the YAML grammar as bits of a mask. The classes of the characters up to 0xFF are looked up
+ * in a table, only wider characters take a slow path. With UTF-8 characters every byte from 0x80 on is part of a
+ * multi-byte character, which the decoder has validated, and counts as printable and non-space.
+ */
+
+typedef uint16_t yambler_char_class;
+
+#define YAMBLER_CLASS_BLANK 0x0001
+#define YAMBLER_CLASS_BREAK 0x0002
+#define YAMBLER_CLASS_PRINTABLE 0x0004
+#define YAMBLER_CLASS_NON_SPACE 0x0008
+#define YAMBLER_CLASS_INDICATOR 0x0010
+#define YAMBLER_CLASS_FLOW_INDICATOR 0x0020
+#define YAMBLER_CLASS_DIGIT 0x0040
+#define YAMBLER_CLASS_HEX 0x0080
+#define YAMBLER_CLASS_LETTER 0x0100
+#define YAMBLER_CLASS_WORD 0x0200
+#define YAMBLER_CLASS_URI 0x0400
+#define YAMBLER_CLASS_TAG 0x0800
+#define YAMBLER_CLASS_COMMENT 0x1000
+#define YAMBLER_CLASS_MAPPING_VALUE 0x2000
+#define YAMBLER_CLASS_QUOTE 0x4000
+
+/* the classes with members outside of ASCII */
+#define YAMBLER_CLASS_WIDE (YAMBLER_CLASS_PRINTABLE | YAMBLER_CLASS_NON_SPACE)
+
+extern const yambler_char_class yambler_char_class_table[256];
+
+#ifdef YAMBLER_UTF8_CHARS
+#define YAMBLER_CHAR_CLASS(c) (yambler_char_class_table[(c)])
+#else
+yambler_char_class yambler_char_class_wide(yambler_char c);
+
+#define YAMBLER_CHAR_CLASS(c) ((c) <= 0xFF ? yambler_char_class_table[(c)] : yambler_char_class_wide(c))
+#endif
+
+#define YAMBLER_CHAR_IS(c, mask) ((YAMBLER_CHAR_CLASS(c) & (mask)) != 0)
+
+#endif
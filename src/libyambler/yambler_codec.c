@@ -0,0 +1,913 @@
+#include "yambler_codec.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define YAMBLER_CODEC_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * ASCII kernels: copy the leading run of ASCII bytes into native characters and return its length
+ * UTF-16 kernels: copy the leading run of code units that map onto a single native character and return its length in code units
+ * Store kernels work the other way around: they store the leading run of native characters that need a single ASCII byte
+ * or a single UTF-16 code unit and return its length in characters
+ */
+
+typedef size_t (*ascii_kernel)(const unsigned char *, size_t, yambler_char *);
+
+typedef size_t (*utf16_kernel)(const unsigned char *, size_t, yambler_char *, int);
+
+typedef size_t (*store_ascii_kernel)(const yambler_char *, size_t, unsigned char *);
+
+typedef size_t (*store_utf16_kernel)(const yambler_char *, size_t, unsigned char *, int);
+
+#define UTF16_UNIT(in, big_endian) ((big_endian) ? (((yambler_code_point)(in)[0] << 8) | (in)[1]) : (((yambler_code_point)(in)[1] << 8) | (in)[0]))
+
+#define IS_SURROGATE(c) (((c) & 0xFFFFF800) == 0xD800)
+
+#ifdef YAMBLER_UTF8_CHARS
+#define SINGLE_UNIT_LIMIT 0x80
+#define IS_SINGLE_UTF16_UNIT(c) ((c) < 0x80)
+#else
+#define SINGLE_UNIT_LIMIT 0x110000
+#define IS_SINGLE_UTF16_UNIT(c) ((c) < 0x10000 && !IS_SURROGATE(c))
+#endif
+
+#define PUT_UTF16_UNIT(out, unit, big_endian) do{ \
+		if(big_endian){ \
+			(out)[0] = (unsigned char)((unit) >> 8); \
+			(out)[1] = (unsigned char)(unit); \
+		}else{ \
+			(out)[0] = (unsigned char)(unit); \
+			(out)[1] = (unsigned char)((unit) >> 8); \
+		} \
+	}while(0)
+
+/*
+ * Stores a code point as UTF-8, returns the number of bytes written or 0 if it does not fit
+ */
+
+static size_t put_utf8(unsigned char *out, size_t room, yambler_code_point c){
+	if(c < 0x80){
+		if(room < 1){
+			return 0;
+		}
+		out[0] = (unsigned char)c;
+		return 1;
+	}else if(c < 0x800){
+		if(room < 2){
+			return 0;
+		}
+		out[0] = (unsigned char)(0xC0 | (c >> 6));
+		out[1] = (unsigned char)(0x80 | (c & 0x3F));
+		return 2;
+	}else if(c < 0x10000){
+		if(room < 3){
+			return 0;
+		}
+		out[0] = (unsigned char)(0xE0 | (c >> 12));
+		out[1] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+		out[2] = (unsigned char)(0x80 | (c & 0x3F));
+		return 3;
+	}else{
+		if(room < 4){
+			return 0;
+		}
+		out[0] = (unsigned char)(0xF0 | (c >> 18));
+		out[1] = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+		out[2] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+		out[3] = (unsigned char)(0x80 | (c & 0x3F));
+		return 4;
+	}
+}
+
+/*
+ * Stores a code point as native characters, returns the number of characters written or 0 if it does not fit
+ */
+
+static size_t put_code_point(yambler_char *out, size_t room, yambler_code_point c){
+#ifdef YAMBLER_UTF8_CHARS
+	return put_utf8(out, room, c);
+#else
+	if(room < 1){
+		return 0;
+	}
+	*out = c;
+	return 1;
+#endif
+}
+
+static size_t copy_ascii_scalar(const unsigned char *in, size_t length, yambler_char *out){
+	size_t i = 0;
+	while(i < length && in[i] < 0x80){
+		out[i] = in[i];
+		++i;
+	}
+	return i;
+}
+
+static size_t copy_utf16_scalar(const unsigned char *in, size_t length, yambler_char *out, int big_endian){
+	size_t i = 0;
+	while(i < length){
+		yambler_code_point c = UTF16_UNIT(in + 2 * i, big_endian);
+		if(c >= SINGLE_UNIT_LIMIT || IS_SURROGATE(c)){
+			break;
+		}
+		out[i] = (yambler_char)c;
+		++i;
+	}
+	return i;
+}
+
+#ifndef YAMBLER_UTF8_CHARS
+
+static size_t store_ascii_scalar(const yambler_char *in, size_t length, unsigned char *out){
+	size_t i = 0;
+	while(i < length && in[i] < 0x80){
+		out[i] = (unsigned char)in[i];
+		++i;
+	}
+	return i;
+}
+
+#endif
+
+static size_t store_utf16_scalar(const yambler_char *in, size_t length, unsigned char *out, int big_endian){
+	size_t i = 0;
+	while(i < length && IS_SINGLE_UTF16_UNIT(in[i])){
+		PUT_UTF16_UNIT(out + 2 * i, in[i], big_endian);
+		++i;
+	}
+	return i;
+}
+
+#ifdef YAMBLER_CODEC_X86
+
+#ifdef YAMBLER_UTF8_CHARS
+
+__attribute__((target("sse2")))
+static size_t copy_ascii_sse2(const unsigned char *in, size_t length, yambler_char *out){
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m128i bytes = _mm_loadu_si128((const __m128i *)(in + i));
+		if(_mm_movemask_epi8(bytes)){
+			break;
+		}
+		_mm_storeu_si128((__m128i *)(out + i), bytes);
+		i += 16;
+	}
+	return i + copy_ascii_scalar(in + i, length - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static size_t copy_ascii_avx2(const unsigned char *in, size_t length, yambler_char *out){
+	size_t i = 0;
+	while(i + 32 <= length){
+		__m256i bytes = _mm256_loadu_si256((const __m256i *)(in + i));
+		if(_mm256_movemask_epi8(bytes)){
+			break;
+		}
+		_mm256_storeu_si256((__m256i *)(out + i), bytes);
+		i += 32;
+	}
+	return i + copy_ascii_scalar(in + i, length - i, out + i);
+}
+
+__attribute__((target("sse2")))
+static size_t store_utf16_sse2(const yambler_char *in, size_t length, unsigned char *out, int big_endian){
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m128i bytes = _mm_loadu_si128((const __m128i *)(in + i));
+		if(_mm_movemask_epi8(bytes)){
+			break;
+		}
+		if(big_endian){
+			_mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(zero, bytes));
+			_mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(zero, bytes));
+		}else{
+			_mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(bytes, zero));
+			_mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(bytes, zero));
+		}
+		i += 16;
+	}
+	return i + store_utf16_scalar(in + i, length - i, out + 2 * i, big_endian);
+}
+
+__attribute__((target("avx2")))
+static size_t store_utf16_avx2(const yambler_char *in, size_t length, unsigned char *out, int big_endian){
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m128i bytes = _mm_loadu_si128((const __m128i *)(in + i));
+		if(_mm_movemask_epi8(bytes)){
+			break;
+		}
+		__m256i units = _mm256_cvtepu8_epi16(bytes);
+		if(big_endian){
+			units = _mm256_slli_epi16(units, 8);
+		}
+		_mm256_storeu_si256((__m256i *)(out + 2 * i), units);
+		i += 16;
+	}
+	return i + store_utf16_scalar(in + i, length - i, out + 2 * i, big_endian);
+}
+
+#else
+
+__attribute__((target("sse2")))
+static size_t copy_ascii_sse2(const unsigned char *in, size_t length, yambler_char *out){
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m128i bytes = _mm_loadu_si128((const __m128i *)(in + i));
+		if(_mm_movemask_epi8(bytes)){
+			break;
+		}
+		__m128i low = _mm_unpacklo_epi8(bytes, zero);
+		__m128i high = _mm_unpackhi_epi8(bytes, zero);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(low, zero));
+		_mm_storeu_si128((__m128i *)(out + i + 4), _mm_unpackhi_epi16(low, zero));
+		_mm_storeu_si128((__m128i *)(out + i + 8), _mm_unpacklo_epi16(high, zero));
+		_mm_storeu_si128((__m128i *)(out + i + 12), _mm_unpackhi_epi16(high, zero));
+		i += 16;
+	}
+	return i + copy_ascii_scalar(in + i, length - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static size_t copy_ascii_avx2(const unsigned char *in, size_t length, yambler_char *out){
+	size_t i = 0;
+	while(i + 32 <= length){
+		__m256i bytes = _mm256_loadu_si256((const __m256i *)(in + i));
+		if(_mm256_movemask_epi8(bytes)){
+			break;
+		}
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i))));
+		_mm256_storeu_si256((__m256i *)(out + i + 8), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + 8))));
+		_mm256_storeu_si256((__m256i *)(out + i + 16), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + 16))));
+		_mm256_storeu_si256((__m256i *)(out + i + 24), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(in + i + 24))));
+		i += 32;
+	}
+	return i + copy_ascii_scalar(in + i, length - i, out + i);
+}
+
+__attribute__((target("sse2")))
+static size_t copy_utf16_sse2(const unsigned char *in, size_t length, yambler_char *out, int big_endian){
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i surrogate_mask = _mm_set1_epi16((short)0xF800);
+	const __m128i surrogate = _mm_set1_epi16((short)0xD800);
+	size_t i = 0;
+	while(i + 8 <= length){
+		__m128i units = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+		if(big_endian){
+			units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+		}
+		if(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, surrogate_mask), surrogate))){
+			break;
+		}
+		_mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(units, zero));
+		_mm_storeu_si128((__m128i *)(out + i + 4), _mm_unpackhi_epi16(units, zero));
+		i += 8;
+	}
+	return i + copy_utf16_scalar(in + 2 * i, length - i, out + i, big_endian);
+}
+
+__attribute__((target("avx2")))
+static size_t copy_utf16_avx2(const unsigned char *in, size_t length, yambler_char *out, int big_endian){
+	const __m256i surrogate_mask = _mm256_set1_epi16((short)0xF800);
+	const __m256i surrogate = _mm256_set1_epi16((short)0xD800);
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m256i units = _mm256_loadu_si256((const __m256i *)(in + 2 * i));
+		if(big_endian){
+			units = _mm256_or_si256(_mm256_slli_epi16(units, 8), _mm256_srli_epi16(units, 8));
+		}
+		if(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(units, surrogate_mask), surrogate))){
+			break;
+		}
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(units)));
+		_mm256_storeu_si256((__m256i *)(out + i + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(units, 1)));
+		i += 16;
+	}
+	return i + copy_utf16_scalar(in + 2 * i, length - i, out + i, big_endian);
+}
+
+__attribute__((target("sse2")))
+static size_t store_ascii_sse2(const yambler_char *in, size_t length, unsigned char *out){
+	const __m128i non_ascii = _mm_set1_epi32((int)0xFFFFFF80);
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+		__m128i c = _mm_loadu_si128((const __m128i *)(in + i + 8));
+		__m128i d = _mm_loadu_si128((const __m128i *)(in + i + 12));
+		__m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), non_ascii);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xFFFF){
+			break;
+		}
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+		i += 16;
+	}
+	return i + store_ascii_scalar(in + i, length - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static size_t store_ascii_avx2(const yambler_char *in, size_t length, unsigned char *out){
+	const __m256i non_ascii = _mm256_set1_epi32((int)0xFFFFFF80);
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+	while(i + 32 <= length){
+		__m256i a = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(in + i + 8));
+		__m256i c = _mm256_loadu_si256((const __m256i *)(in + i + 16));
+		__m256i d = _mm256_loadu_si256((const __m256i *)(in + i + 24));
+		__m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+		if(!_mm256_testz_si256(any, non_ascii)){
+			break;
+		}
+		/* the packs work within 128 bit lanes, the permutation restores the character order */
+		__m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(a, b), _mm256_packus_epi32(c, d));
+		_mm256_storeu_si256((__m256i *)(out + i), _mm256_permutevar8x32_epi32(bytes, order));
+		i += 32;
+	}
+	return i + store_ascii_scalar(in + i, length - i, out + i);
+}
+
+__attribute__((target("sse2")))
+static size_t store_utf16_sse2(const yambler_char *in, size_t length, unsigned char *out, int big_endian){
+	const __m128i high_mask = _mm_set1_epi32((int)0xFFFF0000);
+	const __m128i surrogate_mask = _mm_set1_epi32(0xF800);
+	const __m128i surrogate = _mm_set1_epi32(0xD800);
+	const __m128i bias = _mm_set1_epi32(0x8000);
+	size_t i = 0;
+	while(i + 8 <= length){
+		__m128i a = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(in + i + 4));
+		__m128i high = _mm_and_si128(_mm_or_si128(a, b), high_mask);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) != 0xFFFF){
+			break;
+		}
+		__m128i surrogates = _mm_or_si128(
+			_mm_cmpeq_epi32(_mm_and_si128(a, surrogate_mask), surrogate),
+			_mm_cmpeq_epi32(_mm_and_si128(b, surrogate_mask), surrogate));
+		if(_mm_movemask_epi8(surrogates)){
+			break;
+		}
+		/* sse2 only packs with signed saturation, so the units are moved into the signed range and back */
+		__m128i units = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(a, bias), _mm_sub_epi32(b, bias)), _mm_set1_epi16((short)0x8000));
+		if(big_endian){
+			units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+		}
+		_mm_storeu_si128((__m128i *)(out + 2 * i), units);
+		i += 8;
+	}
+	return i + store_utf16_scalar(in + i, length - i, out + 2 * i, big_endian);
+}
+
+__attribute__((target("avx2")))
+static size_t store_utf16_avx2(const yambler_char *in, size_t length, unsigned char *out, int big_endian){
+	const __m256i high_mask = _mm256_set1_epi32((int)0xFFFF0000);
+	const __m256i surrogate_mask = _mm256_set1_epi32(0xF800);
+	const __m256i surrogate = _mm256_set1_epi32(0xD800);
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m256i a = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(in + i + 8));
+		if(!_mm256_testz_si256(_mm256_or_si256(a, b), high_mask)){
+			break;
+		}
+		__m256i surrogates = _mm256_or_si256(
+			_mm256_cmpeq_epi32(_mm256_and_si256(a, surrogate_mask), surrogate),
+			_mm256_cmpeq_epi32(_mm256_and_si256(b, surrogate_mask), surrogate));
+		if(_mm256_movemask_epi8(surrogates)){
+			break;
+		}
+		__m256i units = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8);
+		if(big_endian){
+			units = _mm256_or_si256(_mm256_slli_epi16(units, 8), _mm256_srli_epi16(units, 8));
+		}
+		_mm256_storeu_si256((__m256i *)(out + 2 * i), units);
+		i += 16;
+	}
+	return i + store_utf16_scalar(in + i, length - i, out + 2 * i, big_endian);
+}
+
+#endif
+
+#endif
+
+static ascii_kernel copy_ascii = NULL;
+
+static utf16_kernel copy_utf16 = NULL;
+
+static store_ascii_kernel store_ascii = NULL;
+
+static store_utf16_kernel store_utf16 = NULL;
+
+/* the kernels are selected once, as parallel decoders convert on several threads at the same time */
+static pthread_once_t kernels_selected = PTHREAD_ONCE_INIT;
+
+static void select_kernels(){
+	ascii_kernel ascii = &copy_ascii_scalar;
+	utf16_kernel utf16 = &copy_utf16_scalar;
+	store_utf16_kernel utf16_store = &store_utf16_scalar;
+#ifndef YAMBLER_UTF8_CHARS
+	store_ascii_kernel ascii_store = &store_ascii_scalar;
+#endif
+#ifdef YAMBLER_CODEC_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")){
+		ascii = &copy_ascii_avx2;
+		utf16_store = &store_utf16_avx2;
+#ifndef YAMBLER_UTF8_CHARS
+		utf16 = &copy_utf16_avx2;
+		ascii_store = &store_ascii_avx2;
+#endif
+	}else if(__builtin_cpu_supports("sse2")){
+		ascii = &copy_ascii_sse2;
+		utf16_store = &store_utf16_sse2;
+#ifndef YAMBLER_UTF8_CHARS
+		utf16 = &copy_utf16_sse2;
+		ascii_store = &store_ascii_sse2;
+#endif
+	}
+#endif
+#ifdef YAMBLER_UTF8_CHARS
+	/* with UTF-8 characters, storing ASCII is the same byte copy as loading it */
+	store_ascii = ascii;
+#else
+	store_ascii = ascii_store;
+#endif
+	store_utf16 = utf16_store;
+	copy_utf16 = utf16;
+	copy_ascii = ascii;
+}
+
+/*
+ * Scalar UTF-8 decoding of a single multi-byte sequence, following table 3-7 of the unicode standard
+ */
+
+static enum yambler_codec_result decode_utf8_sequence(const unsigned char *in, size_t length, yambler_code_point *dest, size_t *consumed){
+	unsigned char lead = in[0];
+	size_t size;
+	unsigned char min = 0x80;
+	unsigned char max = 0xBF;
+	yambler_code_point c;
+	if(lead >= 0xC2 && lead <= 0xDF){
+		size = 2;
+		c = lead & 0x1F;
+	}else if(lead >= 0xE0 && lead <= 0xEF){
+		size = 3;
+		c = lead & 0x0F;
+		if(lead == 0xE0){
+			min = 0xA0;
+		}else if(lead == 0xED){
+			max = 0x9F;
+		}
+	}else if(lead >= 0xF0 && lead <= 0xF4){
+		size = 4;
+		c = lead & 0x07;
+		if(lead == 0xF0){
+			min = 0x90;
+		}else if(lead == 0xF4){
+			max = 0x8F;
+		}
+	}else{
+		return YAMBLER_CODEC_INVALID;
+	}
+	for(size_t i = 1; i < size; ++i){
+		if(i == length){
+			return YAMBLER_CODEC_INCOMPLETE;
+		}
+		if(in[i] < min || in[i] > max){
+			return YAMBLER_CODEC_INVALID;
+		}
+		c = (c << 6) | (in[i] & 0x3F);
+		min = 0x80;
+		max = 0xBF;
+	}
+	*dest = c;
+	*consumed = size;
+	return YAMBLER_CODEC_OK;
+}
+
+/*
+ * Reads the code point at the start of a run of native characters
+ */
+static enum yambler_codec_result get_code_point(const yambler_char *in, size_t length, yambler_code_point *dest, size_t *consumed){
+#ifdef YAMBLER_UTF8_CHARS
+	if(in[0] < 0x80){
+		*dest = in[0];
+		*consumed = 1;
+		return YAMBLER_CODEC_OK;
+	}
+	return decode_utf8_sequence(in, length, dest, consumed);
+#else
+	(void)length;
+	if(in[0] > 0x10FFFF || IS_SURROGATE(in[0])){
+		return YAMBLER_CODEC_INVALID;
+	}
+	*dest = in[0];
+	*consumed = 1;
+	return YAMBLER_CODEC_OK;
+#endif
+}
+
+enum yambler_codec_result yambler_codec_decode_utf8(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder){
+	assert(in != NULL && *in != NULL);
+	assert(out != NULL && *out != NULL);
+
+	pthread_once(&kernels_selected, &select_kernels);
+
+	const unsigned char *src = (const unsigned char *)*in;
+	size_t src_length = *in_remainder;
+	yambler_char *dest = *out;
+	size_t dest_length = *out_remainder;
+	enum yambler_codec_result result = YAMBLER_CODEC_OK;
+
+	while(src_length != 0 && dest_length != 0){
+		size_t count = (*copy_ascii)(src, src_length < dest_length ? src_length : dest_length, dest);
+		src += count;
+		src_length -= count;
+		dest += count;
+		dest_length -= count;
+		if(src_length == 0 || dest_length == 0){
+			break;
+		}
+		yambler_code_point c;
+		result = decode_utf8_sequence(src, src_length, &c, &count);
+		if(result != YAMBLER_CODEC_OK){
+			break;
+		}
+#ifdef YAMBLER_UTF8_CHARS
+		if(count > dest_length){
+			result = YAMBLER_CODEC_FULL;
+			break;
+		}
+		memcpy(dest, src, count);
+		dest += count;
+		dest_length -= count;
+#else
+		*dest = c;
+		++dest;
+		--dest_length;
+#endif
+		src += count;
+		src_length -= count;
+	}
+
+	*in = (const yambler_byte *)src;
+	*in_remainder = src_length;
+	*out = dest;
+	*out_remainder = dest_length;
+	return result;
+}
+
+enum yambler_codec_result yambler_codec_validate_utf8(const yambler_byte *in, size_t length, size_t *valid_length){
+	assert(in != NULL || length == 0);
+
+	const unsigned char *src = (const unsigned char *)in;
+	enum yambler_codec_result result = YAMBLER_CODEC_OK;
+	size_t i = 0;
+	while(i < length){
+		if(src[i] < 0x80){
+			uint64_t word;
+			while(i + sizeof(word) <= length){
+				memcpy(&word, src + i, sizeof(word));
+				if(word & 0x8080808080808080ull){
+					break;
+				}
+				i += sizeof(word);
+			}
+			while(i < length && src[i] < 0x80){
+				++i;
+			}
+			continue;
+		}
+		yambler_code_point c;
+		size_t count;
+		result = decode_utf8_sequence(src + i, length - i, &c, &count);
+		if(result != YAMBLER_CODEC_OK){
+			break;
+		}
+		i += count;
+	}
+	if(valid_length){
+		*valid_length = i;
+	}
+	return result;
+}
+
+static enum yambler_codec_result decode_utf16(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder, int big_endian){
+	assert(in != NULL && *in != NULL);
+	assert(out != NULL && *out != NULL);
+
+	pthread_once(&kernels_selected, &select_kernels);
+
+	const unsigned char *src = (const unsigned char *)*in;
+	size_t src_length = *in_remainder;
+	yambler_char *dest = *out;
+	size_t dest_length = *out_remainder;
+	enum yambler_codec_result result = YAMBLER_CODEC_OK;
+
+	while(src_length >= 2 && dest_length != 0){
+		size_t units = src_length / 2;
+		size_t count = (*copy_utf16)(src, units < dest_length ? units : dest_length, dest, big_endian);
+		src += 2 * count;
+		src_length -= 2 * count;
+		dest += count;
+		dest_length -= count;
+		if(src_length < 2 || dest_length == 0){
+			break;
+		}
+		yambler_code_point c = UTF16_UNIT(src, big_endian);
+		size_t size = 2;
+		if(IS_SURROGATE(c)){
+			if(c >= 0xDC00){
+				result = YAMBLER_CODEC_INVALID;
+				break;
+			}
+			if(src_length < 4){
+				result = YAMBLER_CODEC_INCOMPLETE;
+				break;
+			}
+			yambler_code_point low = UTF16_UNIT(src + 2, big_endian);
+			if(low < 0xDC00 || low > 0xDFFF){
+				result = YAMBLER_CODEC_INVALID;
+				break;
+			}
+			c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+			size = 4;
+		}
+		count = put_code_point(dest, dest_length, c);
+		if(count == 0){
+			result = YAMBLER_CODEC_FULL;
+			break;
+		}
+		src += size;
+		src_length -= size;
+		dest += count;
+		dest_length -= count;
+	}
+	if(result == YAMBLER_CODEC_OK && src_length == 1 && dest_length != 0){
+		result = YAMBLER_CODEC_INCOMPLETE;
+	}
+
+	*in = (const yambler_byte *)src;
+	*in_remainder = src_length;
+	*out = dest;
+	*out_remainder = dest_length;
+	return result;
+}
+
+enum yambler_codec_result yambler_codec_decode_utf16le(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder){
+	return decode_utf16(in, in_remainder, out, out_remainder, 0);
+}
+
+enum yambler_codec_result yambler_codec_decode_utf16be(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder){
+	return decode_utf16(in, in_remainder, out, out_remainder, 1);
+}
+
+static enum yambler_codec_result decode_utf32(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder, int big_endian){
+	assert(in != NULL && *in != NULL);
+	assert(out != NULL && *out != NULL);
+
+	const unsigned char *src = (const unsigned char *)*in;
+	size_t src_length = *in_remainder;
+	yambler_char *dest = *out;
+	size_t dest_length = *out_remainder;
+	enum yambler_codec_result result = YAMBLER_CODEC_OK;
+
+	while(src_length >= 4 && dest_length != 0){
+		yambler_code_point c;
+		if(big_endian){
+			c = ((yambler_code_point)src[0] << 24) | ((yambler_code_point)src[1] << 16) | ((yambler_code_point)src[2] << 8) | src[3];
+		}else{
+			c = ((yambler_code_point)src[3] << 24) | ((yambler_code_point)src[2] << 16) | ((yambler_code_point)src[1] << 8) | src[0];
+		}
+		if(c > 0x10FFFF || IS_SURROGATE(c)){
+			result = YAMBLER_CODEC_INVALID;
+			break;
+		}
+		size_t count = put_code_point(dest, dest_length, c);
+		if(count == 0){
+			result = YAMBLER_CODEC_FULL;
+			break;
+		}
+		src += 4;
+		src_length -= 4;
+		dest += count;
+		dest_length -= count;
+	}
+	if(result == YAMBLER_CODEC_OK && src_length != 0 && src_length < 4 && dest_length != 0){
+		result = YAMBLER_CODEC_INCOMPLETE;
+	}
+
+	*in = (const yambler_byte *)src;
+	*in_remainder = src_length;
+	*out = dest;
+	*out_remainder = dest_length;
+	return result;
+}
+
+enum yambler_codec_result yambler_codec_decode_utf32le(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder){
+	return decode_utf32(in, in_remainder, out, out_remainder, 0);
+}
+
+enum yambler_codec_result yambler_codec_decode_utf32be(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder){
+	return decode_utf32(in, in_remainder, out, out_remainder, 1);
+}
+
+/*
+ * Encoding of native characters, the kernels take care of the runs that need a single code unit
+ */
+
+static size_t put_utf16(unsigned char *out, size_t room, yambler_code_point c, int big_endian){
+	if(c < 0x10000){
+		if(room < 2){
+			return 0;
+		}
+		PUT_UTF16_UNIT(out, c, big_endian);
+		return 2;
+	}
+	if(room < 4){
+		return 0;
+	}
+	c -= 0x10000;
+	PUT_UTF16_UNIT(out, 0xD800 | (c >> 10), big_endian);
+	PUT_UTF16_UNIT(out + 2, 0xDC00 | (c & 0x3FF), big_endian);
+	return 4;
+}
+
+static size_t put_utf32(unsigned char *out, size_t room, yambler_code_point c, int big_endian){
+	if(room < 4){
+		return 0;
+	}
+	if(big_endian){
+		out[0] = (unsigned char)(c >> 24);
+		out[1] = (unsigned char)(c >> 16);
+		out[2] = (unsigned char)(c >> 8);
+		out[3] = (unsigned char)c;
+	}else{
+		out[0] = (unsigned char)c;
+		out[1] = (unsigned char)(c >> 8);
+		out[2] = (unsigned char)(c >> 16);
+		out[3] = (unsigned char)(c >> 24);
+	}
+	return 4;
+}
+
+static enum yambler_codec_result encode(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder, size_t unit_size, int big_endian){
+	assert(in != NULL && *in != NULL);
+	assert(out != NULL && *out != NULL);
+
+	pthread_once(&kernels_selected, &select_kernels);
+
+	const yambler_char *src = *in;
+	size_t src_length = *in_remainder;
+	unsigned char *dest = (unsigned char *)*out;
+	size_t dest_length = *out_remainder;
+	enum yambler_codec_result result = YAMBLER_CODEC_OK;
+
+	while(src_length != 0 && dest_length != 0){
+		size_t count;
+		if(unit_size == 1){
+			count = (*store_ascii)(src, src_length < dest_length ? src_length : dest_length, dest);
+		}else if(unit_size == 2){
+			size_t units = dest_length / 2;
+			count = (*store_utf16)(src, src_length < units ? src_length : units, dest, big_endian);
+		}else{
+			count = 0;
+		}
+		src += count;
+		src_length -= count;
+		dest += count * unit_size;
+		dest_length -= count * unit_size;
+		if(src_length == 0 || dest_length == 0){
+			break;
+		}
+		yambler_code_point c;
+		result = get_code_point(src, src_length, &c, &count);
+		if(result != YAMBLER_CODEC_OK){
+			break;
+		}
+		size_t size;
+		if(unit_size == 1){
+			size = put_utf8(dest, dest_length, c);
+		}else if(unit_size == 2){
+			size = put_utf16(dest, dest_length, c, big_endian);
+		}else{
+			size = put_utf32(dest, dest_length, c, big_endian);
+		}
+		if(size == 0){
+			result = YAMBLER_CODEC_FULL;
+			break;
+		}
+		src += count;
+		src_length -= count;
+		dest += size;
+		dest_length -= size;
+	}
+
+	*in = src;
+	*in_remainder = src_length;
+	*out = (yambler_byte *)dest;
+	*out_remainder = dest_length;
+	return result;
+}
+
+enum yambler_codec_result yambler_codec_encode_utf8(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder){
+	return encode(in, in_remainder, out, out_remainder, 1, 0);
+}
+
+enum yambler_codec_result yambler_codec_encode_utf16le(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder){
+	return encode(in, in_remainder, out, out_remainder, 2, 0);
+}
+
+enum yambler_codec_result yambler_codec_encode_utf16be(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder){
+	return encode(in, in_remainder, out, out_remainder, 2, 1);
+}
+
+enum yambler_codec_result yambler_codec_encode_utf32le(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder){
+	return encode(in, in_remainder, out, out_remainder, 4, 0);
+}
+
+enum yambler_codec_result yambler_codec_encode_utf32be(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder){
+	return encode(in, in_remainder, out, out_remainder, 4, 1);
+}
+
+enum yambler_encoding yambler_codec_detect_encoding(const yambler_byte *data, size_t length, size_t *bom_size){
+	enum yambler_encoding encoding;
+	const unsigned char *bom = (const unsigned char *)data;
+	if(length >= 4 && bom[0] == 0x00 && bom[1] == 0x00 && bom[2] == 0xFE && bom[3] == 0xFF){
+		encoding = YAMBLER_ENCODING_UTF_32BE;
+		*bom_size = 4;
+	}else if(length >= 4 && bom[0] == 0x00 && bom[1] == 0x00 && bom[2] == 0x00){
+		encoding = YAMBLER_ENCODING_UTF_32BE;
+		*bom_size = 0;
+	}else if(length >= 4 && bom[0] == 0xFF && bom[1] == 0xFE && bom[2] == 0x00 && bom[3] == 0x00){
+		encoding = YAMBLER_ENCODING_UTF_32LE;
+		*bom_size = 4;
+	}else if(length >= 4 && bom[1] == 0x00 && bom[2] == 0x00 && bom[3] == 0x00){
+		encoding = YAMBLER_ENCODING_UTF_32LE;
+		*bom_size = 0;
+	}else if(length >= 2 && bom[0] == 0xFE && bom[1] == 0xFF){
+		encoding = YAMBLER_ENCODING_UTF_16BE;
+		*bom_size = 2;
+	}else if(length >=2 && bom[0] == 0x00){
+		encoding = YAMBLER_ENCODING_UTF_16BE;
+		*bom_size = 0;
+	}else if(length >= 2 && bom[0] == 0xFF && bom[1] == 0xFE){
+		encoding = YAMBLER_ENCODING_UTF_16LE;
+		*bom_size = 2;
+	}else if(length >= 2 && bom[1] == 0x00){
+		encoding = YAMBLER_ENCODING_UTF_16LE;
+		*bom_size = 0;
+	}else{
+		if(length >= 3 && bom[0] == 0xEF && bom[1] == 0xBB && bom[2] == 0xBF){
+			*bom_size = 3;
+		}else{
+			*bom_size = 0;
+		}
+		encoding = YAMBLER_ENCODING_UTF_8;
+	}
+	return encoding;
+}
+
+yambler_codec_decode_function yambler_codec_decoder(enum yambler_encoding encoding){
+	switch(encoding){
+	case YAMBLER_ENCODING_UTF_8:
+		return &yambler_codec_decode_utf8;
+	case YAMBLER_ENCODING_UTF_16LE:
+		return &yambler_codec_decode_utf16le;
+	case YAMBLER_ENCODING_UTF_16BE:
+		return &yambler_codec_decode_utf16be;
+	case YAMBLER_ENCODING_UTF_32LE:
+		return &yambler_codec_decode_utf32le;
+	case YAMBLER_ENCODING_UTF_32BE:
+		return &yambler_codec_decode_utf32be;
+	default:
+		return NULL;
+	}
+}
+
+yambler_codec_encode_function yambler_codec_encoder(enum yambler_encoding encoding){
+	switch(encoding){
+	case YAMBLER_ENCODING_UTF_8:
+		return &yambler_codec_encode_utf8;
+	case YAMBLER_ENCODING_UTF_16LE:
+		return &yambler_codec_encode_utf16le;
+	case YAMBLER_ENCODING_UTF_16BE:
+		return &yambler_codec_encode_utf16be;
+	case YAMBLER_ENCODING_UTF_32LE:
+		return &yambler_codec_encode_utf32le;
+	case YAMBLER_ENCODING_UTF_32BE:
+		return &yambler_codec_encode_utf32be;
+	default:
+		return NULL;
+	}
+}
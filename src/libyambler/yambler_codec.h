@@ -0,0 +1,59 @@
+#ifndef YAMBLER_CODEC_H
+#define YAMBLER_CODEC_H
+
+#include "yambler_type.h"
+
+#include <stddef.h>
+
+/*
+ * Native conversion routines used by the decoder and the encoder in place of iconv.
+ * A conversion consumes input until either the input or the output is exhausted,
+ * advancing the pointers and decrementing the remaining lengths as it goes.
+ * Lengths of native character buffers are expressed in characters, lengths of encoded buffers in bytes.
+ * YAMBLER_CODEC_FULL is reported when the output has room left but not enough to hold the next character.
+ */
+
+enum yambler_codec_result{
+	YAMBLER_CODEC_OK,
+	YAMBLER_CODEC_INCOMPLETE,
+	YAMBLER_CODEC_INVALID,
+	YAMBLER_CODEC_FULL
+};
+
+typedef enum yambler_codec_result (*yambler_codec_decode_function)(const yambler_byte **, size_t *, yambler_char **, size_t *);
+
+typedef enum yambler_codec_result (*yambler_codec_encode_function)(const yambler_char **, size_t *, yambler_byte **, size_t *);
+
+/*
+ * Detects the encoding of a document from its first bytes, as described in the YAML specification.
+ * The size of the byte order mark, if any, is stored in bom_size.
+ */
+enum yambler_encoding yambler_codec_detect_encoding(const yambler_byte *data, size_t length, size_t *bom_size);
+
+yambler_codec_decode_function yambler_codec_decoder(enum yambler_encoding encoding);
+
+enum yambler_codec_result yambler_codec_decode_utf8(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_validate_utf8(const yambler_byte *in, size_t length, size_t *valid_length);
+
+enum yambler_codec_result yambler_codec_decode_utf16le(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_decode_utf16be(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_decode_utf32le(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_decode_utf32be(const yambler_byte **in, size_t *in_remainder, yambler_char **out, size_t *out_remainder);
+
+yambler_codec_encode_function yambler_codec_encoder(enum yambler_encoding encoding);
+
+enum yambler_codec_result yambler_codec_encode_utf8(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_encode_utf16le(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_encode_utf16be(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_encode_utf32le(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder);
+
+enum yambler_codec_result yambler_codec_encode_utf32be(const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder);
+
+#endif
@@ -1,5 +1,8 @@
 #include "yambler_decoder.h"
 
+#include "yambler_async_file.h"
+#include "yambler_codec.h"
+#include "yambler_read_ahead.h"
 #include "yambler_utility.h"
 
 #include <assert.h>
@@ -8,13 +11,31 @@
 #include <string.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <iconv.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MIN_BUFFER_SIZE 4
 
 #define DEFAULT_BUFFER_SIZE 4048
 
+#define READ_AHEAD_BLOCK_COUNT 2
+
+#define ASYNC_FILE_DEPTH 4
+
+enum yambler_decoder_source{
+	YAMBLER_DECODER_SOURCE_CALLBACK,
+	YAMBLER_DECODER_SOURCE_MAPPED,
+	YAMBLER_DECODER_SOURCE_MEMORY,
+	YAMBLER_DECODER_SOURCE_READ_AHEAD,
+	YAMBLER_DECODER_SOURCE_ASYNC_FILE
+};
+
 struct yambler_decoder{
+	const struct yambler_allocator *allocator;
+	enum yambler_decoder_source source;
 	yambler_byte *buffer;
 	yambler_byte *get;
 	size_t size;
@@ -22,6 +43,7 @@ struct yambler_decoder{
 	size_t read_count;
 
 	enum yambler_encoding encoding;
+	yambler_codec_decode_function native_decode;
 	iconv_t descriptor;
 
 	int opened;
@@ -31,7 +53,20 @@ struct yambler_decoder{
 	yambler_decoder_close_callback close;
 };
 
-yambler_status yambler_decoder_create(yambler_decoder_p *result, size_t buffer_size, enum yambler_encoding encoding, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close){
+static void yambler_decoder_init(yambler_decoder_p decoder, enum yambler_encoding encoding, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close){
+	decoder->read_count = 0;
+	decoder->length = 0;
+	decoder->encoding = encoding;
+	decoder->opened = 0;
+	decoder->read_state = state;
+	decoder->read = read;
+	decoder->open = open;
+	decoder->close = close;
+	decoder->native_decode = NULL;
+	decoder->descriptor = (iconv_t)-1;
+}
+
+yambler_status yambler_decoder_create(yambler_decoder_p *result, const struct yambler_allocator *allocator, size_t buffer_size, enum yambler_encoding encoding, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close){
 	assert(result != NULL);
 	
 	if(buffer_size == 0){
@@ -40,31 +75,140 @@ yambler_status yambler_decoder_create(yambler_decoder_p *result, size_t buffer_s
 		return YAMBLER_BOUNDS_ERROR;
 	}
 	
-	yambler_decoder_p decoder = malloc(sizeof(struct yambler_decoder));
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_decoder_p decoder = yambler_allocate(allocator, sizeof(struct yambler_decoder));
 	if(decoder == NULL){
 		return YAMBLER_ALLOC_ERROR;
 	}
+	decoder->allocator = allocator;
 	
-	decoder->buffer = malloc(sizeof(yambler_byte) * buffer_size);
+	decoder->buffer = yambler_allocate(allocator, sizeof(yambler_byte) * buffer_size);
 	if(decoder->buffer == NULL){
-		free(decoder);
+		yambler_release(allocator, decoder);
 		return YAMBLER_ALLOC_ERROR;
 	}
+	decoder->source = YAMBLER_DECODER_SOURCE_CALLBACK;
 	decoder->get = decoder->buffer;
 	decoder->size = buffer_size;
-	decoder->read_count = 0;
-	decoder->length = 0;
-	decoder->encoding = encoding;
-	decoder->opened = 0;
-	decoder->read_state = state;
-	decoder->read = read;
-	decoder->open = open;
-	decoder->close = close;
-	decoder->descriptor = (iconv_t)-1;
+	yambler_decoder_init(decoder, encoding, read, state, open, close);
+	*result = decoder;
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_decoder_create_with_read_ahead(yambler_decoder_p *result, const struct yambler_allocator *allocator, size_t buffer_size, enum yambler_encoding encoding, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close){
+	assert(result != NULL);
+
+	if(buffer_size == 0){
+		buffer_size = DEFAULT_BUFFER_SIZE;
+	}else if(buffer_size < MIN_BUFFER_SIZE){
+		return YAMBLER_BOUNDS_ERROR;
+	}
+
+	yambler_read_ahead_p read_ahead;
+	yambler_status status = yambler_read_ahead_create(&read_ahead, allocator, buffer_size, READ_AHEAD_BLOCK_COUNT, read, state, open, close);
+	if(status){
+		return status;
+	}
+	status = yambler_decoder_create(result, allocator, buffer_size, encoding, &yambler_read_ahead_read, (yambler_decoder_state)read_ahead, &yambler_read_ahead_open, &yambler_read_ahead_close);
+	if(status){
+		yambler_read_ahead_destroy(&read_ahead);
+		return status;
+	}
+	(*result)->source = YAMBLER_DECODER_SOURCE_READ_AHEAD;
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_decoder_create_from_async_file(yambler_decoder_p *result, const struct yambler_allocator *allocator, size_t buffer_size, const char *path, enum yambler_encoding encoding, yambler_async_file_flag options){
+	assert(result != NULL);
+	assert(path != NULL);
+
+	if(buffer_size == 0){
+		buffer_size = DEFAULT_BUFFER_SIZE;
+	}else if(buffer_size < MIN_BUFFER_SIZE){
+		return YAMBLER_BOUNDS_ERROR;
+	}
+
+	yambler_async_file_p file;
+	yambler_status status = yambler_async_file_create(&file, allocator, path, buffer_size, ASYNC_FILE_DEPTH, options);
+	if(status){
+		return status;
+	}
+	status = yambler_decoder_create(result, allocator, buffer_size, encoding, &yambler_async_file_read, (yambler_decoder_state)file, &yambler_async_file_open, &yambler_async_file_close);
+	if(status){
+		yambler_async_file_destroy(&file);
+		return status;
+	}
+	(*result)->source = YAMBLER_DECODER_SOURCE_ASYNC_FILE;
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_decoder_create_from_memory(yambler_decoder_p *result, const struct yambler_allocator *allocator, const yambler_byte *data, size_t length, enum yambler_encoding encoding){
+	assert(result != NULL);
+	assert(data != NULL || length == 0);
+
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_decoder_p decoder = yambler_allocate(allocator, sizeof(struct yambler_decoder));
+	if(decoder == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	decoder->allocator = allocator;
+	decoder->source = YAMBLER_DECODER_SOURCE_MEMORY;
+	decoder->buffer = (yambler_byte *)data;
+	decoder->get = decoder->buffer;
+	decoder->size = length;
+	yambler_decoder_init(decoder, encoding, NULL, NULL, NULL, NULL);
 	*result = decoder;
 	return YAMBLER_OK;
 }
 
+yambler_status yambler_decoder_create_from_fd(yambler_decoder_p *result, const struct yambler_allocator *allocator, int fd, enum yambler_encoding encoding){
+	assert(result != NULL);
+
+	struct stat file_stat;
+	if(fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode)){
+		return YAMBLER_ERROR;
+	}
+
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_decoder_p decoder = yambler_allocate(allocator, sizeof(struct yambler_decoder));
+	if(decoder == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	decoder->allocator = allocator;
+
+	size_t size = (size_t)file_stat.st_size;
+	if(size == 0){
+		decoder->buffer = NULL;
+	}else{
+		void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mapping == MAP_FAILED){
+			yambler_release(allocator, decoder);
+			return YAMBLER_ERROR;
+		}
+		madvise(mapping, size, MADV_SEQUENTIAL);
+		decoder->buffer = (yambler_byte *)mapping;
+	}
+	decoder->source = YAMBLER_DECODER_SOURCE_MAPPED;
+	decoder->get = decoder->buffer;
+	decoder->size = size;
+	yambler_decoder_init(decoder, encoding, NULL, NULL, NULL, NULL);
+	*result = decoder;
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_decoder_create_from_file(yambler_decoder_p *result, const struct yambler_allocator *allocator, const char *path, enum yambler_encoding encoding){
+	assert(result != NULL);
+	assert(path != NULL);
+
+	int fd = open(path, O_RDONLY);
+	if(fd == -1){
+		return YAMBLER_ERROR;
+	}
+	yambler_status status = yambler_decoder_create_from_fd(result, allocator, fd, encoding);
+	close(fd);
+	return status;
+}
+
 static yambler_status yambler_decoder_fill(yambler_decoder_p decoder){
 	if(decoder->read){
 		size_t remainder = decoder->size - decoder->length;
@@ -96,42 +240,8 @@ static yambler_status yambler_decoder_detect_encoding(yambler_decoder_p decoder,
 	if(status){
 		return status;
 	}
-	enum yambler_encoding encoding;
 	size_t bom_size;
-	size_t length = decoder->length;
-	yambler_byte *bom = decoder->get;
-	if(length >= 4 && bom[0] == 0x00 && bom[1] == 0x00 && bom[2] == 0xFE && bom[3] == 0xFF){
-		encoding = YAMBLER_ENCODING_UTF_32BE;
-		bom_size = 4;
-	}else if(length >= 4 && bom[0] == 0x00 && bom[1] == 0x00 && bom[2] == 0x00){
-		encoding = YAMBLER_ENCODING_UTF_32BE;
-		bom_size = 0;
-	}else if(length >= 4 && bom[0] == 0xFF && bom[1] == 0xFE && bom[2] == 0x00 && bom[3] == 0x00){
-		encoding = YAMBLER_ENCODING_UTF_32LE;
-		bom_size = 4;
-	}else if(length >= 4 && bom[1] == 0x00 && bom[2] == 0x00 && bom[3] == 0x00){
-		encoding = YAMBLER_ENCODING_UTF_32LE;
-		bom_size = 0;
-	}else if(length >= 2 && bom[0] == 0xFE && bom[1] == 0xFF){
-		encoding = YAMBLER_ENCODING_UTF_16BE;
-		bom_size = 2;
-	}else if(length >=2 && bom[0] == 0x00){
-		encoding = YAMBLER_ENCODING_UTF_16BE;
-		bom_size = 0;
-	}else if(length >= 2 && bom[0] == 0xFF && bom[1] == 0xFE){
-		encoding = YAMBLER_ENCODING_UTF_16LE;
-		bom_size = 2;
-	}else if(length >= 2 && bom[1] == 0x00){
-		encoding = YAMBLER_ENCODING_UTF_16LE;
-		bom_size = 0;
-	}else{
-		if(length >= 3 && bom[0] == 0xEF && bom[1] == 0xBB && bom[2] == 0xBF){
-			bom_size = 3;
-		}else{
-			bom_size = 0;
-		}
-		encoding = YAMBLER_ENCODING_UTF_8;
-	}
+	enum yambler_encoding encoding = yambler_codec_detect_encoding(decoder->get, decoder->length, &bom_size);
 	yambler_decoder_pop(decoder, bom_size);
 	*dest = encoding;
 	return YAMBLER_OK;
@@ -143,6 +253,14 @@ yambler_status yambler_decoder_open(yambler_decoder_p decoder){
 	if(decoder->opened){
 		yambler_decoder_close(decoder);
 	}
+
+	decoder->get = decoder->buffer;
+	decoder->read_count = 0;
+	if(decoder->source == YAMBLER_DECODER_SOURCE_MAPPED || decoder->source == YAMBLER_DECODER_SOURCE_MEMORY){
+		decoder->length = decoder->size;
+	}else{
+		decoder->length = 0;
+	}
 	
 	if(decoder->open){
 		yambler_status status = (*decoder->open)(&decoder->read_state);
@@ -160,29 +278,71 @@ yambler_status yambler_decoder_open(yambler_decoder_p decoder){
 			return status;
 		}
 	}
-	iconv_t descriptor = iconv_open(yambler_native_encoding_name(), yambler_encoding_name(encoding));
-	if(descriptor == (iconv_t)-1){
-		if(decoder->close){
-			(*decoder->close)(&decoder->read_state);
+	decoder->native_decode = yambler_codec_decoder(encoding);
+	if(decoder->native_decode == NULL){
+		iconv_t descriptor = iconv_open(yambler_native_encoding_name(), yambler_encoding_name(encoding));
+		if(descriptor == (iconv_t)-1){
+			if(decoder->close){
+				(*decoder->close)(&decoder->read_state);
+			}
+			return YAMBLER_ENCODING_ERROR;
 		}
-		return YAMBLER_ENCODING_ERROR;
+		decoder->descriptor = descriptor;
 	}
-	decoder->descriptor = descriptor;
 	decoder->opened = 1;
 	return YAMBLER_OK;
 }
 
+static yambler_status yambler_decoder_convert_native(yambler_decoder_p decoder, yambler_char **out, size_t *out_remainder, int *incomplete, int *full){
+	const yambler_byte *in = decoder->get;
+	size_t in_remainder = decoder->length;
+
+	enum yambler_codec_result result = (*decoder->native_decode)(&in, &in_remainder, out, out_remainder);
+	decoder->get = (yambler_byte *)in;
+	decoder->length = in_remainder;
+	if(result == YAMBLER_CODEC_INVALID){
+		return YAMBLER_ENCODING_ERROR;
+	}
+	*incomplete = result == YAMBLER_CODEC_INCOMPLETE;
+	*full = result == YAMBLER_CODEC_FULL;
+	return YAMBLER_OK;
+}
+
+static yambler_status yambler_decoder_convert_iconv(yambler_decoder_p decoder, yambler_char **out, size_t *out_remainder, int *incomplete, int *full){
+	size_t in_remainder = decoder->length * sizeof(yambler_byte);
+	char *in = (char *)decoder->get;
+	size_t out_bytes = *out_remainder * sizeof(yambler_char);
+	char *out_position = (char *)*out;
+
+	size_t result = iconv(decoder->descriptor, &in, &in_remainder, &out_position, &out_bytes);
+	decoder->get = (yambler_byte *)in;
+	decoder->length = in_remainder / sizeof(yambler_byte);
+	*out = (yambler_char *)out_position;
+	*out_remainder = out_bytes / sizeof(yambler_char);
+	if(result == (size_t)-1){
+		if(errno == EINVAL){
+			*incomplete = 1;
+		}else if(errno == EILSEQ){
+			return YAMBLER_ENCODING_ERROR;
+		}else if(errno == E2BIG){
+			*full = 1;
+		}
+	}
+	return YAMBLER_OK;
+}
+
 yambler_status yambler_decoder_decode(yambler_decoder_p decoder, yambler_char *buffer, size_t buffer_size, size_t *read_count){
 	assert(decoder != NULL);
 	assert(buffer != NULL);
 	assert(buffer_size != 0);
 
-	size_t out_remainder = sizeof(yambler_char) * buffer_size;
-	char *out = (char *)buffer;
+	size_t out_remainder = buffer_size;
+	yambler_char *out = buffer;
 	int incomplete = 0;
+	int full = 0;
 	
 	while(1){
-		if(out_remainder == 0){
+		if(out_remainder == 0 || full){
 			break;
 		}
 		if(incomplete){
@@ -201,22 +361,19 @@ yambler_status yambler_decoder_decode(yambler_decoder_p decoder, yambler_char *b
 				break;
 			}
 		}
-		size_t in_remainder = decoder->length * sizeof(yambler_byte);
-		char *in = (char *)decoder->get;
-		
-		size_t result = iconv(decoder->descriptor, &in, &in_remainder, &out, &out_remainder);
-		if(result == (size_t)-1){
-			if(errno == EINVAL){
-				incomplete = 1;
-			}else if(errno == EILSEQ){
-				return YAMBLER_ENCODING_ERROR;
-			}
+		yambler_status status;
+		if(decoder->native_decode){
+			status = yambler_decoder_convert_native(decoder, &out, &out_remainder, &incomplete, &full);
+		}else{
+			status = yambler_decoder_convert_iconv(decoder, &out, &out_remainder, &incomplete, &full);
+		}
+		if(status){
+			return status;
 		}
-		decoder->length = in_remainder / sizeof(yambler_byte); 
 	}
 
 	if(read_count){
-		*read_count = buffer_size - out_remainder / sizeof(yambler_char);
+		*read_count = buffer_size - out_remainder;
 	}
 	
 	return YAMBLER_OK;
@@ -226,8 +383,11 @@ void yambler_decoder_close(yambler_decoder_p decoder){
 	assert(decoder != NULL);
 
 	if(decoder->opened){
-		assert(decoder->descriptor != (iconv_t)-1);
-		iconv_close(decoder->descriptor);
+		if(decoder->descriptor != (iconv_t)-1){
+			iconv_close(decoder->descriptor);
+			decoder->descriptor = (iconv_t)-1;
+		}
+		decoder->native_decode = NULL;
 		if(decoder->close){
 			(*decoder->close)(&decoder->read_state);
 		}
@@ -243,8 +403,31 @@ void yambler_decoder_destroy(yambler_decoder_p *src){
 	assert(decoder != NULL);
 
 	yambler_decoder_close(decoder);
-	
-	free(decoder->buffer);
-	free(decoder);
+
+	switch(decoder->source){
+	case YAMBLER_DECODER_SOURCE_CALLBACK:
+		yambler_release(decoder->allocator, decoder->buffer);
+		break;
+	case YAMBLER_DECODER_SOURCE_READ_AHEAD:{
+		yambler_release(decoder->allocator, decoder->buffer);
+		yambler_read_ahead_p read_ahead = (yambler_read_ahead_p)decoder->read_state;
+		yambler_read_ahead_destroy(&read_ahead);
+		break;
+	}
+	case YAMBLER_DECODER_SOURCE_ASYNC_FILE:{
+		yambler_release(decoder->allocator, decoder->buffer);
+		yambler_async_file_p file = (yambler_async_file_p)decoder->read_state;
+		yambler_async_file_destroy(&file);
+		break;
+	}
+	case YAMBLER_DECODER_SOURCE_MAPPED:
+		if(decoder->buffer){
+			munmap(decoder->buffer, decoder->size);
+		}
+		break;
+	default:
+		break;
+	}
+	yambler_release(decoder->allocator, decoder);
 	*src = NULL;
 }
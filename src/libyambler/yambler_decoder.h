@@ -2,6 +2,7 @@
 #define YAMBLER_DECODER_H
 
 #include "yambler_type.h"
+#include "yambler_allocator.h"
 
 #include <stddef.h>
 
@@ -17,7 +18,25 @@ typedef yambler_status (*yambler_decoder_read_callback)(yambler_decoder_state, y
 
 typedef void (*yambler_decoder_close_callback)(yambler_decoder_state *);
 
-yambler_status yambler_decoder_create(yambler_decoder_p *result, size_t buffer_size, enum yambler_encoding encoding, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close);
+/*
+ * Options of the asynchronous file source, declared here as the decoder creates one and yambler_async_file.h
+ * depends on this header
+ */
+typedef int yambler_async_file_flag;
+
+#define YAMBLER_ASYNC_FILE_DIRECT 0x01
+
+yambler_status yambler_decoder_create(yambler_decoder_p *result, const struct yambler_allocator *allocator, size_t buffer_size, enum yambler_encoding encoding, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close);
+
+yambler_status yambler_decoder_create_with_read_ahead(yambler_decoder_p *result, const struct yambler_allocator *allocator, size_t buffer_size, enum yambler_encoding encoding, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close);
+
+yambler_status yambler_decoder_create_from_async_file(yambler_decoder_p *result, const struct yambler_allocator *allocator, size_t buffer_size, const char *path, enum yambler_encoding encoding, yambler_async_file_flag options);
+
+yambler_status yambler_decoder_create_from_memory(yambler_decoder_p *result, const struct yambler_allocator *allocator, const yambler_byte *data, size_t length, enum yambler_encoding encoding);
+
+yambler_status yambler_decoder_create_from_fd(yambler_decoder_p *result, const struct yambler_allocator *allocator, int fd, enum yambler_encoding encoding);
+
+yambler_status yambler_decoder_create_from_file(yambler_decoder_p *result, const struct yambler_allocator *allocator, const char *path, enum yambler_encoding encoding);
 
 yambler_status yambler_decoder_open(yambler_decoder_p decoder);
 
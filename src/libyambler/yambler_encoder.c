@@ -1,5 +1,8 @@
+#define _GNU_SOURCE
+
 #include "yambler_encoder.h"
 
+#include "yambler_codec.h"
 #include "yambler_utility.h"
 
 #include <assert.h>
@@ -8,26 +11,78 @@
 
 #include <iconv.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 #define MIN_BUFFER_SIZE 4
 #define DEFAULT_BUFFER_SIZE 4096
+#define DEFAULT_BLOCK_COUNT 16
+#define INITIAL_MAPPING_SIZE (1024 * 1024)
+
+/*
+ * The target decides what happens to the buffer once it is full.
+ * A callback target writes it out, a vectored target moves on to its next block and gathers all blocks
+ * into a single vectored write once the last one is full, a mapped target grows the file and its mapping.
+ */
+
+enum yambler_encoder_target{
+	YAMBLER_ENCODER_TARGET_CALLBACK,
+	YAMBLER_ENCODER_TARGET_VECTORED,
+	YAMBLER_ENCODER_TARGET_MAPPED
+};
 
 struct yambler_encoder{
+	const struct yambler_allocator *allocator;
+	enum yambler_encoder_target target;
 	yambler_byte *buffer;
 	size_t size;
 	size_t length;
+
+	yambler_byte *blocks;
+	struct iovec *vectors;
+	size_t block_count;
+	size_t block_index;
+
+	char *path;
+	int fd;
 	
 	enum yambler_encoding encoding;
 	yambler_encoder_flag options;
+	yambler_codec_encode_function native_encode;
 	iconv_t descriptor;
 
 	yambler_encoder_state write_state;
 	yambler_encoder_write_callback write;
+	yambler_encoder_writev_callback writev;
 	yambler_encoder_open_callback open;
 	yambler_encoder_close_callback close;
 };
 
-yambler_status yambler_encoder_create(yambler_encoder_p *dest, size_t buffer_size, enum yambler_encoding encoding, yambler_encoder_flag options, yambler_encoder_write_callback write, yambler_encoder_state state, yambler_encoder_open_callback open, yambler_encoder_close_callback close){
+static void yambler_encoder_init(yambler_encoder_p encoder, enum yambler_encoding encoding, yambler_encoder_flag options, yambler_encoder_state state, yambler_encoder_open_callback open, yambler_encoder_close_callback close){
+	encoder->length = 0;
+	encoder->blocks = NULL;
+	encoder->vectors = NULL;
+	encoder->block_count = 0;
+	encoder->block_index = 0;
+	encoder->path = NULL;
+	encoder->fd = -1;
+
+	encoder->encoding = encoding;
+
+	encoder->options = options;
+	encoder->native_encode = NULL;
+	encoder->descriptor = (iconv_t)-1;
+	
+	encoder->write_state = state;
+	encoder->write = NULL;
+	encoder->writev = NULL;
+	encoder->open = open;
+	encoder->close = close;
+}
+
+yambler_status yambler_encoder_create(yambler_encoder_p *dest, const struct yambler_allocator *allocator, size_t buffer_size, enum yambler_encoding encoding, yambler_encoder_flag options, yambler_encoder_write_callback write, yambler_encoder_state state, yambler_encoder_open_callback open, yambler_encoder_close_callback close){
 	assert(dest != NULL);
 	
 	if(buffer_size == 0){
@@ -36,34 +91,153 @@ yambler_status yambler_encoder_create(yambler_encoder_p *dest, size_t buffer_siz
 		return YAMBLER_BOUNDS_ERROR;
 	}
 
-	yambler_encoder_p encoder = malloc(sizeof(struct yambler_encoder));
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_encoder_p encoder = yambler_allocate(allocator, sizeof(struct yambler_encoder));
 	if(encoder == NULL){
 		return YAMBLER_ALLOC_ERROR;
 	}
+	encoder->allocator = allocator;
 	
-	encoder->buffer = malloc(sizeof(yambler_byte) * buffer_size);
+	encoder->buffer = yambler_allocate(allocator, sizeof(yambler_byte) * buffer_size);
 	if(encoder->buffer == NULL){
-		free(encoder);
+		yambler_release(allocator, encoder);
 		return YAMBLER_ALLOC_ERROR;
 	}
+	encoder->target = YAMBLER_ENCODER_TARGET_CALLBACK;
 	encoder->size = buffer_size;
-	encoder->length = 0;
-
-	encoder->encoding = encoding;
-
-	encoder->options = options;
-	encoder->descriptor = (iconv_t)-1;
-	
-	encoder->write_state = state;
+	yambler_encoder_init(encoder, encoding, options, state, open, close);
 	encoder->write = write;
-	encoder->open = open;
-	encoder->close = close;
 
 	*dest = encoder;
 	
 	return YAMBLER_OK;
 }
 
+yambler_status yambler_encoder_create_vectored(yambler_encoder_p *dest, const struct yambler_allocator *allocator, size_t buffer_size, size_t block_count, enum yambler_encoding encoding, yambler_encoder_flag options, yambler_encoder_writev_callback writev, yambler_encoder_state state, yambler_encoder_open_callback open, yambler_encoder_close_callback close){
+	assert(dest != NULL);
+	assert(writev != NULL);
+
+	if(buffer_size == 0){
+		buffer_size = DEFAULT_BUFFER_SIZE;
+	}else if(buffer_size < MIN_BUFFER_SIZE){
+		return YAMBLER_BOUNDS_ERROR;
+	}
+	if(block_count == 0){
+		block_count = DEFAULT_BLOCK_COUNT;
+	}
+
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_encoder_p encoder = yambler_allocate(allocator, sizeof(struct yambler_encoder));
+	if(encoder == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	encoder->allocator = allocator;
+	yambler_encoder_init(encoder, encoding, options, state, open, close);
+	encoder->blocks = yambler_allocate(allocator, sizeof(yambler_byte) * buffer_size * block_count);
+	encoder->vectors = yambler_allocate(allocator, sizeof(struct iovec) * block_count);
+	if(encoder->blocks == NULL || encoder->vectors == NULL){
+		yambler_release(allocator, encoder->vectors);
+		yambler_release(allocator, encoder->blocks);
+		yambler_release(allocator, encoder);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	for(size_t i = 0; i < block_count; ++i){
+		encoder->vectors[i].iov_base = encoder->blocks + i * buffer_size;
+		encoder->vectors[i].iov_len = 0;
+	}
+	encoder->target = YAMBLER_ENCODER_TARGET_VECTORED;
+	encoder->buffer = encoder->blocks;
+	encoder->size = buffer_size;
+	encoder->block_count = block_count;
+	encoder->writev = writev;
+
+	*dest = encoder;
+
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_encoder_create_to_file(yambler_encoder_p *dest, const struct yambler_allocator *allocator, const char *path, enum yambler_encoding encoding, yambler_encoder_flag options){
+	assert(dest != NULL);
+	assert(path != NULL);
+
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_encoder_p encoder = yambler_allocate(allocator, sizeof(struct yambler_encoder));
+	if(encoder == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	encoder->allocator = allocator;
+	yambler_encoder_init(encoder, encoding, options, NULL, NULL, NULL);
+	encoder->path = yambler_allocate(allocator, strlen(path) + 1);
+	if(encoder->path == NULL){
+		yambler_release(allocator, encoder);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	strcpy(encoder->path, path);
+	encoder->target = YAMBLER_ENCODER_TARGET_MAPPED;
+	encoder->buffer = NULL;
+	encoder->size = 0;
+
+	*dest = encoder;
+
+	return YAMBLER_OK;
+}
+
+static yambler_status yambler_encoder_map(yambler_encoder_p encoder){
+	encoder->fd = open(encoder->path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if(encoder->fd == -1){
+		return YAMBLER_ERROR;
+	}
+	if(ftruncate(encoder->fd, INITIAL_MAPPING_SIZE) == -1){
+		close(encoder->fd);
+		encoder->fd = -1;
+		return YAMBLER_ERROR;
+	}
+	void *mapping = mmap(NULL, INITIAL_MAPPING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, encoder->fd, 0);
+	if(mapping == MAP_FAILED){
+		close(encoder->fd);
+		encoder->fd = -1;
+		return YAMBLER_ERROR;
+	}
+	encoder->buffer = (yambler_byte *)mapping;
+	encoder->size = INITIAL_MAPPING_SIZE;
+	encoder->length = 0;
+	return YAMBLER_OK;
+}
+
+static yambler_status yambler_encoder_grow(yambler_encoder_p encoder){
+	size_t size = encoder->size * 2;
+	if(ftruncate(encoder->fd, (off_t)size) == -1){
+		return YAMBLER_ERROR;
+	}
+	void *mapping = mremap(encoder->buffer, encoder->size, size, MREMAP_MAYMOVE);
+	if(mapping == MAP_FAILED){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	encoder->buffer = (yambler_byte *)mapping;
+	encoder->size = size;
+	return YAMBLER_OK;
+}
+
+static yambler_status yambler_encoder_unmap(yambler_encoder_p encoder){
+	yambler_status status = YAMBLER_OK;
+	if(encoder->buffer){
+		munmap(encoder->buffer, encoder->size);
+		encoder->buffer = NULL;
+		encoder->size = 0;
+	}
+	if(encoder->fd != -1){
+		/* the mapping was grown ahead of the output, cut the file back to what was written */
+		if(ftruncate(encoder->fd, (off_t)encoder->length) == -1){
+			status = YAMBLER_ERROR;
+		}
+		if(close(encoder->fd) == -1){
+			status = YAMBLER_ERROR;
+		}
+		encoder->fd = -1;
+	}
+	return status;
+}
+
 static void add_bom(yambler_encoder_p encoder){
    
 	assert(encoder != NULL);
@@ -71,17 +245,17 @@ static void add_bom(yambler_encoder_p encoder){
 	
 	switch(encoder->encoding){
 	case YAMBLER_ENCODING_UTF_32BE:
-		encoder->buffer[0] = 0xFE;
-		encoder->buffer[1] = 0xFF;
-		encoder->buffer[2] = 0x00;
-		encoder->buffer[3] = 0x00;
+		encoder->buffer[0] = 0x00;
+		encoder->buffer[1] = 0x00;
+		encoder->buffer[2] = 0xFE;
+		encoder->buffer[3] = 0xFF;
 		encoder->length = 4;
 		break;
 	case YAMBLER_ENCODING_UTF_32LE:
-		encoder->buffer[0] = 0x00;
-		encoder->buffer[1] = 0x00;
-		encoder->buffer[2] = 0xFF;
-		encoder->buffer[3] = 0xFE;
+		encoder->buffer[0] = 0xFF;
+		encoder->buffer[1] = 0xFE;
+		encoder->buffer[2] = 0x00;
+		encoder->buffer[3] = 0x00;
 		encoder->length = 4;
 		break;
 	case YAMBLER_ENCODING_UTF_16BE:
@@ -108,9 +282,12 @@ static void add_bom(yambler_encoder_p encoder){
 yambler_status yambler_encoder_open(yambler_encoder_p encoder){
 	assert(encoder != NULL);
 	
-	encoder->descriptor = iconv_open(yambler_encoding_name(encoder->encoding), yambler_native_encoding_name());
-	if(encoder->descriptor == (iconv_t)-1){
-		return YAMBLER_ENCODING_ERROR;
+	encoder->native_encode = yambler_codec_encoder(encoder->encoding);
+	if(encoder->native_encode == NULL){
+		encoder->descriptor = iconv_open(yambler_encoding_name(encoder->encoding), yambler_native_encoding_name());
+		if(encoder->descriptor == (iconv_t)-1){
+			return YAMBLER_ENCODING_ERROR;
+		}
 	}
 
 	if(encoder->open){
@@ -120,15 +297,51 @@ yambler_status yambler_encoder_open(yambler_encoder_p encoder){
 		}
 	}
 
+	if(encoder->target == YAMBLER_ENCODER_TARGET_MAPPED){
+		yambler_status status = yambler_encoder_map(encoder);
+		if(status){
+			return status;
+		}
+	}
+
 	if(encoder->options & YAMBLER_ENCODER_INCLUDE_BOM){
 		add_bom(encoder);
 	}
 	return YAMBLER_OK;
 }
 
-static yambler_status yambler_encoder_flush(yambler_encoder_p encoder){
+static yambler_status yambler_encoder_flush_vectored(yambler_encoder_p encoder){
+	encoder->vectors[encoder->block_index].iov_len = encoder->length;
+	size_t total = 0;
+	for(size_t i = 0; i <= encoder->block_index; ++i){
+		total += encoder->vectors[i].iov_len;
+	}
+	if(total != 0){
+		size_t count;
+		yambler_status status = (*encoder->writev)(encoder->write_state, encoder->vectors, (int)(encoder->block_index + 1), &count);
+		if(status){
+			return status;
+		}else if(count != total){
+			return YAMBLER_ERROR;
+		}
+	}
+	encoder->block_index = 0;
+	encoder->buffer = encoder->blocks;
+	encoder->length = 0;
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_encoder_flush(yambler_encoder_p encoder){
 	assert(encoder != NULL);
 	
+	switch(encoder->target){
+	case YAMBLER_ENCODER_TARGET_VECTORED:
+		return yambler_encoder_flush_vectored(encoder);
+	case YAMBLER_ENCODER_TARGET_MAPPED:
+		return YAMBLER_OK;
+	default:
+		break;
+	}
 	if(encoder->write && encoder->length != 0){
 		size_t count;
 		yambler_status status = (*encoder->write)(encoder->write_state, encoder->buffer, encoder->length, &count);
@@ -142,49 +355,157 @@ static yambler_status yambler_encoder_flush(yambler_encoder_p encoder){
 	return YAMBLER_OK;
 }
 
+/*
+ * Makes room in a full buffer
+ */
+static yambler_status yambler_encoder_drain(yambler_encoder_p encoder){
+	switch(encoder->target){
+	case YAMBLER_ENCODER_TARGET_VECTORED:
+		if(encoder->block_index + 1 < encoder->block_count){
+			encoder->vectors[encoder->block_index].iov_len = encoder->length;
+			++encoder->block_index;
+			encoder->buffer = encoder->blocks + encoder->block_index * encoder->size;
+			encoder->length = 0;
+			return YAMBLER_OK;
+		}
+		return yambler_encoder_flush_vectored(encoder);
+	case YAMBLER_ENCODER_TARGET_MAPPED:
+		return yambler_encoder_grow(encoder);
+	default:
+		return yambler_encoder_flush(encoder);
+	}
+}
+
+static yambler_status yambler_encoder_convert_native(yambler_encoder_p encoder, const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder, int *incomplete, int *full){
+	enum yambler_codec_result result = (*encoder->native_encode)(in, in_remainder, out, out_remainder);
+	if(result == YAMBLER_CODEC_INVALID){
+		return YAMBLER_ENCODING_ERROR;
+	}
+	*incomplete = result == YAMBLER_CODEC_INCOMPLETE;
+	*full = result == YAMBLER_CODEC_FULL || *out_remainder == 0;
+	return YAMBLER_OK;
+}
+
+static yambler_status yambler_encoder_convert_iconv(yambler_encoder_p encoder, const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder, int *incomplete, int *full){
+	char *in_position = (char *)*in;
+	size_t in_bytes = *in_remainder * sizeof(yambler_char);
+	char *out_position = (char *)*out;
+	size_t out_bytes = *out_remainder * sizeof(yambler_byte);
+
+	size_t result = iconv(encoder->descriptor, &in_position, &in_bytes, &out_position, &out_bytes);
+	*in = (const yambler_char *)in_position;
+	*in_remainder = in_bytes / sizeof(yambler_char);
+	*out = (yambler_byte *)out_position;
+	*out_remainder = out_bytes / sizeof(yambler_byte);
+	if(result == (size_t)-1){
+		if(errno == EILSEQ){
+			return YAMBLER_ENCODING_ERROR;
+		}else if(errno == EINVAL){
+			*incomplete = 1;
+		}else if(errno == E2BIG){
+			*full = 1;
+		}
+	}
+	return YAMBLER_OK;
+}
+
+static yambler_status yambler_encoder_convert(yambler_encoder_p encoder, const yambler_char **in, size_t *in_remainder, yambler_byte **out, size_t *out_remainder, int *incomplete, int *full){
+	*incomplete = 0;
+	*full = 0;
+	if(encoder->native_encode){
+		return yambler_encoder_convert_native(encoder, in, in_remainder, out, out_remainder, incomplete, full);
+	}else{
+		return yambler_encoder_convert_iconv(encoder, in, in_remainder, out, out_remainder, incomplete, full);
+	}
+}
+
 yambler_status yambler_encoder_encode(yambler_encoder_p encoder, const yambler_char *buffer, size_t buffer_size, size_t *write_count){
 	assert(encoder != NULL);
 	assert(buffer != NULL);
 
-	size_t in_remainder = buffer_size * sizeof(yambler_char);
-	char *in = (char *)buffer;
+	const yambler_char *in = buffer;
+	size_t in_remainder = buffer_size;
 	
-	while(1){
-		char *out = (char *)(encoder->buffer + encoder->length);
-		size_t out_remainder = (encoder->size - encoder->length) * sizeof(yambler_byte);
-		
-		size_t result = iconv(encoder->descriptor, &in, &in_remainder, &out, &out_remainder);
-		if(result == (size_t)-1){
-			if(errno == EINVAL || errno == EILSEQ){
-				return YAMBLER_ENCODING_ERROR;
-			}
-		}
-		encoder->length = encoder->size - out_remainder / sizeof(yambler_byte);
-
-		yambler_status status = yambler_encoder_flush(encoder);
+	while(in_remainder != 0){
+		int incomplete;
+		int full;
+		yambler_byte *out = encoder->buffer + encoder->length;
+		size_t out_remainder = encoder->size - encoder->length;
+		yambler_status status = yambler_encoder_convert(encoder, &in, &in_remainder, &out, &out_remainder, &incomplete, &full);
+		encoder->length = encoder->size - out_remainder;
 		if(status){
 			return status;
 		}
-		if(in_remainder == 0){
+		if(incomplete){
+			/* the tail of the buffer starts a character that is continued by the next call */
 			break;
 		}
+		if(full){
+			status = yambler_encoder_drain(encoder);
+			if(status){
+				return status;
+			}
+		}
 	}
 
 	if(write_count){
-		*write_count = in_remainder / sizeof(yambler_char);
+		*write_count = buffer_size - in_remainder;
 	}
 	
 	return YAMBLER_OK;
 }
 
+yambler_status yambler_encoder_encode_span(yambler_encoder_p encoder, const yambler_char *buffer, size_t buffer_size, size_t *read_count, yambler_byte *span, size_t span_size, size_t *write_count){
+	assert(encoder != NULL);
+	assert(buffer != NULL || buffer_size == 0);
+	assert(span != NULL);
+	assert(encoder->target == YAMBLER_ENCODER_TARGET_CALLBACK);
+
+	yambler_byte *out = span;
+	size_t out_remainder = span_size;
+	if(encoder->length != 0){
+		/* bytes that are still buffered, such as the byte order mark, go first */
+		size_t count = encoder->length < out_remainder ? encoder->length : out_remainder;
+		memcpy(out, encoder->buffer, count);
+		memmove(encoder->buffer, encoder->buffer + count, encoder->length - count);
+		encoder->length -= count;
+		out += count;
+		out_remainder -= count;
+	}
+
+	const yambler_char *in = buffer;
+	size_t in_remainder = buffer_size;
+	yambler_status status = YAMBLER_OK;
+	if(encoder->length == 0 && in_remainder != 0 && out_remainder != 0){
+		int incomplete;
+		int full;
+		status = yambler_encoder_convert(encoder, &in, &in_remainder, &out, &out_remainder, &incomplete, &full);
+	}
+
+	if(read_count){
+		*read_count = buffer_size - in_remainder;
+	}
+	if(write_count){
+		*write_count = span_size - out_remainder;
+	}
+	return status;
+}
+
 void yambler_encoder_close(yambler_encoder_p encoder){
 	assert(encoder != NULL);
 	
+	yambler_encoder_flush(encoder);
+	if(encoder->target == YAMBLER_ENCODER_TARGET_MAPPED){
+		yambler_encoder_unmap(encoder);
+	}
 	if(encoder->close){
 		(*encoder->close)(&encoder->write_state);
 	}
-	iconv_close(encoder->descriptor);
+	if(encoder->descriptor != (iconv_t)-1){
+		iconv_close(encoder->descriptor);
+	}
 	encoder->length = 0;
+	encoder->native_encode = NULL;
 	encoder->descriptor = (iconv_t)-1;
 }
 
@@ -193,7 +514,19 @@ void yambler_encoder_destroy(yambler_encoder_p *src){
 	assert(*src != NULL);
 
 	yambler_encoder_p encoder = *src;
-	free(encoder->buffer);
-	free(encoder);
+	switch(encoder->target){
+	case YAMBLER_ENCODER_TARGET_VECTORED:
+		yambler_release(encoder->allocator, encoder->vectors);
+		yambler_release(encoder->allocator, encoder->blocks);
+		break;
+	case YAMBLER_ENCODER_TARGET_MAPPED:
+		yambler_encoder_unmap(encoder);
+		yambler_release(encoder->allocator, encoder->path);
+		break;
+	default:
+		yambler_release(encoder->allocator, encoder->buffer);
+		break;
+	}
+	yambler_release(encoder->allocator, encoder);
 	*src = NULL;
 }
@@ -2,8 +2,10 @@
 #define YAMBLER_ENCODER_H
 
 #include "yambler_type.h"
+#include "yambler_allocator.h"
 
 #include <stddef.h>
+#include <sys/uio.h>
 
 struct yambler_encoder;
 
@@ -13,6 +15,8 @@ typedef void * yambler_encoder_state;
 
 typedef yambler_status (*yambler_encoder_write_callback)(yambler_encoder_state, const yambler_byte *, size_t, size_t *);
 
+typedef yambler_status (*yambler_encoder_writev_callback)(yambler_encoder_state, const struct iovec *, int, size_t *);
+
 typedef yambler_status (*yambler_encoder_open_callback)(yambler_encoder_state *);
 
 typedef void (*yambler_encoder_close_callback)(yambler_encoder_state *);
@@ -21,12 +25,32 @@ typedef int yambler_encoder_flag;
 
 #define YAMBLER_ENCODER_INCLUDE_BOM 0x01
 
-yambler_status yambler_encoder_create(yambler_encoder_p *dest, size_t buffer_size, enum yambler_encoding encoding, yambler_encoder_flag options, yambler_encoder_write_callback write, yambler_encoder_state state, yambler_encoder_open_callback open, yambler_encoder_close_callback close);
+yambler_status yambler_encoder_create(yambler_encoder_p *dest, const struct yambler_allocator *allocator, size_t buffer_size, enum yambler_encoding encoding, yambler_encoder_flag options, yambler_encoder_write_callback write, yambler_encoder_state state, yambler_encoder_open_callback open, yambler_encoder_close_callback close);
+
+/*
+ * Creates an encoder that fills block_count buffers of buffer_size bytes before handing all of them to a single vectored write
+ */
+yambler_status yambler_encoder_create_vectored(yambler_encoder_p *dest, const struct yambler_allocator *allocator, size_t buffer_size, size_t block_count, enum yambler_encoding encoding, yambler_encoder_flag options, yambler_encoder_writev_callback writev, yambler_encoder_state state, yambler_encoder_open_callback open, yambler_encoder_close_callback close);
+
+/*
+ * Creates an encoder that encodes straight into a shared mapping of the file at path.
+ * The file is created on open, grown with ftruncate as the output grows, and cut to size on close.
+ */
+yambler_status yambler_encoder_create_to_file(yambler_encoder_p *dest, const struct yambler_allocator *allocator, const char *path, enum yambler_encoding encoding, yambler_encoder_flag options);
 
 yambler_status yambler_encoder_open(yambler_encoder_p encoder);
 
 yambler_status yambler_encoder_encode(yambler_encoder_p encoder, const yambler_char *buffer, size_t buffer_size, size_t *write_count);
 
+/*
+ * Encodes into a span supplied by the caller instead of the encoder's buffer, stopping when either the input or the span runs out.
+ * Bytes still buffered by the encoder, such as the byte order mark, are moved into the span first.
+ * Only supported for encoders created with a write callback.
+ */
+yambler_status yambler_encoder_encode_span(yambler_encoder_p encoder, const yambler_char *buffer, size_t buffer_size, size_t *read_count, yambler_byte *span, size_t span_size, size_t *write_count);
+
+yambler_status yambler_encoder_flush(yambler_encoder_p encoder);
+
 void yambler_encoder_close(yambler_encoder_p encoder);
 
 void yambler_encoder_destroy(yambler_encoder_p *src);
@@ -3,49 +3,113 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* the most characters a code point is decoded into */
+#ifdef YAMBLER_UTF8_CHARS
+#define INPUT_BUFFER_MAX_CHAR_LENGTH 4
+#else
+#define INPUT_BUFFER_MAX_CHAR_LENGTH 1
+#endif
+
+struct yambler_input_buffer_block{
+	yambler_char *data;
+	size_t size;
+};
 
 struct yambler_input_buffer{
+	const struct yambler_allocator *allocator;
 	yambler_char *data;
 	size_t size;
-	size_t size_increment;
 	yambler_char *get;
 	size_t length;
 
+	struct yambler_input_buffer_policy policy;
+	struct yambler_input_buffer_stats stats;
+
 	int opened;
+	int held;
+
+	/*
+	 * The blocks replaced while the buffer is held come first, followed by spare blocks. Releasing the buffer turns
+	 * the retired blocks into spares, so that a buffer held across refills again and again stops allocating.
+	 */
+	struct yambler_input_buffer_block *blocks;
+	size_t blocks_size;
+	size_t retired_count;
+	size_t spare_count;
+	yambler_decoder_p decoder;
+	int owns_decoder;
 	yambler_input_buffer_state read_state;
 	yambler_input_buffer_open_callback open;
 	yambler_input_buffer_read_callback read;
 	yambler_input_buffer_close_callback close;
 };
 
-#define DEFAULT_SIZE 1024;
-#define DEFAULT_SIZE_INCREMENT 1024
+#define DEFAULT_SIZE 1024
+#define DEFAULT_GROWTH_FACTOR 2
+#define DEFAULT_MIN_GROWTH 1024
 
-yambler_status yambler_input_buffer_create(yambler_input_buffer_p *dest, size_t initial_size, yambler_input_buffer_state state, yambler_input_buffer_read_callback read, yambler_input_buffer_open_callback open, yambler_input_buffer_close_callback close){
+yambler_status yambler_input_buffer_create(yambler_input_buffer_p *dest, const struct yambler_allocator *allocator, const struct yambler_input_buffer_policy *policy, yambler_input_buffer_state state, yambler_input_buffer_read_callback read, yambler_input_buffer_open_callback open, yambler_input_buffer_close_callback close){
 
   assert(dest != NULL);
 
-  yambler_input_buffer_p buffer = malloc(sizeof(struct yambler_input_buffer));
-
-  if(initial_size == 0){
-    initial_size = DEFAULT_SIZE;
-  }
+  allocator = yambler_allocator_or_default(allocator);
+  yambler_input_buffer_p buffer = yambler_allocate(allocator, sizeof(struct yambler_input_buffer));
 
   if(buffer == NULL){
     return YAMBLER_ALLOC_ERROR;
   }
+  buffer->allocator = allocator;
 
-  buffer->data = malloc(sizeof(yambler_char) * initial_size);
+  buffer->policy.initial_size = DEFAULT_SIZE;
+  buffer->policy.max_size = 0;
+  buffer->policy.growth_factor = DEFAULT_GROWTH_FACTOR;
+  buffer->policy.min_growth = DEFAULT_MIN_GROWTH;
+  if(policy){
+    if(policy->initial_size){
+      buffer->policy.initial_size = policy->initial_size;
+    }
+    if(policy->max_size){
+      buffer->policy.max_size = policy->max_size;
+      if(buffer->policy.initial_size > policy->max_size){
+        buffer->policy.initial_size = policy->max_size;
+      }
+    }
+    if(policy->growth_factor){
+      buffer->policy.growth_factor = policy->growth_factor;
+    }
+    if(policy->min_growth){
+      buffer->policy.min_growth = policy->min_growth;
+    }
+  }
+
+  buffer->data = yambler_allocate(allocator, sizeof(yambler_char) * buffer->policy.initial_size);
   if(buffer->data == NULL){
-    free(buffer);
+    yambler_release(allocator, buffer);
     return YAMBLER_ALLOC_ERROR;
   }
-  buffer->size = initial_size;
-  buffer->size_increment = DEFAULT_SIZE_INCREMENT;
+  buffer->size = buffer->policy.initial_size;
   buffer->length = 0;
   buffer->get = buffer->data;
+
+  buffer->stats.size = buffer->size;
+  buffer->stats.high_water_size = buffer->size;
+  buffer->stats.high_water_length = 0;
+  buffer->stats.grow_count = 0;
+  buffer->stats.compact_count = 0;
+  buffer->stats.compacted_length = 0;
+  buffer->stats.retire_count = 0;
+
+  buffer->blocks = NULL;
+  buffer->blocks_size = 0;
+  buffer->retired_count = 0;
+  buffer->spare_count = 0;
   
   buffer->opened = 0;
+  buffer->held = 0;
+  buffer->decoder = NULL;
+  buffer->owns_decoder = 0;
   buffer->read_state = state;
   buffer->open = open;
   buffer->read = read;
@@ -56,28 +120,29 @@ yambler_status yambler_input_buffer_create(yambler_input_buffer_p *dest, size_t
   return YAMBLER_OK;
 }
 
-static yambler_status open_decoder(yambler_input_buffer_state *state){
-	assert(state != NULL);
-	yambler_decoder_p decoder = (yambler_decoder_p)*state;
+yambler_status yambler_input_buffer_create_with_decoder(yambler_input_buffer_p *dest, const struct yambler_allocator *allocator, const struct yambler_input_buffer_policy *policy, yambler_decoder_p decoder){
 	assert(decoder != NULL);
-	return yambler_decoder_open(decoder);
-}
-
-static yambler_status read_decoder(yambler_input_buffer_state state, yambler_char *buffer, size_t buffer_size, size_t *read_count){
-	assert(state != NULL);
-	yambler_decoder_p decoder = (yambler_decoder_p)state;
-	return yambler_decoder_decode(decoder, buffer, buffer_size, read_count);
-}
-
-static void close_decoder(yambler_input_buffer_state *state){
-	assert(state != NULL);
-	yambler_decoder_p decoder = (yambler_decoder_p)*state;
-	yambler_decoder_close(decoder);
+	yambler_status status = yambler_input_buffer_create(dest, allocator, policy, NULL, NULL, NULL, NULL);
+	if(status){
+		return status;
+	}
+	(*dest)->decoder = decoder;
+	return YAMBLER_OK;
 }
 
-yambler_status yambler_input_buffer_create_with_decoder(yambler_input_buffer_p *dest, size_t initial_size, yambler_decoder_p decoder){
-	assert(decoder != NULL);
-	return yambler_input_buffer_create(dest, initial_size, (yambler_input_buffer_state)decoder, &read_decoder, &open_decoder, &close_decoder);
+yambler_status yambler_input_buffer_create_from_memory(yambler_input_buffer_p *dest, const struct yambler_allocator *allocator, const struct yambler_input_buffer_policy *policy, const yambler_byte *data, size_t length, enum yambler_encoding encoding){
+	yambler_decoder_p decoder;
+	yambler_status status = yambler_decoder_create_from_memory(&decoder, allocator, data, length, encoding);
+	if(status){
+		return status;
+	}
+	status = yambler_input_buffer_create_with_decoder(dest, allocator, policy, decoder);
+	if(status){
+		yambler_decoder_destroy(&decoder);
+		return status;
+	}
+	(*dest)->owns_decoder = 1;
+	return YAMBLER_OK;
 }
 
 yambler_status yambler_input_buffer_open(yambler_input_buffer_p buffer){
@@ -85,62 +150,257 @@ yambler_status yambler_input_buffer_open(yambler_input_buffer_p buffer){
 		yambler_input_buffer_close(buffer);
 	}
 	buffer->opened = 1;
+	yambler_input_buffer_release(buffer);
 	buffer->get = buffer->data;
 	buffer->length = 0;
-	if(buffer->open){
+	if(buffer->decoder){
+		return yambler_decoder_open(buffer->decoder);
+	}else if(buffer->open){
 		return (*buffer->open)(&buffer->read_state);
 	}else{
 		return YAMBLER_OK;
 	}
 }
 
-size_t calculate_next_size(yambler_input_buffer_p buffer, size_t min_length){
-	size_t increment = (min_length - buffer->size);
-	return increment % buffer->size_increment == 0 ? buffer->size + increment : buffer->size + ((increment / buffer->size_increment) + 1) * buffer->size_increment;
+static size_t calculate_next_size(yambler_input_buffer_p buffer, size_t min_length){
+	const struct yambler_input_buffer_policy *policy = &buffer->policy;
+	size_t next_size = buffer->size * policy->growth_factor;
+	if(next_size / policy->growth_factor != buffer->size || next_size - buffer->size < policy->min_growth){
+		next_size = buffer->size + policy->min_growth;
+	}
+	if(next_size < min_length){
+		next_size = min_length;
+	}
+	if(policy->max_size && next_size > policy->max_size){
+		next_size = policy->max_size;
+	}
+	return next_size;
 }
 
 yambler_status yambler_input_buffer_fill(yambler_input_buffer_p buffer){
-	if(buffer->read){
-		yambler_char *put = buffer->get + buffer->length;
-		size_t remainder = (buffer->data + buffer->size) - put;
-		size_t read_count;
-		
-		yambler_status status = (*buffer->read)(buffer->read_state, buffer->get+buffer->length, remainder, &read_count);
-		if(status){
-			return status;
-		}
-		buffer->length+=read_count;
+	if(buffer->length == 0 && !buffer->held){
+		buffer->get = buffer->data;
+	}
+	yambler_char *put = buffer->get + buffer->length;
+	size_t remainder = (buffer->data + buffer->size) - put;
+	if(remainder == 0){
+		return YAMBLER_OK;
+	}
+	size_t read_count = 0;
+	yambler_status status = YAMBLER_OK;
+	if(buffer->decoder){
+		status = yambler_decoder_decode(buffer->decoder, put, remainder, &read_count);
+	}else if(buffer->read){
+		status = (*buffer->read)(buffer->read_state, put, remainder, &read_count);
+	}
+	if(status){
+		return status;
 	}
+	buffer->length+=read_count;
 	return YAMBLER_OK;
 }
 
 static yambler_status yambler_input_buffer_grow(yambler_input_buffer_p buffer, size_t min_length){
-	size_t min_growth = min_length - buffer->size;
-	size_t growth = (min_growth / buffer->size_increment) * buffer->size_increment;
-	if((growth % buffer->size_increment) != 0){
-		growth+=buffer->size_increment;
-	}
-	size_t new_size = buffer->size + growth;
-	if(new_size > buffer->size){
-		yambler_char *new_data = realloc(buffer->data, new_size);
+	if(buffer->policy.max_size && min_length > buffer->policy.max_size){
+		return YAMBLER_BOUNDS_ERROR;
+	}
+	size_t new_size = calculate_next_size(buffer, min_length);
+	yambler_char *new_data = yambler_reallocate(buffer->allocator, buffer->data, sizeof(yambler_char) * new_size);
+	if(new_data == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	buffer->get = new_data + (buffer->get - buffer->data);
+	buffer->data = new_data;
+	buffer->size = new_size;
+	++buffer->stats.grow_count;
+	buffer->stats.size = new_size;
+	if(new_size > buffer->stats.high_water_size){
+		buffer->stats.high_water_size = new_size;
+	}
+	return YAMBLER_OK;
+}
+
+/*
+ * Moves the unread characters into another block of at least min_length characters, leaving the current block
+ * untouched for the pointers handed out while the buffer is held
+ */
+static yambler_status yambler_input_buffer_retire(yambler_input_buffer_p buffer, size_t min_length){
+	size_t new_size = buffer->size;
+	if(min_length > new_size){
+		if(buffer->policy.max_size && min_length > buffer->policy.max_size){
+			return YAMBLER_BOUNDS_ERROR;
+		}
+		new_size = calculate_next_size(buffer, min_length);
+	}
+	yambler_char *new_data = NULL;
+	if(buffer->spare_count){
+		/* the first spare is taken, which leaves its place to the block being retired */
+		struct yambler_input_buffer_block *spare = &buffer->blocks[buffer->retired_count];
+		--buffer->spare_count;
+		if(spare->size >= new_size){
+			new_data = spare->data;
+			new_size = spare->size;
+		}else{
+			yambler_release(buffer->allocator, spare->data);
+		}
+	}else if(buffer->retired_count == buffer->blocks_size){
+		size_t blocks_size = buffer->blocks_size ? buffer->blocks_size * 2 : 4;
+		struct yambler_input_buffer_block *blocks = yambler_reallocate(buffer->allocator, buffer->blocks, sizeof(struct yambler_input_buffer_block) * blocks_size);
+		if(blocks == NULL){
+			return YAMBLER_ALLOC_ERROR;
+		}
+		buffer->blocks = blocks;
+		buffer->blocks_size = blocks_size;
+	}
+	if(new_data == NULL){
+		new_data = yambler_allocate(buffer->allocator, sizeof(yambler_char) * new_size);
 		if(new_data == NULL){
+			/* the last spare fills the place of the one released */
+			buffer->blocks[buffer->retired_count] = buffer->blocks[buffer->retired_count + buffer->spare_count];
 			return YAMBLER_ALLOC_ERROR;
 		}
-		buffer->get = new_data + (buffer->get - buffer->data);
-		buffer->data = new_data;
-		buffer->size = new_size;
+	}
+	memcpy(new_data, buffer->get, sizeof(yambler_char) * buffer->length);
+	buffer->blocks[buffer->retired_count].data = buffer->data;
+	buffer->blocks[buffer->retired_count].size = buffer->size;
+	++buffer->retired_count;
+	buffer->data = new_data;
+	buffer->get = new_data;
+	buffer->size = new_size;
+	++buffer->stats.retire_count;
+	buffer->stats.size = new_size;
+	if(new_size > buffer->stats.high_water_size){
+		buffer->stats.high_water_size = new_size;
 	}
 	return YAMBLER_OK;
 }
 
+static void yambler_input_buffer_compact(yambler_input_buffer_p buffer){
+	memmove(buffer->data, buffer->get, sizeof(yambler_char) * buffer->length);
+	buffer->get = buffer->data;
+	++buffer->stats.compact_count;
+	buffer->stats.compacted_length += buffer->length;
+}
+
+/*
+ * Reads until at least min_length characters are buffered or the input is exhausted.
+ * The unread characters are moved to the front first when more than half of the buffer has been consumed,
+ * or when the space behind them is too small for the request. A held buffer moves them into another block instead,
+ * and only when it has to.
+ */
 static yambler_status yambler_input_buffer_ensure(yambler_input_buffer_p buffer, size_t min_length){
-	if(min_length < buffer->size){
+	if(buffer->length >= min_length){
+		return YAMBLER_OK;
+	}
+	if(buffer->held){
+		if(buffer->size - (buffer->get - buffer->data) < min_length){
+			yambler_status status = yambler_input_buffer_retire(buffer, min_length);
+			if(status){
+				return status;
+			}
+		}
+	}else if(buffer->length == 0){
+		buffer->get = buffer->data;
+	}else{
+		size_t offset = buffer->get - buffer->data;
+		if(offset > buffer->size / 2 || buffer->size - offset < min_length){
+			yambler_input_buffer_compact(buffer);
+		}
+	}
+	if(min_length > buffer->size){
 		yambler_status status = yambler_input_buffer_grow(buffer, min_length);
 		if(status){
 			return status;
 		}
 	}
-	return yambler_input_buffer_fill(buffer);
+	while(buffer->length < min_length){
+		size_t length = buffer->length;
+		yambler_status status = yambler_input_buffer_fill(buffer);
+		if(status){
+			return status;
+		}
+		if(buffer->length == length){
+			/* the space left may be too small for the next character to be decoded, which is not yet the end */
+			if(buffer->get != buffer->data){
+				if(buffer->held){
+					status = yambler_input_buffer_retire(buffer, min_length);
+					if(status){
+						return status;
+					}
+				}else{
+					yambler_input_buffer_compact(buffer);
+				}
+				continue;
+			}
+			if(buffer->size - buffer->length < INPUT_BUFFER_MAX_CHAR_LENGTH && (buffer->policy.max_size == 0 || buffer->length + INPUT_BUFFER_MAX_CHAR_LENGTH <= buffer->policy.max_size)){
+				if(buffer->held){
+					status = yambler_input_buffer_retire(buffer, buffer->length + INPUT_BUFFER_MAX_CHAR_LENGTH);
+				}else{
+					status = yambler_input_buffer_grow(buffer, buffer->length + INPUT_BUFFER_MAX_CHAR_LENGTH);
+				}
+				if(status){
+					return status;
+				}
+				continue;
+			}
+			break;
+		}
+	}
+	if(buffer->length > buffer->stats.high_water_length){
+		buffer->stats.high_water_length = buffer->length;
+	}
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_input_buffer_span(yambler_input_buffer_p buffer, size_t min_length, const yambler_char **dest, size_t *length){
+	assert(buffer != NULL);
+	assert(dest != NULL);
+	assert(length != NULL);
+	assert(buffer->opened);
+	yambler_status status = yambler_input_buffer_ensure(buffer, min_length);
+	if(status){
+		return status;
+	}
+	*dest = buffer->get;
+	*length = buffer->length;
+	return buffer->length == 0 ? YAMBLER_EMPTY : YAMBLER_OK;
+}
+
+yambler_status yambler_input_buffer_peek_n(yambler_input_buffer_p buffer, yambler_char *dest, size_t count, size_t *peek_count){
+	assert(dest != NULL || count == 0);
+	assert(peek_count != NULL);
+	const yambler_char *span;
+	size_t length;
+	yambler_status status = yambler_input_buffer_span(buffer, count, &span, &length);
+	if(status){
+		*peek_count = 0;
+		return status;
+	}
+	if(length > count){
+		length = count;
+	}
+	memcpy(dest, span, sizeof(yambler_char) * length);
+	*peek_count = length;
+	return YAMBLER_OK;
+}
+
+void yambler_input_buffer_consume_n(yambler_input_buffer_p buffer, size_t count){
+	assert(buffer != NULL);
+	assert(count <= buffer->length);
+	buffer->get += count;
+	buffer->length -= count;
+}
+
+void yambler_input_buffer_hold(yambler_input_buffer_p buffer){
+	assert(buffer != NULL);
+	buffer->held = 1;
+}
+
+void yambler_input_buffer_release(yambler_input_buffer_p buffer){
+	assert(buffer != NULL);
+	buffer->held = 0;
+	buffer->spare_count += buffer->retired_count;
+	buffer->retired_count = 0;
 }
 
 yambler_status yambler_input_buffer_peek(yambler_input_buffer_p buffer, yambler_char *dest){
@@ -190,9 +450,17 @@ yambler_status yambler_input_buffer_get(yambler_input_buffer_p buffer, yambler_c
 	return YAMBLER_OK;
 }
 
+void yambler_input_buffer_get_stats(yambler_input_buffer_p buffer, struct yambler_input_buffer_stats *dest){
+	assert(buffer != NULL);
+	assert(dest != NULL);
+	*dest = buffer->stats;
+}
+
 void yambler_input_buffer_close(yambler_input_buffer_p buffer){
 	if(buffer->opened){
-		if(buffer->close){
+		if(buffer->decoder){
+			yambler_decoder_close(buffer->decoder);
+		}else if(buffer->close){
 			(*buffer->close)(&buffer->read_state);
 		}
 		buffer->opened = 0;
@@ -208,9 +476,18 @@ void yambler_input_buffer_destroy(yambler_input_buffer_p *src){
   assert(buffer != NULL);
 
   yambler_input_buffer_close(buffer);
+
+  if(buffer->owns_decoder){
+    yambler_decoder_destroy(&buffer->decoder);
+  }
   
-  free(buffer->data);
-  free(buffer);
+  yambler_input_buffer_release(buffer);
+  for(size_t i = 0; i < buffer->spare_count; ++i){
+    yambler_release(buffer->allocator, buffer->blocks[i].data);
+  }
+  yambler_release(buffer->allocator, buffer->blocks);
+  yambler_release(buffer->allocator, buffer->data);
+  yambler_release(buffer->allocator, buffer);
 
   *src = NULL;
 }
@@ -2,6 +2,7 @@
 #define YAMBLER_INPUT_BUFFER_H
 
 #include "yambler_type.h"
+#include "yambler_allocator.h"
 #include "yambler_decoder.h"
 
 #include <stddef.h>
@@ -14,13 +15,46 @@ typedef yambler_status (*yambler_input_buffer_read_callback)(yambler_input_buffe
 
 typedef void (*yambler_input_buffer_close_callback)(yambler_input_buffer_state *);
 
+/*
+ * Sizes are expressed in characters. When the buffer needs to hold more characters than fit, it grows to growth_factor
+ * times its size, but at least by min_growth characters, and never beyond max_size. A growth factor of 1 grows linearly
+ * by min_growth. Zero fields take the defaults, a max_size of zero does not limit the size.
+ * Requests for more than max_size characters fail with YAMBLER_BOUNDS_ERROR.
+ */
+struct yambler_input_buffer_policy{
+	size_t initial_size;
+	size_t max_size;
+	size_t growth_factor;
+	size_t min_growth;
+};
+
+/*
+ * Statistics collected since the buffer was created. Compaction moves the unread characters to the front of the
+ * buffer once more than half of it has been consumed, compacted_length counts the characters moved.
+ * A buffer that is read while the parser holds values pointing into it moves the unread characters into another
+ * block instead, retire_count counts these moves.
+ */
+struct yambler_input_buffer_stats{
+	size_t size;
+	size_t high_water_size;
+	size_t high_water_length;
+	size_t grow_count;
+	size_t compact_count;
+	size_t compacted_length;
+	size_t retire_count;
+};
+
 struct yambler_input_buffer;
 
 typedef struct yambler_input_buffer * yambler_input_buffer_p;
 
-yambler_status yambler_input_buffer_create(yambler_input_buffer_p *dest, size_t initial_size, yambler_input_buffer_state state, yambler_input_buffer_read_callback read, yambler_input_buffer_open_callback open, yambler_input_buffer_close_callback close);
+yambler_status yambler_input_buffer_create(yambler_input_buffer_p *dest, const struct yambler_allocator *allocator, const struct yambler_input_buffer_policy *policy, yambler_input_buffer_state state, yambler_input_buffer_read_callback read, yambler_input_buffer_open_callback open, yambler_input_buffer_close_callback close);
+
+yambler_status yambler_input_buffer_create_with_decoder(yambler_input_buffer_p *dest, const struct yambler_allocator *allocator, const struct yambler_input_buffer_policy *policy, yambler_decoder_p decoder);
+
+yambler_status yambler_input_buffer_create_from_memory(yambler_input_buffer_p *dest, const struct yambler_allocator *allocator, const struct yambler_input_buffer_policy *policy, const yambler_byte *data, size_t length, enum yambler_encoding encoding);
 
-yambler_status yambler_input_buffer_create_with_decoder(yambler_input_buffer_p *dest, size_t initial_size, yambler_decoder_p decoder);
+void yambler_input_buffer_get_stats(yambler_input_buffer_p buffer, struct yambler_input_buffer_stats *dest);
 
 void yambler_input_buffer_destroy(yambler_input_buffer_p *src);
 
@@ -11,6 +11,31 @@ void yambler_input_buffer_pop(yambler_input_buffer_p buffer);
 
 yambler_status yambler_input_buffer_get(yambler_input_buffer_p buffer, yambler_char *dest);
 
+/*
+ * Returns the buffered characters as one contiguous span of at least min_length characters, reading as needed.
+ * The span is shorter only when the input ends first, it stays valid until the next call that reads from the buffer.
+ */
+yambler_status yambler_input_buffer_span(yambler_input_buffer_p buffer, size_t min_length, const yambler_char **dest, size_t *length);
+
+/*
+ * Copies up to count characters into dest without consuming them, peek_count holds the number copied.
+ */
+yambler_status yambler_input_buffer_peek_n(yambler_input_buffer_p buffer, yambler_char *dest, size_t count, size_t *peek_count);
+
+/*
+ * Consumes count characters, which must have been made available by span, peek or peek_n.
+ */
+void yambler_input_buffer_consume_n(yambler_input_buffer_p buffer, size_t count);
+
+/*
+ * While the buffer is held the consumed characters are neither moved nor overwritten, so pointers into a span
+ * stay valid after the characters have been consumed. A held buffer that runs out of space moves the unread
+ * characters into another block and keeps the old one until it is released.
+ */
+void yambler_input_buffer_hold(yambler_input_buffer_p buffer);
+
+void yambler_input_buffer_release(yambler_input_buffer_p buffer);
+
 void yambler_input_buffer_close(yambler_input_buffer_p buffer);
 
 #endif
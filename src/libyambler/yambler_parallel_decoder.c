@@ -0,0 +1,272 @@
+#include "yambler_parallel_decoder.h"
+
+#include "yambler_codec.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define MIN_CHUNK_SIZE 65536
+#define MAX_CHUNK_SIZE (1024 * 1024)
+#define CHUNKS_PER_THREAD 4
+#define SLOTS_PER_THREAD 2
+
+/*
+ * Chunks are claimed by the workers in document order and decoded into a window of output slots,
+ * chunk i going to slot i modulo the slot count. A worker only claims a chunk once the calling thread
+ * has written the chunk that previously occupied its slot, which bounds the memory in use regardless
+ * of the size of the input.
+ */
+
+struct yambler_parallel_slot{
+	yambler_char *data;
+	size_t length;
+	yambler_status status;
+	size_t ready;
+};
+
+struct yambler_parallel_decoder{
+	const yambler_byte *data;
+	size_t *bounds;
+	size_t chunk_count;
+	yambler_codec_decode_function decode;
+
+	struct yambler_parallel_slot *slots;
+	size_t slot_count;
+	size_t slot_size;
+
+	size_t next;
+	size_t written;
+	int stop;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+};
+
+static size_t max_chars(enum yambler_encoding encoding, size_t length){
+#ifdef YAMBLER_UTF8_CHARS
+	switch(encoding){
+	case YAMBLER_ENCODING_UTF_16LE:
+	case YAMBLER_ENCODING_UTF_16BE:
+		return length / 2 * 3 + 3;
+	default:
+		return length;
+	}
+#else
+	switch(encoding){
+	case YAMBLER_ENCODING_UTF_16LE:
+	case YAMBLER_ENCODING_UTF_16BE:
+		return length / 2 + 1;
+	case YAMBLER_ENCODING_UTF_32LE:
+	case YAMBLER_ENCODING_UTF_32BE:
+		return length / 4 + 1;
+	default:
+		return length;
+	}
+#endif
+}
+
+/*
+ * Moves a split point forward to the start of the next character.
+ * Malformed input may leave the split inside a sequence; the chunk on either side then reports it.
+ */
+static size_t align_bound(const unsigned char *data, size_t length, size_t bound, enum yambler_encoding encoding){
+	switch(encoding){
+	case YAMBLER_ENCODING_UTF_8:
+		for(int i = 0; i < 3 && bound < length && (data[bound] & 0xC0) == 0x80; ++i){
+			++bound;
+		}
+		break;
+	case YAMBLER_ENCODING_UTF_16LE:
+	case YAMBLER_ENCODING_UTF_16BE:{
+		bound -= bound % 2;
+		if(bound + 1 < length){
+			unsigned char high = encoding == YAMBLER_ENCODING_UTF_16LE ? data[bound + 1] : data[bound];
+			if((high & 0xFC) == 0xDC){
+				bound += 2;
+			}
+		}
+		break;
+	}
+	default:
+		bound -= bound % 4;
+		break;
+	}
+	return bound < length ? bound : length;
+}
+
+static void *work(void *argument){
+	struct yambler_parallel_decoder *decoder = (struct yambler_parallel_decoder *)argument;
+	while(1){
+		pthread_mutex_lock(&decoder->lock);
+		while(!decoder->stop && decoder->next < decoder->chunk_count && decoder->next >= decoder->written + decoder->slot_count){
+			pthread_cond_wait(&decoder->changed, &decoder->lock);
+		}
+		if(decoder->stop || decoder->next == decoder->chunk_count){
+			pthread_mutex_unlock(&decoder->lock);
+			break;
+		}
+		size_t chunk = decoder->next++;
+		pthread_mutex_unlock(&decoder->lock);
+
+		struct yambler_parallel_slot *slot = decoder->slots + (chunk % decoder->slot_count);
+		const yambler_byte *in = decoder->data + decoder->bounds[chunk];
+		size_t in_remainder = decoder->bounds[chunk + 1] - decoder->bounds[chunk];
+		yambler_char *out = slot->data;
+		size_t out_remainder = decoder->slot_size;
+		enum yambler_codec_result result = (*decoder->decode)(&in, &in_remainder, &out, &out_remainder);
+		assert(result != YAMBLER_CODEC_FULL);
+
+		pthread_mutex_lock(&decoder->lock);
+		slot->length = decoder->slot_size - out_remainder;
+		slot->status = result == YAMBLER_CODEC_OK ? YAMBLER_OK : YAMBLER_ENCODING_ERROR;
+		slot->ready = chunk + 1;
+		pthread_cond_broadcast(&decoder->changed);
+		pthread_mutex_unlock(&decoder->lock);
+	}
+	return NULL;
+}
+
+static yambler_status collect(struct yambler_parallel_decoder *decoder, yambler_parallel_decoder_write_callback write, yambler_decoder_state state){
+	yambler_status status = YAMBLER_OK;
+	for(size_t chunk = 0; chunk < decoder->chunk_count; ++chunk){
+		struct yambler_parallel_slot *slot = decoder->slots + (chunk % decoder->slot_count);
+		pthread_mutex_lock(&decoder->lock);
+		while(slot->ready != chunk + 1){
+			pthread_cond_wait(&decoder->changed, &decoder->lock);
+		}
+		pthread_mutex_unlock(&decoder->lock);
+
+		if(slot->length != 0){
+			status = (*write)(state, slot->data, slot->length);
+		}
+		if(status == YAMBLER_OK){
+			status = slot->status;
+		}
+		pthread_mutex_lock(&decoder->lock);
+		if(status){
+			decoder->stop = 1;
+		}else{
+			decoder->written = chunk + 1;
+		}
+		pthread_cond_broadcast(&decoder->changed);
+		pthread_mutex_unlock(&decoder->lock);
+		if(status){
+			break;
+		}
+	}
+	return status;
+}
+
+yambler_status yambler_decode_parallel(const struct yambler_allocator *allocator, const yambler_byte *data, size_t length, enum yambler_encoding encoding, size_t thread_count, yambler_parallel_decoder_write_callback write, yambler_decoder_state state){
+	assert(data != NULL || length == 0);
+	assert(write != NULL);
+
+	allocator = yambler_allocator_or_default(allocator);
+	if(encoding == YAMBLER_ENCODING_DETECT){
+		size_t bom_size;
+		encoding = yambler_codec_detect_encoding(data, length, &bom_size);
+		data += bom_size;
+		length -= bom_size;
+	}
+	if(length == 0){
+		return YAMBLER_OK;
+	}
+	if(thread_count == 0){
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		thread_count = online > 0 ? (size_t)online : 1;
+	}
+
+	struct yambler_parallel_decoder decoder;
+	decoder.decode = yambler_codec_decoder(encoding);
+	if(decoder.decode == NULL){
+		return YAMBLER_ENCODING_ERROR;
+	}
+
+	size_t chunk_size = length / (thread_count * CHUNKS_PER_THREAD);
+	if(chunk_size < MIN_CHUNK_SIZE){
+		chunk_size = MIN_CHUNK_SIZE;
+	}else if(chunk_size > MAX_CHUNK_SIZE){
+		chunk_size = MAX_CHUNK_SIZE;
+	}
+	size_t chunk_count = (length + chunk_size - 1) / chunk_size;
+	decoder.bounds = yambler_allocate(allocator, sizeof(size_t) * (chunk_count + 1));
+	if(decoder.bounds == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	decoder.bounds[0] = 0;
+	size_t count = 1;
+	for(size_t i = 1; i < chunk_count; ++i){
+		size_t bound = align_bound((const unsigned char *)data, length, i * chunk_size, encoding);
+		if(bound > decoder.bounds[count - 1] && bound < length){
+			decoder.bounds[count++] = bound;
+		}
+	}
+	decoder.bounds[count] = length;
+	decoder.chunk_count = count;
+	decoder.data = data;
+
+	if(thread_count > decoder.chunk_count){
+		thread_count = decoder.chunk_count;
+	}
+	/* alignment moves a split forward by at most one character */
+	decoder.slot_size = max_chars(encoding, chunk_size + 4);
+	decoder.slot_count = thread_count * SLOTS_PER_THREAD;
+	if(decoder.slot_count > decoder.chunk_count){
+		decoder.slot_count = decoder.chunk_count;
+	}
+	decoder.slots = yambler_allocate(allocator, sizeof(struct yambler_parallel_slot) * decoder.slot_count);
+	pthread_t *threads = yambler_allocate(allocator, sizeof(pthread_t) * thread_count);
+	if(decoder.slots == NULL || threads == NULL){
+		yambler_release(allocator, threads);
+		yambler_release(allocator, decoder.slots);
+		yambler_release(allocator, decoder.bounds);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	for(size_t i = 0; i < decoder.slot_count; ++i){
+		decoder.slots[i].ready = 0;
+		decoder.slots[i].data = yambler_allocate(allocator, sizeof(yambler_char) * decoder.slot_size);
+		if(decoder.slots[i].data == NULL){
+			while(i != 0){
+				yambler_release(allocator, decoder.slots[--i].data);
+			}
+			yambler_release(allocator, threads);
+			yambler_release(allocator, decoder.slots);
+			yambler_release(allocator, decoder.bounds);
+			return YAMBLER_ALLOC_ERROR;
+		}
+	}
+	decoder.next = 0;
+	decoder.written = 0;
+	decoder.stop = 0;
+	pthread_mutex_init(&decoder.lock, NULL);
+	pthread_cond_init(&decoder.changed, NULL);
+
+	yambler_status status = YAMBLER_OK;
+	size_t started = 0;
+	while(started < thread_count){
+		if(pthread_create(threads + started, NULL, &work, &decoder)){
+			break;
+		}
+		++started;
+	}
+	if(started == 0){
+		status = YAMBLER_ERROR;
+	}else{
+		status = collect(&decoder, write, state);
+	}
+	for(size_t i = 0; i < started; ++i){
+		pthread_join(threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&decoder.changed);
+	pthread_mutex_destroy(&decoder.lock);
+	for(size_t i = 0; i < decoder.slot_count; ++i){
+		yambler_release(allocator, decoder.slots[i].data);
+	}
+	yambler_release(allocator, threads);
+	yambler_release(allocator, decoder.slots);
+	yambler_release(allocator, decoder.bounds);
+	return status;
+}
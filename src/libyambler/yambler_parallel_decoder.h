@@ -0,0 +1,21 @@
+#ifndef YAMBLER_PARALLEL_DECODER_H
+#define YAMBLER_PARALLEL_DECODER_H
+
+#include "yambler_type.h"
+#include "yambler_allocator.h"
+#include "yambler_decoder.h"
+
+#include <stddef.h>
+
+/*
+ * Decodes a document held in memory on several threads.
+ * The input is split into chunks that start on a character boundary, the chunks are decoded concurrently
+ * and the decoded characters are handed to the write callback in document order, on the calling thread.
+ * A thread count of zero uses one thread per online processor. All memory is taken from the allocator on the calling thread.
+ */
+
+typedef yambler_status (*yambler_parallel_decoder_write_callback)(yambler_decoder_state, const yambler_char *, size_t);
+
+yambler_status yambler_decode_parallel(const struct yambler_allocator *allocator, const yambler_byte *data, size_t length, enum yambler_encoding encoding, size_t thread_count, yambler_parallel_decoder_write_callback write, yambler_decoder_state state);
+
+#endif
@@ -1,33 +1,132 @@
 #include "yambler_input_buffer.h"
 #include "yambler_input_buffer_impl.h"
 #include "yambler_parser.h"
+#include "yambler_arena.h"
+#include "yambler_char_class.h"
+#include "yambler_scan.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#define DOUBLE_QUOTE_CHAR 0x22
 #define COMMENT_CHAR 0x23
+#define SINGLE_QUOTE_CHAR 0x27
+#define ENTRY_SEPARATOR_CHAR 0x2C
+#define SEQUENCE_ENTRY_CHAR 0x2D
+#define DOCUMENT_END_CHAR 0x2E
+#define MAPPING_VALUE_CHAR 0x3A
+#define MAPPING_KEY_CHAR 0x3F
+#define SEQUENCE_START_CHAR 0x5B
+#define ESCAPE_CHAR 0x5C
+#define SEQUENCE_END_CHAR 0x5D
+#define MAPPING_START_CHAR 0x7B
+#define MAPPING_END_CHAR 0x7D
 #define SPACE_CHAR 0x20
 #define TAB_CHAR 0x09
 #define LINE_FEED_CHAR 0x0A
 #define CARRIAGE_RETURN_CHAR 0x0D
 
+#ifdef YAMBLER_UTF8_CHARS
+#define STARTS_COLUMN(c) (((c) & 0xC0) != 0x80)
+#else
+#define STARTS_COLUMN(c) 1
+#endif
+
 #define CAPTURE_INITIAL_SIZE 128
-#define CAPTURE_SIZE_INCREMENT 1024
+#define ARENA_BLOCK_SIZE 65536
+#define CAPTURE_GROWTH_FACTOR 2
+
+#define STACK_INITIAL_SIZE 16
+
+/* a window of the index, in characters */
+#define INDEX_SIZE 4096
+
+/* the longest escape sequence, a surrogate pair of two \u escapes */
+#define ESCAPE_MAX_LENGTH 12
+
+/*
+ * definition of the parser struct and states
+ */
 
 /*
- * definition of the parser struct and function types
+ * Every parser function has a state, yambler_parser_parse pops the states from the stack and dispatches them
+ * in a switch, so that the parser functions can be inlined into the dispatch loop
  */
+enum yambler_parser_state{
+	YAMBLER_PS_BEGIN,
+	YAMBLER_PS_STREAM,
+	YAMBLER_PS_COMMENT,
+	YAMBLER_PS_KEY,
+	YAMBLER_PS_END
+};
+
+/*
+ * Every open block collection is a level, holding the indentation of its entries and what it expects next.
+ * A mapping expects a key or the value of the key just read, a sequence an entry or the node of the entry just begun.
+ * Flow collections are levels too, they wait for their indicators instead of indentation.
+ */
+enum yambler_parser_expect{
+	YAMBLER_PX_KEY,
+	YAMBLER_PX_VALUE,
+	YAMBLER_PX_ENTRY,
+	YAMBLER_PX_NODE,
+	YAMBLER_PX_FLOW_ENTRY,
+	YAMBLER_PX_FLOW_ENTRY_END,
+	YAMBLER_PX_FLOW_KEY,
+	YAMBLER_PX_FLOW_VALUE_INDICATOR,
+	YAMBLER_PX_FLOW_VALUE,
+	YAMBLER_PX_FLOW_PAIR_END
+};
+
+#define IS_FLOW(level) ((level)->expect >= YAMBLER_PX_FLOW_ENTRY)
 
-typedef yambler_status (*yambler_parser_handle)(yambler_parser_p);
+struct yambler_parser_level{
+	int indent;
+	enum yambler_parser_expect expect;
+};
 
-typedef int (*yambler_predicate)(yambler_char);
+/*
+ * What precedes the current position on its line, a node following an entry or a key is not indented
+ */
+enum yambler_parser_inline{
+	YAMBLER_PI_NONE,
+	YAMBLER_PI_ENTRY,
+	YAMBLER_PI_VALUE
+};
 
+/*
+ * The state stack is kept across documents, so once it has grown to the deepest nesting seen
+ * pushing and popping states no longer allocates
+ */
 struct yambler_parser_stack{
-  yambler_parser_handle handle;
-  struct yambler_parser_stack *next;
+	unsigned char *states;
+	size_t size;
+	size_t length;
+};
+
+/*
+ * The levels are all the parser keeps of a document's structure, so its memory grows with the nesting depth only
+ */
+struct yambler_parser_levels{
+	struct yambler_parser_level *levels;
+	size_t size;
+	size_t length;
+};
+
+/*
+ * The index marks the structural characters of a window of the stream, found by yambler_scan_index a block at a time.
+ * It is kept by stream offset rather than by pointer, as the input buffer may move the characters it has indexed.
+ */
+struct yambler_parser_index{
+	uint64_t bits[YAMBLER_SCAN_INDEX_WORDS(INDEX_SIZE)];
+	size_t offset;
+	size_t length;
 };
 
 struct yambler_parser{
+	const struct yambler_allocator *allocator;
 	yambler_input_buffer_p input;
 	int opened;
 	
@@ -35,16 +134,40 @@ struct yambler_parser{
 	int event_ready;
 
 	struct yambler_parser_error error;
+	size_t offset;
 
 	int match;
 
+	yambler_arena_p arena;
+
 	struct{
 		yambler_char *begin;
 		yambler_char *end;
 		yambler_char *current;
 	} capture;
+
+	struct yambler_string token;
+	int token_continued;
+	int token_pending;
+
+	int document_open;
+	int document_explicit;
+	int document_ended;
+	int root_done;
+	enum yambler_parser_inline inline_node;
+
+	int fragments;
 	
-	struct yambler_parser_stack *stack;
+	struct yambler_parser_stack stack;
+	struct yambler_parser_levels levels;
+
+	struct yambler_scan_set blanks;
+	struct yambler_scan_set line_breaks;
+	struct yambler_scan_set plain_stops;
+	struct yambler_scan_set flow_spaces;
+	struct yambler_scan_set structurals;
+
+	struct yambler_parser_index index;
 };
 
 /*
@@ -53,35 +176,75 @@ struct yambler_parser{
 
 static yambler_status get_char(yambler_parser_p parser, yambler_char *dest);
 
-static yambler_status peek_char(yambler_parser_p parser, yambler_char *dest);
-
 static void pop_char(yambler_parser_p parser, yambler_char peeked);
 
+static void pop_run(yambler_parser_p parser, const yambler_char *begin, size_t length);
+
+static void pop_span(yambler_parser_p parser, const yambler_char *begin, size_t length);
+
+static void reset_document(yambler_parser_p parser);
+
 static void reset_capture(yambler_parser_p parser);
 
-static yambler_status capture(yambler_parser_p parser, yambler_char c);
+static void release_values(yambler_parser_p parser);
 
-static void deliver_capture(yambler_parser_p parser);
+static yambler_status next_event(yambler_parser_p parser, struct yambler_parser_event *event);
 
-static yambler_status skip_none_or_more_pred(yambler_parser_p parser, yambler_predicate pred);
+static yambler_status capture_span(yambler_parser_p parser, const yambler_char *begin, size_t length);
 
-static yambler_status capture_until_pred(yambler_parser_p parser, yambler_predicate pred);
+static void deliver_token(yambler_parser_p parser);
 
-static yambler_status push_handle(yambler_parser_p parser, yambler_parser_handle handle);
+static yambler_status skip_none_or_more(yambler_parser_p parser, const struct yambler_scan_set *set);
 
-static yambler_status push_handle_pair(yambler_parser_p parser, yambler_parser_handle head, yambler_parser_handle tail);
+static yambler_status capture_until(yambler_parser_p parser, const struct yambler_scan_set *set);
 
-static yambler_parser_handle pop_handle(yambler_parser_p parser);
+static size_t next_structural(yambler_parser_p parser, const yambler_char *span, size_t length, size_t from);
 
-static void clear_handle_stack(yambler_parser_p parser);
+static yambler_status capture_plain(yambler_parser_p parser, int flow, int *key);
 
-/*
- * forward declarations of matchers
- */
+static yambler_status fold_lines(yambler_parser_p parser, int escaped);
+
+static void trim_capture(yambler_parser_p parser, size_t kept);
+
+static yambler_status capture_code_point(yambler_parser_p parser, yambler_code_point c);
+
+static yambler_status capture_escape(yambler_parser_p parser, const yambler_char *span, size_t length, size_t *escape_length);
+
+static yambler_status capture_double_quoted(yambler_parser_p parser);
+
+static yambler_status capture_single_quoted(yambler_parser_p parser);
+
+static yambler_status capture_scalar(yambler_parser_p parser, yambler_char first, int flow, int *key);
+
+static int starts_scalar(const yambler_char *span, size_t length, int flow);
+
+static yambler_status push_state(yambler_parser_p parser, enum yambler_parser_state state);
+
+static yambler_status push_state_pair(yambler_parser_p parser, enum yambler_parser_state head, enum yambler_parser_state tail);
+
+static yambler_status reserve_states(yambler_parser_p parser, size_t count);
+
+static void clear_state_stack(yambler_parser_p parser);
+
+static yambler_status push_level(yambler_parser_p parser, int indent, enum yambler_parser_expect expect);
+
+static struct yambler_parser_level *top_level(yambler_parser_p parser);
 
-static int match_non_breaking_whitespace(yambler_char c);
+static int expects_node(yambler_parser_p parser, int column, int entry);
 
-static int match_newline(yambler_char c);
+static int closes_level(const struct yambler_parser_level *level, int column, int entry);
+
+static void begin_node(yambler_parser_p parser);
+
+static void close_level(yambler_parser_p parser);
+
+static void emit_event(yambler_parser_p parser, enum yambler_parser_event_type type);
+
+static void begin_document(yambler_parser_p parser);
+
+static void end_document(yambler_parser_p parser);
+
+static int complete_root(yambler_parser_p parser);
 
 /*
  * forward declarations of parser functions
@@ -93,6 +256,22 @@ static yambler_status parse_comment(yambler_parser_p parser);
 
 static yambler_status parse(yambler_parser_p parser);
 
+static yambler_status parse_marker(yambler_parser_p parser, yambler_char marker);
+
+static yambler_status parse_entry(yambler_parser_p parser, int column);
+
+static yambler_status parse_scalar(yambler_parser_p parser, int column);
+
+static yambler_status begin_flow(yambler_parser_p parser, yambler_char indicator, int column);
+
+static yambler_status parse_flow(yambler_parser_p parser);
+
+static yambler_status parse_flow_scalar(yambler_parser_p parser, yambler_char first);
+
+static yambler_status parse_stream_end(yambler_parser_p parser);
+
+static yambler_status parse_key(yambler_parser_p parser);
+
 static yambler_status parse_end(yambler_parser_p parser);
 
 
@@ -100,21 +279,49 @@ static yambler_status parse_end(yambler_parser_p parser);
  * implementation of parser lifecycle functions
  */
 
-yambler_status yambler_parser_create(yambler_parser_p *dest){
+yambler_status yambler_parser_create(yambler_parser_p *dest, const struct yambler_allocator *allocator){
 	assert(dest != NULL);
 	
-	yambler_parser_p parser = malloc(sizeof(struct yambler_parser));
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_parser_p parser = yambler_allocate(allocator, sizeof(struct yambler_parser));
 	if(parser == NULL){
 		return YAMBLER_ALLOC_ERROR;
 	}
+	parser->allocator = allocator;
 
-	parser->capture.begin = malloc(sizeof(yambler_char) * CAPTURE_INITIAL_SIZE);
-	if(parser->capture.begin == NULL){
-		free(parser);
+	yambler_status status = yambler_arena_create(&parser->arena, allocator, ARENA_BLOCK_SIZE);
+	if(status){
+		yambler_release(allocator, parser);
+		return status;
+	}
+	reset_document(parser);
+
+	parser->stack.states = yambler_allocate(allocator, sizeof(unsigned char) * STACK_INITIAL_SIZE);
+	if(parser->stack.states == NULL){
+		yambler_arena_destroy(&parser->arena);
+		yambler_release(allocator, parser);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	parser->stack.size = STACK_INITIAL_SIZE;
+	parser->stack.length = 0;
+
+	parser->levels.levels = yambler_allocate(allocator, sizeof(struct yambler_parser_level) * STACK_INITIAL_SIZE);
+	if(parser->levels.levels == NULL){
+		yambler_release(allocator, parser->stack.states);
+		yambler_arena_destroy(&parser->arena);
+		yambler_release(allocator, parser);
 		return YAMBLER_ALLOC_ERROR;
 	}
-	parser->capture.end = parser->capture.begin + CAPTURE_INITIAL_SIZE;
+	parser->levels.size = STACK_INITIAL_SIZE;
+	parser->levels.length = 0;
+
+	yambler_scan_set_init(&parser->blanks, YAMBLER_CLASS_BLANK);
+	yambler_scan_set_init(&parser->line_breaks, YAMBLER_CLASS_BREAK);
+	yambler_scan_set_init(&parser->plain_stops, YAMBLER_CLASS_BREAK | YAMBLER_CLASS_COMMENT | YAMBLER_CLASS_MAPPING_VALUE);
+	yambler_scan_set_init(&parser->flow_spaces, YAMBLER_CLASS_BLANK | YAMBLER_CLASS_BREAK);
+	yambler_scan_set_init(&parser->structurals, YAMBLER_CLASS_FLOW_INDICATOR | YAMBLER_CLASS_MAPPING_VALUE | YAMBLER_CLASS_COMMENT | YAMBLER_CLASS_QUOTE | YAMBLER_CLASS_BREAK);
 	
+	parser->fragments = 0;
 	parser->opened = 0;
     
 	*dest = parser;
@@ -131,20 +338,30 @@ yambler_status yambler_parser_open(yambler_parser_p parser, yambler_input_buffer
 	
 	parser->input = input;
 
-	parser->stack = NULL;
-	yambler_status status = push_handle_pair(parser, &parse_begin, &parse_end);
+	clear_state_stack(parser);
+	yambler_status status = push_state_pair(parser, YAMBLER_PS_BEGIN, YAMBLER_PS_END);
 	if(status){
 	  return status;
 	}
 	
+	parser->levels.length = 0;
 	parser->event_ready = 0;
+	parser->token_pending = 0;
+	parser->document_open = 0;
+	parser->document_explicit = 0;
+	parser->document_ended = 0;
+	parser->root_done = 0;
+	parser->inline_node = YAMBLER_PI_NONE;
 	parser->opened = 1;
 	
 	parser->error.line = 0;
 	parser->error.column = 0;
 	parser->error.message = "";
+	parser->offset = 0;
+	parser->index.offset = 0;
+	parser->index.length = 0;
 
-	parser->capture.current = parser->capture.begin;
+	reset_document(parser);
 	
 	return yambler_input_buffer_open(input);
 }
@@ -153,26 +370,41 @@ yambler_status yambler_parser_open(yambler_parser_p parser, yambler_input_buffer
 yambler_status yambler_parser_parse(yambler_parser_p parser, struct yambler_parser_event *event){
   assert(parser != NULL);
   assert(event != NULL);
-  if(parser->stack){
-    parser->event_ready = 0;
-    parser->event = event;
-    while(!parser->event_ready){
-      yambler_parser_handle handle = pop_handle(parser);
-      if(handle){
-	yambler_status status = (*handle)(parser);
-	if(status){
-	  return status;
-	}
-      }else{
+  if(parser->stack.length){
+    release_values(parser);
+    return next_event(parser, event);
+  }
+  return YAMBLER_EMPTY;
+}
+
+yambler_status yambler_parser_parse_batch(yambler_parser_p parser, struct yambler_parser_event *events, size_t capacity, size_t *count){
+  assert(parser != NULL);
+  assert(events != NULL || capacity == 0);
+  assert(count != NULL);
+  *count = 0;
+  if(parser->stack.length){
+    release_values(parser);
+    while(*count < capacity && parser->stack.length){
+      yambler_status status = next_event(parser, &events[*count]);
+      if(status){
+	return status;
+      }
+      if(!parser->event_ready){
 	break;
       }
+      ++*count;
     }
-    event = parser->event;
     return YAMBLER_OK;
   }
   return YAMBLER_EMPTY;
 }
 
+void yambler_parser_set_fragments(yambler_parser_p parser, int fragments){
+	assert(parser != NULL);
+
+	parser->fragments = fragments;
+}
+
 int yambler_parser_get_error(yambler_parser_p parser, struct yambler_parser_error *error){
 	if(parser->error.message != '\0'){
 		*error = parser->error;
@@ -186,7 +418,7 @@ void yambler_parser_close(yambler_parser_p parser){
 	assert(parser != NULL);
 
 	if(parser->opened){
-	  clear_handle_stack(parser);
+	  clear_state_stack(parser);
 	  yambler_input_buffer_close(parser->input);
 	  parser->opened = 0;
 	}
@@ -203,9 +435,11 @@ void yambler_parser_destroy(yambler_parser_p *src){
 		yambler_parser_close(*src);
 	}
 
-	free(parser->capture.begin);
+	yambler_arena_destroy(&parser->arena);
+	yambler_release(parser->allocator, parser->stack.states);
+	yambler_release(parser->allocator, parser->levels.levels);
   
-	free(parser);
+	yambler_release(parser->allocator, parser);
 }
 
 void yambler_parser_destroy_all(yambler_parser_p *parser_src, yambler_input_buffer_p *buffer_src, yambler_decoder_p *decoder_src){
@@ -224,56 +458,193 @@ void yambler_parser_destroy_all(yambler_parser_p *parser_src, yambler_input_buff
  * implementations of utility functions
  */
 
-static yambler_status push_handle(yambler_parser_p parser, yambler_parser_handle handle){
+static yambler_status reserve_states(yambler_parser_p parser, size_t count){
+  struct yambler_parser_stack *stack = &parser->stack;
+  if(stack->size - stack->length < count){
+    size_t new_size = stack->size * 2;
+    if(new_size < stack->length + count){
+      new_size = stack->length + count;
+    }
+    unsigned char *new_states = yambler_reallocate(parser->allocator, stack->states, sizeof(unsigned char) * new_size);
+    if(new_states == NULL){
+      return YAMBLER_ALLOC_ERROR;
+    }
+    stack->states = new_states;
+    stack->size = new_size;
+  }
+  return YAMBLER_OK;
+}
+
+static yambler_status push_state(yambler_parser_p parser, enum yambler_parser_state state){
   assert(parser != NULL);
-  assert(handle != NULL);
 
-  struct yambler_parser_stack *new_head = malloc(sizeof(struct yambler_parser_stack));
-  if(new_head == NULL){
-    return YAMBLER_ALLOC_ERROR;
+  yambler_status status = reserve_states(parser, 1);
+  if(status){
+    return status;
   }
-  new_head->next = parser->stack;
-  new_head->handle = handle;
-  parser->stack = new_head;
+  parser->stack.states[parser->stack.length++] = state;
   return YAMBLER_OK;
 }
 
-static yambler_status push_handle_pair(yambler_parser_p parser, yambler_parser_handle head, yambler_parser_handle tail){
+static yambler_status push_state_pair(yambler_parser_p parser, enum yambler_parser_state head, enum yambler_parser_state tail){
   assert(parser != NULL);
-  assert(head != NULL);
-  assert(tail != NULL);
-  struct yambler_parser_stack *new_tail = malloc(sizeof(struct yambler_parser_stack));
-  if(new_tail == NULL){
-    return YAMBLER_ALLOC_ERROR;
-  }
-  new_tail->next = parser->stack;
-  new_tail->handle = tail;
-  struct yambler_parser_stack *new_head = malloc(sizeof(struct yambler_parser_stack));
-  if(new_head == NULL){
-    free(new_tail);
-    return YAMBLER_ALLOC_ERROR;
-  }
-  new_head->next = new_tail;
-  new_head->handle = head;
-  parser->stack = new_head;
+
+  yambler_status status = reserve_states(parser, 2);
+  if(status){
+    return status;
+  }
+  parser->stack.states[parser->stack.length++] = tail;
+  parser->stack.states[parser->stack.length++] = head;
+  return YAMBLER_OK;
+}
+
+static void clear_state_stack(yambler_parser_p parser){
+  parser->stack.length = 0;
+}
+
+static yambler_status push_level(yambler_parser_p parser, int indent, enum yambler_parser_expect expect){
+  struct yambler_parser_levels *levels = &parser->levels;
+  if(levels->length == levels->size){
+    size_t new_size = levels->size * 2;
+    struct yambler_parser_level *new_levels = yambler_reallocate(parser->allocator, levels->levels, sizeof(struct yambler_parser_level) * new_size);
+    if(new_levels == NULL){
+      return YAMBLER_ALLOC_ERROR;
+    }
+    levels->levels = new_levels;
+    levels->size = new_size;
+  }
+  levels->levels[levels->length].indent = indent;
+  levels->levels[levels->length].expect = expect;
+  ++levels->length;
   return YAMBLER_OK;
 }
 
-static yambler_parser_handle pop_handle(yambler_parser_p parser){
-  struct yambler_parser_stack *old_head = parser->stack;
-  yambler_parser_handle handle = old_head->handle;
-  parser->stack = old_head->next;
-  free(old_head);
-  return handle;
-}			    
+static struct yambler_parser_level *top_level(yambler_parser_p parser){
+  return parser->levels.length ? &parser->levels.levels[parser->levels.length - 1] : NULL;
+}
+
+/*
+ * Whether a node beginning at column is the node the innermost level waits for, a sequence
+ * being the value of a key may be indented as much as the key
+ */
+static int expects_node(yambler_parser_p parser, int column, int entry){
+  struct yambler_parser_level *top = top_level(parser);
+  if(top == NULL){
+    return !parser->root_done;
+  }
+  switch(top->expect){
+  case YAMBLER_PX_VALUE:
+    return column > top->indent || (entry && column == top->indent);
+  case YAMBLER_PX_NODE:
+    return column > top->indent;
+  default:
+    return 0;
+  }
+}
+
+/*
+ * Whether the first node of a line beginning at column ends the level, either its pending node or the collection
+ */
+static int closes_level(const struct yambler_parser_level *level, int column, int entry){
+  if(column != level->indent){
+    return column < level->indent;
+  }
+  switch(level->expect){
+  case YAMBLER_PX_KEY:
+    return 0;
+  case YAMBLER_PX_NODE:
+    return 1;
+  default:
+    return !entry;
+  }
+}
+
+static void begin_node(yambler_parser_p parser){
+  struct yambler_parser_level *top = top_level(parser);
+  if(top == NULL){
+    parser->root_done = 1;
+    return;
+  }
+  switch(top->expect){
+  case YAMBLER_PX_VALUE:
+    top->expect = YAMBLER_PX_KEY;
+    break;
+  case YAMBLER_PX_NODE:
+    top->expect = YAMBLER_PX_ENTRY;
+    break;
+  case YAMBLER_PX_FLOW_ENTRY:
+    top->expect = YAMBLER_PX_FLOW_ENTRY_END;
+    break;
+  case YAMBLER_PX_FLOW_KEY:
+    top->expect = YAMBLER_PX_FLOW_VALUE_INDICATOR;
+    break;
+  case YAMBLER_PX_FLOW_VALUE_INDICATOR:
+  case YAMBLER_PX_FLOW_VALUE:
+    top->expect = YAMBLER_PX_FLOW_PAIR_END;
+    break;
+  default:
+    break;
+  }
+}
+
+static void close_level(yambler_parser_p parser){
+  struct yambler_parser_level *top = top_level(parser);
+  switch(top->expect){
+  case YAMBLER_PX_VALUE:
+  case YAMBLER_PX_NODE:
+    /* a key or an entry without a node has an empty one */
+    emit_event(parser, YAMBLER_PE_SCALAR);
+    begin_node(parser);
+    break;
+  case YAMBLER_PX_KEY:
+    emit_event(parser, YAMBLER_PE_MAP_END);
+    --parser->levels.length;
+    break;
+  case YAMBLER_PX_ENTRY:
+    emit_event(parser, YAMBLER_PE_SEQUENCE_END);
+    --parser->levels.length;
+    break;
+  case YAMBLER_PX_FLOW_ENTRY:
+  case YAMBLER_PX_FLOW_ENTRY_END:
+  case YAMBLER_PX_FLOW_KEY:
+  case YAMBLER_PX_FLOW_VALUE_INDICATOR:
+  case YAMBLER_PX_FLOW_VALUE:
+  case YAMBLER_PX_FLOW_PAIR_END:
+    /* flow levels are only closed by their end indicators, in parse_flow */
+    assert(0);
+    break;
+  }
+}
+
+static void emit_event(yambler_parser_p parser, enum yambler_parser_event_type type){
+  parser->event->type = type;
+  parser->event_ready = 1;
+}
+
+static void begin_document(yambler_parser_p parser){
+  emit_event(parser, YAMBLER_PE_DOCUMENT_BEGIN);
+  parser->document_open = 1;
+  parser->document_explicit = 0;
+  parser->root_done = 0;
+}
 
-static void clear_handle_stack(yambler_parser_p parser){
-  struct yambler_parser_stack *head = parser->stack;
-  while(head){
-    struct yambler_parser_stack *old_head = head;
-    head = head->next;
-    free(old_head);
+static void end_document(yambler_parser_p parser){
+  emit_event(parser, YAMBLER_PE_DOCUMENT_END);
+  parser->document_open = 0;
+  parser->document_ended = 1;
+}
+
+/*
+ * An explicit document without a node holds an empty scalar, which has to be emitted before the document ends.
+ * Returns whether it was.
+ */
+static int complete_root(yambler_parser_p parser){
+  if(parser->root_done){
+    return 0;
   }
+  emit_event(parser, YAMBLER_PE_SCALAR);
+  begin_node(parser);
+  return 1;
 }
 
 static yambler_status get_char(yambler_parser_p parser, yambler_char *dest){
@@ -282,150 +653,1034 @@ static yambler_status get_char(yambler_parser_p parser, yambler_char *dest){
 	if(status){
 		return status;
 	}
-	if(match_newline(c)){
+	if(YAMBLER_CHAR_IS(c, YAMBLER_CLASS_BREAK)){
 		parser->error.column = 0;
 		++parser->error.line;
-	}else{
+	}else if(STARTS_COLUMN(c)){
 		++parser->error.column;
 	}
 }
 
-static yambler_status peek_char(yambler_parser_p parser, yambler_char *dest){
-	return yambler_input_buffer_peek(parser->input, dest);
-}
-
 static void pop_char(yambler_parser_p parser, yambler_char peeked){
 	yambler_input_buffer_pop(parser->input);
-	if(match_newline(peeked)){
+	++parser->offset;
+	if(YAMBLER_CHAR_IS(peeked, YAMBLER_CLASS_BREAK)){
 		parser->error.column = 0;
 		++parser->error.line;
-	}else{
+	}else if(STARTS_COLUMN(peeked)){
 		++parser->error.column;
 	}
 }
 
+/*
+ * Consumes a run of characters without line breaks, which every token is, so that only
+ * the column has to be advanced
+ */
+static void pop_run(yambler_parser_p parser, const yambler_char *begin, size_t length){
+#ifdef YAMBLER_UTF8_CHARS
+	for(size_t i = 0; i < length; ++i){
+		parser->error.column += STARTS_COLUMN(begin[i]);
+	}
+#else
+	(void)begin;
+	parser->error.column += length;
+#endif
+	yambler_input_buffer_consume_n(parser->input, length);
+	parser->offset += length;
+}
+
+static void pop_span(yambler_parser_p parser, const yambler_char *begin, size_t length){
+	size_t i = 0;
+	while(i < length){
+		size_t line_length = yambler_scan_until(&parser->line_breaks, begin + i, length - i);
+		pop_run(parser, begin + i, line_length);
+		i += line_length;
+		if(i < length){
+			pop_char(parser, begin[i]);
+			++i;
+		}
+	}
+}
+
+/*
+ * Everything allocated for a document lives in the arena and is released at once after the document has ended
+ */
+static void reset_document(yambler_parser_p parser){
+	yambler_arena_reset(parser->arena);
+	parser->capture.begin = NULL;
+	parser->capture.current = NULL;
+	parser->capture.end = NULL;
+}
+
 static void reset_capture(yambler_parser_p parser){
 	parser->capture.current = parser->capture.begin;
 }
 
-static void deliver_capture(yambler_parser_p parser){
-	parser->event->value.begin = parser->capture.begin;
-	parser->event->value.length = parser->capture.current - parser->capture.begin;
+/*
+ * The values delivered by the previous call are given up: the input buffer is released, the capture buffer is reused
+ * and the arena of an ended document is reset
+ */
+static void release_values(yambler_parser_p parser){
+	/* a key read ahead of the event beginning its mapping is delivered by the next call */
+	if(parser->token_pending){
+		return;
+	}
+	yambler_input_buffer_release(parser->input);
+	if(parser->document_ended){
+		reset_document(parser);
+		parser->document_ended = 0;
+	}
+	reset_capture(parser);
 }
 
-static yambler_status capture(yambler_parser_p parser, yambler_char c){
-	*parser->capture.current = c;
-	++parser->capture.current;
-	if(parser->capture.current == parser->capture.end){
+static void deliver_token(yambler_parser_p parser){
+	parser->event->value = parser->token;
+	parser->event->continued = parser->token_continued;
+}
+
+static yambler_status capture_span(yambler_parser_p parser, const yambler_char *begin, size_t length){
+	if(length >= (size_t)(parser->capture.end - parser->capture.current)){
 		size_t size = (parser->capture.end - parser->capture.begin);
-		size_t new_size = size + CAPTURE_SIZE_INCREMENT;
-		yambler_char *new_begin = realloc(parser->capture.begin, new_size * sizeof(yambler_char));
+		size_t used = (parser->capture.current - parser->capture.begin);
+		size_t new_size = size ? size * CAPTURE_GROWTH_FACTOR : CAPTURE_INITIAL_SIZE;
+		if(new_size <= used + length){
+			new_size = used + length + 1;
+		}
+		yambler_char *new_begin = yambler_arena_resize(parser->arena, parser->capture.begin, size * sizeof(yambler_char), new_size * sizeof(yambler_char));
 		if(new_begin == NULL){
 			return YAMBLER_ALLOC_ERROR;
 		}
-		parser->capture.begin = new_begin; 
-		parser->capture.current = new_begin + size;
+		parser->capture.begin = new_begin;
+		parser->capture.current = new_begin + used;
 		parser->capture.end = new_begin + new_size;
 	}
+	memcpy(parser->capture.current, begin, length * sizeof(yambler_char));
+	parser->capture.current += length;
 	return YAMBLER_OK;
 }
 
+/*
+ * The scanners below search the span of buffered characters in one call and only go back to the input buffer
+ * once the whole span has been consumed.
+ */
 
-static yambler_status skip_none_or_more_pred(yambler_parser_p parser, yambler_predicate pred){
-	yambler_char c;
+static yambler_status skip_none_or_more(yambler_parser_p parser, const struct yambler_scan_set *set){
+	const yambler_char *span;
+	size_t length;
 	do{
-		yambler_status status = peek_char(parser, &c);
+		yambler_status status = yambler_input_buffer_span(parser->input, 1, &span, &length);
 		if(status){
 			return status;
 		}
-		if(!((*pred)(c))){
+		size_t count = yambler_scan_while(set, span, length);
+		if(set->mask & YAMBLER_CLASS_BREAK){
+			pop_span(parser, span, count);
+		}else{
+			pop_run(parser, span, count);
+		}
+		if(count < length){
 			return YAMBLER_OK;
 		}
-		pop_char(parser, c);
 	}while(1);
 }
 
-static yambler_status capture_until_pred(yambler_parser_p parser, yambler_predicate pred){
-	reset_capture(parser);
-	yambler_char c;
+/*
+ * A token that ends within the buffered span is not copied, the token points into the input buffer,
+ * which is held until the next call to yambler_parser_parse. Only a token crossing the end of the span
+ * is collected in the capture buffer, unless fragments are enabled. Then the span is delivered as a
+ * continued fragment and the caller resumes the token with the next call.
+ */
+static yambler_status capture_until(yambler_parser_p parser, const struct yambler_scan_set *set){
+	parser->token.begin = NULL;
+	parser->token.length = 0;
+	parser->token_continued = 0;
+	const yambler_char *span;
+	size_t length;
+	yambler_status status = yambler_input_buffer_span(parser->input, 1, &span, &length);
+	if(status){
+		return status;
+	}
+	size_t count = yambler_scan_until(set, span, length);
+	if(count < length || parser->fragments){
+		parser->token.begin = span;
+		parser->token.length = count;
+		parser->token_continued = count == length;
+		yambler_input_buffer_hold(parser->input);
+		pop_run(parser, span, count);
+		return YAMBLER_OK;
+	}
+	/* the capture buffer may hold earlier values of the same batch, which stay where they are */
+	size_t start = parser->capture.current - parser->capture.begin;
 	do{
-		yambler_status status = peek_char(parser, &c);
+		status = capture_span(parser, span, count);
 		if(status){
 			return status;
 		}
-		if((*pred)(c)){
-			return YAMBLER_OK;
+		pop_run(parser, span, count);
+		if(count < length){
+			break;
+		}
+		status = yambler_input_buffer_span(parser->input, 1, &span, &length);
+		if(status){
+			break;
+		}
+		count = yambler_scan_until(set, span, length);
+	}while(1);
+	parser->token.begin = parser->capture.begin + start;
+	parser->token.length = (parser->capture.current - parser->capture.begin) - start;
+	return status;
+}
+
+/*
+ * A plain scalar ends at a line break, at a comment or at a mapping value indicator, which makes it a key,
+ * and within a flow collection at a flow indicator too. Plain scalars are delivered whole, even with fragments
+ * enabled, as whether one is a key is only known at its end. Trailing blanks are not part of the scalar.
+ * Within a flow collection a plain scalar continues on the next line, its line breaks are folded as those
+ * of quoted scalars, unless nothing more of it follows.
+ */
+static yambler_status capture_plain(yambler_parser_p parser, int flow, int *key){
+	*key = 0;
+	parser->token.begin = NULL;
+	parser->token.length = 0;
+	parser->token_continued = 0;
+	size_t start = parser->capture.current - parser->capture.begin;
+	size_t folded = SIZE_MAX;
+	int captured = 0;
+	yambler_char last = 0;
+	do{
+		const yambler_char *span;
+		size_t length;
+		yambler_status status = yambler_input_buffer_span(parser->input, 2, &span, &length);
+		if(status == YAMBLER_EMPTY){
+			break;
+		}
+		if(status){
+			return status;
+		}
+		size_t count = 0;
+		int end = 0;
+		while(!end){
+			if(flow){
+				count = next_structural(parser, span, length, count);
+			}else{
+				count += yambler_scan_until(&parser->plain_stops, span + count, length - count);
+			}
+			if(count == length){
+				break;
+			}
+			yambler_char c = span[count];
+			if(YAMBLER_CHAR_IS(c, YAMBLER_CLASS_BREAK)){
+				end = 1;
+			}else if(YAMBLER_CHAR_IS(c, YAMBLER_CLASS_COMMENT)){
+				end = YAMBLER_CHAR_IS(count ? span[count - 1] : last, YAMBLER_CLASS_BLANK);
+			}else if(YAMBLER_CHAR_IS(c, YAMBLER_CLASS_FLOW_INDICATOR)){
+				end = flow;
+			}else if(c == MAPPING_VALUE_CHAR){
+				if(count + 1 == length){
+					/* the character after the indicator is not buffered yet, unless the input ends */
+					end = *key = count == 0;
+					break;
+				}
+				end = *key = YAMBLER_CHAR_IS(span[count + 1], YAMBLER_CLASS_BLANK | YAMBLER_CLASS_BREAK | (flow ? YAMBLER_CLASS_FLOW_INDICATOR : 0));
+			}
+			count += !end;
+		}
+		int fold = end && flow && YAMBLER_CHAR_IS(span[count], YAMBLER_CLASS_BREAK);
+		if(end && !fold && !captured){
+			parser->token.begin = span;
+			parser->token.length = count;
+			yambler_input_buffer_hold(parser->input);
+			pop_run(parser, span, count);
+			break;
+		}
+		status = capture_span(parser, span, count);
+		if(status){
+			return status;
+		}
+		pop_run(parser, span, count);
+		if(count){
+			last = span[count - 1];
+			folded = SIZE_MAX;
+		}
+		captured = 1;
+		if(fold){
+			trim_capture(parser, start);
+			folded = parser->capture.current - parser->capture.begin;
+			status = fold_lines(parser, 0);
+			if(status){
+				return status;
+			}
+			last = SPACE_CHAR;
+		}else if(end){
+			break;
+		}
+	}while(1);
+	if(folded != SIZE_MAX){
+		/* the line breaks are not part of the scalar when it ends after them */
+		parser->capture.current = parser->capture.begin + folded;
+	}
+	if(captured){
+		parser->token.begin = parser->capture.begin + start;
+		parser->token.length = (parser->capture.current - parser->capture.begin) - start;
+	}
+	while(parser->token.length && YAMBLER_CHAR_IS(parser->token.begin[parser->token.length - 1], YAMBLER_CLASS_BLANK)){
+		--parser->token.length;
+	}
+	return YAMBLER_OK;
+}
+
+/*
+ * Stage two of reading flow collections and quoted scalars: the structural characters are found through the index
+ * instead of by looking at every character. Returns the offset in span of the next one at or after from, or length
+ * when there is none. The span begins at the current stream offset, a search leaving the window of the index
+ * indexes the next window of the span.
+ */
+static size_t next_structural(yambler_parser_p parser, const yambler_char *span, size_t length, size_t from){
+	struct yambler_parser_index *index = &parser->index;
+	size_t position = parser->offset + from;
+	size_t end = parser->offset + length;
+	while(position < end){
+		if(position < index->offset || position >= index->offset + index->length){
+			index->offset = position;
+			index->length = end - position < INDEX_SIZE ? end - position : INDEX_SIZE;
+			yambler_scan_index(&parser->structurals, span + (position - parser->offset), index->length, index->bits);
+		}
+		size_t next = yambler_scan_next_bit(index->bits, position - index->offset, index->length);
+		if(next < index->length){
+			return index->offset + next - parser->offset;
+		}
+		position = index->offset + index->length;
+	}
+	return length;
+}
+
+/*
+ * Folds the line breaks at the current position of a multi-line scalar, with the blanks that indent the lines after
+ * them, and captures what they fold into: a single line break becomes a space, unless it was escaped, and every line
+ * break after the first a line feed.
+ */
+static yambler_status fold_lines(yambler_parser_p parser, int escaped){
+	size_t breaks = 0;
+	do{
+		const yambler_char *span;
+		size_t length;
+		yambler_status status = yambler_input_buffer_span(parser->input, 2, &span, &length);
+		if(status == YAMBLER_EMPTY){
+			break;
 		}
-		status = capture(parser, c);
 		if(status){
 			return status;
 		}
-		pop_char(parser, c);
+		if(!YAMBLER_CHAR_IS(span[0], YAMBLER_CLASS_BREAK)){
+			break;
+		}
+		/* a carriage return and a line feed are one line break */
+		int crlf = span[0] == CARRIAGE_RETURN_CHAR && length > 1 && span[1] == LINE_FEED_CHAR;
+		pop_char(parser, span[0]);
+		if(crlf){
+			pop_char(parser, LINE_FEED_CHAR);
+		}
+		++breaks;
+		status = skip_none_or_more(parser, &parser->blanks);
+		if(status && status != YAMBLER_EMPTY){
+			return status;
+		}
 	}while(1);
+	yambler_char c = SPACE_CHAR;
+	if(breaks == 1 && !escaped){
+		return capture_span(parser, &c, 1);
+	}
+	c = LINE_FEED_CHAR;
+	for(size_t i = 1; i < breaks; ++i){
+		yambler_status status = capture_span(parser, &c, 1);
+		if(status){
+			return status;
+		}
+	}
+	return YAMBLER_OK;
 }
 
 /*
- * implementation of matchers
+ * Drops the blanks ending a line of a multi-line scalar, back to the offset kept, behind which blanks are content,
+ * as are those of escapes
  */
+static void trim_capture(yambler_parser_p parser, size_t kept){
+	while(parser->capture.current > parser->capture.begin + kept && YAMBLER_CHAR_IS(parser->capture.current[-1], YAMBLER_CLASS_BLANK)){
+		--parser->capture.current;
+	}
+}
 
-static int match_non_breaking_whitespace(yambler_char c){
-	return c == TAB_CHAR || c == SPACE_CHAR;
+static yambler_status capture_code_point(yambler_parser_p parser, yambler_code_point c){
+#ifdef YAMBLER_UTF8_CHARS
+	yambler_char units[4];
+	size_t length;
+	if(c < 0x80){
+		units[0] = (yambler_char)c;
+		length = 1;
+	}else if(c < 0x800){
+		units[0] = (yambler_char)(0xC0 | (c >> 6));
+		units[1] = (yambler_char)(0x80 | (c & 0x3F));
+		length = 2;
+	}else if(c < 0x10000){
+		units[0] = (yambler_char)(0xE0 | (c >> 12));
+		units[1] = (yambler_char)(0x80 | ((c >> 6) & 0x3F));
+		units[2] = (yambler_char)(0x80 | (c & 0x3F));
+		length = 3;
+	}else{
+		units[0] = (yambler_char)(0xF0 | (c >> 18));
+		units[1] = (yambler_char)(0x80 | ((c >> 12) & 0x3F));
+		units[2] = (yambler_char)(0x80 | ((c >> 6) & 0x3F));
+		units[3] = (yambler_char)(0x80 | (c & 0x3F));
+		length = 4;
+	}
+	return capture_span(parser, units, length);
+#else
+	yambler_char unit = c;
+	return capture_span(parser, &unit, 1);
+#endif
 }
 
-static int match_newline(yambler_char c){
-	return c == LINE_FEED_CHAR || c == CARRIAGE_RETURN_CHAR;
+static int parse_hex(const yambler_char *begin, size_t digits, yambler_code_point *dest){
+	yambler_code_point c = 0;
+	for(size_t i = 0; i < digits; ++i){
+		if(!YAMBLER_CHAR_IS(begin[i], YAMBLER_CLASS_HEX)){
+			return 0;
+		}
+		c = (c << 4) | (begin[i] <= 0x39 ? begin[i] - 0x30 : (begin[i] | 0x20) - 0x57);
+	}
+	*dest = c;
+	return 1;
+}
+
+/*
+ * Captures the character of the escape sequence at the beginning of span. A \u escape of a high surrogate
+ * must be followed by one of a low surrogate, the pair stands for a single character as in JSON.
+ */
+static yambler_status capture_escape(yambler_parser_p parser, const yambler_char *span, size_t length, size_t *escape_length){
+	yambler_code_point c = 0;
+	size_t digits = 0;
+	switch(length > 1 ? span[1] : 0){
+	case '0': c = 0x00; break;
+	case 'a': c = 0x07; break;
+	case 'b': c = 0x08; break;
+	case 't': case TAB_CHAR: c = 0x09; break;
+	case 'n': c = 0x0A; break;
+	case 'v': c = 0x0B; break;
+	case 'f': c = 0x0C; break;
+	case 'r': c = 0x0D; break;
+	case 'e': c = 0x1B; break;
+	case ' ': c = 0x20; break;
+	case '"': c = 0x22; break;
+	case '/': c = 0x2F; break;
+	case '\\': c = 0x5C; break;
+	case 'N': c = 0x85; break;
+	case '_': c = 0xA0; break;
+	case 'L': c = 0x2028; break;
+	case 'P': c = 0x2029; break;
+	case 'x': digits = 2; break;
+	case 'u': digits = 4; break;
+	case 'U': digits = 8; break;
+	default:
+		parser->error.message = "invalid escape sequence";
+		return YAMBLER_SYNTAX_ERROR;
+	}
+	*escape_length = 2 + digits;
+	if(digits){
+		if(length < 2 + digits || !parse_hex(span + 2, digits, &c)){
+			parser->error.message = "invalid escape sequence";
+			return YAMBLER_SYNTAX_ERROR;
+		}
+		yambler_code_point low;
+		if(digits == 4 && c >= 0xD800 && c <= 0xDBFF && length >= 12 && span[6] == ESCAPE_CHAR && span[7] == 'u'
+		   && parse_hex(span + 8, 4, &low) && low >= 0xDC00 && low <= 0xDFFF){
+			c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+			*escape_length = 12;
+		}
+		if((c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF){
+			parser->error.message = "invalid escape sequence";
+			return YAMBLER_SYNTAX_ERROR;
+		}
+	}
+	return capture_code_point(parser, c);
+}
+
+/*
+ * A quoted scalar is found through the index, which leaves only its quotes, escapes and line breaks to be looked at.
+ * One ending within the buffered span that has nothing to be unescaped or folded is not copied.
+ */
+static yambler_status capture_double_quoted(yambler_parser_p parser){
+	parser->token.begin = NULL;
+	parser->token.length = 0;
+	parser->token_continued = 0;
+	size_t start = parser->capture.current - parser->capture.begin;
+	size_t kept = start;
+	int captured = 0;
+	pop_char(parser, DOUBLE_QUOTE_CHAR);
+	do{
+		const yambler_char *span;
+		size_t length;
+		yambler_status status = yambler_input_buffer_span(parser->input, ESCAPE_MAX_LENGTH, &span, &length);
+		if(status == YAMBLER_EMPTY){
+			parser->error.message = "unterminated quoted scalar";
+			return YAMBLER_SYNTAX_ERROR;
+		}
+		if(status){
+			return status;
+		}
+		size_t count = 0;
+		while((count = next_structural(parser, span, length, count)) < length && span[count] != DOUBLE_QUOTE_CHAR
+		      && span[count] != ESCAPE_CHAR && !YAMBLER_CHAR_IS(span[count], YAMBLER_CLASS_BREAK)){
+			++count;
+		}
+		if(count < length && span[count] == DOUBLE_QUOTE_CHAR && !captured){
+			parser->token.begin = span;
+			parser->token.length = count;
+			yambler_input_buffer_hold(parser->input);
+			pop_run(parser, span, count);
+			pop_char(parser, DOUBLE_QUOTE_CHAR);
+			return YAMBLER_OK;
+		}
+		status = capture_span(parser, span, count);
+		if(status){
+			return status;
+		}
+		pop_run(parser, span, count);
+		captured = 1;
+		if(count == length){
+			continue;
+		}
+		yambler_char c = span[count];
+		if(c == DOUBLE_QUOTE_CHAR){
+			pop_char(parser, c);
+			break;
+		}
+		if(c != ESCAPE_CHAR){
+			trim_capture(parser, kept);
+			status = fold_lines(parser, 0);
+			if(status){
+				return status;
+			}
+			kept = parser->capture.current - parser->capture.begin;
+			continue;
+		}
+		if(count && length - count < ESCAPE_MAX_LENGTH){
+			/* the escape is read from the next span, which holds all of it unless the input ends */
+			continue;
+		}
+		if(length - count > 1 && YAMBLER_CHAR_IS(span[count + 1], YAMBLER_CLASS_BREAK)){
+			/* an escaped line break joins the lines, keeping the blanks before it */
+			pop_char(parser, ESCAPE_CHAR);
+			status = fold_lines(parser, 1);
+		}else{
+			size_t escape_length;
+			status = capture_escape(parser, span + count, length - count, &escape_length);
+			if(status == YAMBLER_OK){
+				pop_run(parser, span + count, escape_length);
+			}
+		}
+		if(status){
+			return status;
+		}
+		kept = parser->capture.current - parser->capture.begin;
+	}while(1);
+	parser->token.begin = parser->capture.begin + start;
+	parser->token.length = (parser->capture.current - parser->capture.begin) - start;
+	return YAMBLER_OK;
+}
+
+static yambler_status capture_single_quoted(yambler_parser_p parser){
+	parser->token.begin = NULL;
+	parser->token.length = 0;
+	parser->token_continued = 0;
+	size_t start = parser->capture.current - parser->capture.begin;
+	size_t kept = start;
+	int captured = 0;
+	pop_char(parser, SINGLE_QUOTE_CHAR);
+	do{
+		const yambler_char *span;
+		size_t length;
+		yambler_status status = yambler_input_buffer_span(parser->input, 2, &span, &length);
+		if(status == YAMBLER_EMPTY){
+			parser->error.message = "unterminated quoted scalar";
+			return YAMBLER_SYNTAX_ERROR;
+		}
+		if(status){
+			return status;
+		}
+		size_t count = 0;
+		while((count = next_structural(parser, span, length, count)) < length && span[count] != SINGLE_QUOTE_CHAR
+		      && !YAMBLER_CHAR_IS(span[count], YAMBLER_CLASS_BREAK)){
+			++count;
+		}
+		/* a quote is escaped by another one, which may not be buffered yet */
+		int end = count < length && span[count] == SINGLE_QUOTE_CHAR && (count + 1 == length ? count == 0 : span[count + 1] != SINGLE_QUOTE_CHAR);
+		if(end && !captured){
+			parser->token.begin = span;
+			parser->token.length = count;
+			yambler_input_buffer_hold(parser->input);
+			pop_run(parser, span, count);
+			pop_char(parser, SINGLE_QUOTE_CHAR);
+			return YAMBLER_OK;
+		}
+		int folded = count < length && YAMBLER_CHAR_IS(span[count], YAMBLER_CLASS_BREAK);
+		int escaped = !end && !folded && count + 1 < length;
+		status = capture_span(parser, span, count + escaped);
+		if(status){
+			return status;
+		}
+		pop_run(parser, span, count + 2 * escaped);
+		captured = 1;
+		if(end){
+			pop_char(parser, SINGLE_QUOTE_CHAR);
+			break;
+		}
+		if(folded){
+			trim_capture(parser, kept);
+			status = fold_lines(parser, 0);
+			if(status){
+				return status;
+			}
+			kept = parser->capture.current - parser->capture.begin;
+		}
+	}while(1);
+	parser->token.begin = parser->capture.begin + start;
+	parser->token.length = (parser->capture.current - parser->capture.begin) - start;
+	return YAMBLER_OK;
+}
+
+/*
+ * A quoted scalar is a key when a mapping value indicator follows it, which within a flow collection
+ * needs no blank after it, as in JSON
+ */
+static yambler_status capture_scalar(yambler_parser_p parser, yambler_char first, int flow, int *key){
+	if(first != DOUBLE_QUOTE_CHAR && first != SINGLE_QUOTE_CHAR){
+		return capture_plain(parser, flow, key);
+	}
+	*key = 0;
+	yambler_status status = first == DOUBLE_QUOTE_CHAR ? capture_double_quoted(parser) : capture_single_quoted(parser);
+	if(status == YAMBLER_OK){
+		status = skip_none_or_more(parser, &parser->blanks);
+	}
+	const yambler_char *span;
+	size_t length;
+	if(status == YAMBLER_OK){
+		status = yambler_input_buffer_span(parser->input, 2, &span, &length);
+	}
+	if(status == YAMBLER_EMPTY){
+		return YAMBLER_OK;
+	}
+	if(status){
+		return status;
+	}
+	*key = span[0] == MAPPING_VALUE_CHAR && (flow || length == 1 || YAMBLER_CHAR_IS(span[1], YAMBLER_CLASS_BLANK | YAMBLER_CLASS_BREAK));
+	return YAMBLER_OK;
+}
+
+/*
+ * Whether the node beginning the span is a scalar this parser reads, an indicator only begins a plain scalar
+ * when it is followed by a character that may be part of one
+ */
+static int starts_scalar(const yambler_char *span, size_t length, int flow){
+	yambler_char c = span[0];
+	if(!YAMBLER_CHAR_IS(c, YAMBLER_CLASS_INDICATOR) || c == DOUBLE_QUOTE_CHAR || c == SINGLE_QUOTE_CHAR){
+		return 1;
+	}
+	return (c == SEQUENCE_ENTRY_CHAR || c == MAPPING_KEY_CHAR || c == MAPPING_VALUE_CHAR) && length > 1
+	  && YAMBLER_CHAR_IS(span[1], YAMBLER_CLASS_NON_SPACE) && !(flow && YAMBLER_CHAR_IS(span[1], YAMBLER_CLASS_FLOW_INDICATOR));
 }
 
 /*
  * implementation of parser functions
  */
 
+static yambler_status next_event(yambler_parser_p parser, struct yambler_parser_event *event){
+  parser->event_ready = 0;
+  parser->event = event;
+  event->value.begin = NULL;
+  event->value.length = 0;
+  event->continued = 0;
+  while(!parser->event_ready && parser->stack.length){
+    yambler_status status;
+    switch((enum yambler_parser_state)parser->stack.states[--parser->stack.length]){
+    case YAMBLER_PS_BEGIN:
+      status = parse_begin(parser);
+      break;
+    case YAMBLER_PS_STREAM:
+      status = parse(parser);
+      break;
+    case YAMBLER_PS_COMMENT:
+      status = parse_comment(parser);
+      break;
+    case YAMBLER_PS_KEY:
+      status = parse_key(parser);
+      break;
+    case YAMBLER_PS_END:
+      status = parse_end(parser);
+      break;
+    default:
+      assert(0);
+      status = YAMBLER_ERROR;
+    }
+    if(status){
+      return status;
+    }
+  }
+  return parser->event_ready ? YAMBLER_OK : YAMBLER_EMPTY;
+}
+
 static yambler_status parse_begin(yambler_parser_p parser){
-  parser->event->type = YAMBLER_PE_DOCUMENT_BEGIN;
-  parser->event_ready = 1;
-  push_handle(parser, &parse);
-  return YAMBLER_OK;
+  /* a document begins with its first node or marker, a stream of comments only has none */
+  return push_state(parser, YAMBLER_PS_STREAM);
 }
 
 static yambler_status parse_comment(yambler_parser_p parser){
-  yambler_status status = capture_until_pred(parser, &match_newline);
+  yambler_status status = capture_until(parser, &parser->line_breaks);
   switch(status){
   case YAMBLER_OK:
-    pop_char(parser, LINE_FEED_CHAR);
+    if(parser->token_continued){
+      status = push_state(parser, YAMBLER_PS_COMMENT);
+      if(status){
+        return status;
+      }
+    }else{
+      pop_char(parser, LINE_FEED_CHAR);
+      parser->inline_node = YAMBLER_PI_NONE;
+    }
   case YAMBLER_EMPTY:
-    parser->event->type = YAMBLER_PE_COMMENT;
-    deliver_capture(parser);
-    parser->event_ready = 1;
+    /* a comment ended by the end of the input is delivered too */
+    emit_event(parser, YAMBLER_PE_COMMENT);
+    deliver_token(parser);
+    return YAMBLER_OK;
   }
   return status;
 }
 
+/*
+ * The block structure is read one line at a time, the first node of a line closes the levels indented
+ * as far as or further than it. Plain scalars of the block structure have to end on their line, quoted scalars and
+ * flow collections may continue on the following lines.
+ */
 static yambler_status parse(yambler_parser_p parser){
-  yambler_status status = skip_none_or_more_pred(parser, &match_non_breaking_whitespace);
+  struct yambler_parser_level *top = top_level(parser);
+  if(top != NULL && IS_FLOW(top)){
+    return parse_flow(parser);
+  }
+  const yambler_char *span;
+  size_t length;
+  yambler_char c;
+  do{
+    yambler_status status = skip_none_or_more(parser, &parser->blanks);
+    if(status == YAMBLER_OK){
+      status = yambler_input_buffer_span(parser->input, 4, &span, &length);
+    }
+    if(status == YAMBLER_EMPTY){
+      return parse_stream_end(parser);
+    }
+    if(status){
+      return status;
+    }
+    c = span[0];
+    if(!YAMBLER_CHAR_IS(c, YAMBLER_CLASS_BREAK)){
+      break;
+    }
+    pop_char(parser, c);
+    parser->inline_node = YAMBLER_PI_NONE;
+  }while(1);
+
+  if(c == COMMENT_CHAR){
+    yambler_status status = push_state_pair(parser, YAMBLER_PS_COMMENT, YAMBLER_PS_STREAM);
+    if(status){
+      return status;
+    }
+    pop_char(parser, c);
+    return YAMBLER_OK;
+  }
+
+  int column = parser->error.column;
+  int entry = c == SEQUENCE_ENTRY_CHAR && (length == 1 || YAMBLER_CHAR_IS(span[1], YAMBLER_CLASS_BLANK | YAMBLER_CLASS_BREAK));
+  if(parser->inline_node == YAMBLER_PI_NONE){
+    if(column == 0 && (c == SEQUENCE_ENTRY_CHAR || c == DOCUMENT_END_CHAR) && length >= 3 && span[1] == c && span[2] == c
+       && (length == 3 || YAMBLER_CHAR_IS(span[3], YAMBLER_CLASS_BLANK | YAMBLER_CLASS_BREAK))){
+      return parse_marker(parser, c);
+    }
+    if(top != NULL && closes_level(top, column, entry)){
+      close_level(parser);
+      return push_state(parser, YAMBLER_PS_STREAM);
+    }
+  }
+  if(!parser->document_open){
+    begin_document(parser);
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  if(entry){
+    return parse_entry(parser, column);
+  }
+  if(c == SEQUENCE_START_CHAR || c == MAPPING_START_CHAR){
+    if(expects_node(parser, column, 0)){
+      return begin_flow(parser, c, column);
+    }
+    parser->error.message = "unexpected flow collection";
+    return YAMBLER_SYNTAX_ERROR;
+  }
+  if(!starts_scalar(span, length, 0)){
+    parser->error.message = "unsupported syntax";
+    return YAMBLER_SYNTAX_ERROR;
+  }
+  return parse_scalar(parser, column);
+}
+
+/*
+ * A document start marker ends a document with content, or one begun by a marker, before it begins the next one
+ */
+static yambler_status parse_marker(yambler_parser_p parser, yambler_char marker){
+  if(parser->levels.length){
+    close_level(parser);
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  if(marker == SEQUENCE_ENTRY_CHAR && parser->document_open && (parser->root_done || parser->document_explicit)){
+    if(!complete_root(parser)){
+      end_document(parser);
+    }
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  if(marker == DOCUMENT_END_CHAR && parser->document_open && complete_root(parser)){
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  for(int i = 0; i < 3; ++i){
+    pop_char(parser, marker);
+  }
+  parser->inline_node = YAMBLER_PI_VALUE;
+  if(marker == SEQUENCE_ENTRY_CHAR){
+    if(!parser->document_open){
+      begin_document(parser);
+    }
+    parser->document_explicit = 1;
+  }else if(parser->document_open){
+    end_document(parser);
+  }
+  return push_state(parser, YAMBLER_PS_STREAM);
+}
+
+static yambler_status parse_entry(yambler_parser_p parser, int column){
+  struct yambler_parser_level *top = top_level(parser);
+  if(top != NULL && top->expect == YAMBLER_PX_ENTRY && column == top->indent){
+    pop_char(parser, SEQUENCE_ENTRY_CHAR);
+    top->expect = YAMBLER_PX_NODE;
+    parser->inline_node = YAMBLER_PI_ENTRY;
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  if(parser->inline_node != YAMBLER_PI_VALUE && expects_node(parser, column, 1)){
+    begin_node(parser);
+    yambler_status status = push_level(parser, column, YAMBLER_PX_ENTRY);
+    if(status){
+      return status;
+    }
+    emit_event(parser, YAMBLER_PE_SEQUENCE_BEGIN);
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  parser->error.message = "unexpected sequence entry";
+  return YAMBLER_SYNTAX_ERROR;
+}
+
+/*
+ * The key beginning a mapping is read before the mapping begins, it is held back and delivered by the key state
+ */
+static yambler_status parse_scalar(yambler_parser_p parser, int column){
+  const yambler_char *span;
+  size_t length;
+  yambler_status status = yambler_input_buffer_span(parser->input, 1, &span, &length);
   if(status){
     return status;
   }
-  yambler_char c;
-  status = peek_char(parser, &c);
+  int key;
+  status = capture_scalar(parser, span[0], 0, &key);
   if(status){
     return status;
   }
+  if(key){
+    pop_char(parser, MAPPING_VALUE_CHAR);
+    struct yambler_parser_level *top = top_level(parser);
+    if(top != NULL && top->expect == YAMBLER_PX_KEY && column == top->indent && parser->inline_node != YAMBLER_PI_VALUE){
+      top->expect = YAMBLER_PX_VALUE;
+      parser->inline_node = YAMBLER_PI_VALUE;
+      emit_event(parser, YAMBLER_PE_SCALAR);
+      deliver_token(parser);
+      return push_state(parser, YAMBLER_PS_STREAM);
+    }
+    if(parser->inline_node != YAMBLER_PI_VALUE && expects_node(parser, column, 0)){
+      begin_node(parser);
+      status = push_level(parser, column, YAMBLER_PX_VALUE);
+      if(status){
+        return status;
+      }
+      parser->inline_node = YAMBLER_PI_VALUE;
+      parser->token_pending = 1;
+      emit_event(parser, YAMBLER_PE_MAP_BEGIN);
+      return push_state_pair(parser, YAMBLER_PS_KEY, YAMBLER_PS_STREAM);
+    }
+    parser->error.column = column;
+    parser->error.message = "unexpected mapping key";
+    return YAMBLER_SYNTAX_ERROR;
+  }
+  if(expects_node(parser, column, 0)){
+    begin_node(parser);
+    emit_event(parser, YAMBLER_PE_SCALAR);
+    deliver_token(parser);
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  parser->error.column = column;
+  parser->error.message = "unexpected scalar";
+  return YAMBLER_SYNTAX_ERROR;
+}
+
+static yambler_status begin_flow(yambler_parser_p parser, yambler_char indicator, int column){
+  begin_node(parser);
+  yambler_status status = push_level(parser, column, indicator == SEQUENCE_START_CHAR ? YAMBLER_PX_FLOW_ENTRY : YAMBLER_PX_FLOW_KEY);
+  if(status){
+    return status;
+  }
+  pop_char(parser, indicator);
+  emit_event(parser, indicator == SEQUENCE_START_CHAR ? YAMBLER_PE_SEQUENCE_BEGIN : YAMBLER_PE_MAP_BEGIN);
+  return push_state(parser, YAMBLER_PS_STREAM);
+}
+
+/*
+ * Within a flow collection line breaks are spaces and indicators alone give the structure. A key or a value
+ * left out before a separator or the end of a mapping is an empty scalar.
+ */
+static yambler_status parse_flow(yambler_parser_p parser){
+  yambler_status status = skip_none_or_more(parser, &parser->flow_spaces);
+  const yambler_char *span;
+  size_t length;
+  if(status == YAMBLER_OK){
+    status = yambler_input_buffer_span(parser->input, 2, &span, &length);
+  }
+  if(status == YAMBLER_EMPTY){
+    parser->error.message = "unterminated flow collection";
+    return YAMBLER_SYNTAX_ERROR;
+  }
+  if(status){
+    return status;
+  }
+  yambler_char c = span[0];
+  struct yambler_parser_level *top = top_level(parser);
+  int empty = top->expect == YAMBLER_PX_FLOW_VALUE_INDICATOR || top->expect == YAMBLER_PX_FLOW_VALUE;
   switch(c){
   case COMMENT_CHAR:
-    status = push_handle_pair(parser, &parse_comment, &parse);
+    status = push_state_pair(parser, YAMBLER_PS_COMMENT, YAMBLER_PS_STREAM);
     if(status){
       return status;
     }
     pop_char(parser, c);
     return YAMBLER_OK;
+  case ENTRY_SEPARATOR_CHAR:
+    if(top->expect == YAMBLER_PX_FLOW_ENTRY_END || top->expect == YAMBLER_PX_FLOW_PAIR_END){
+      top->expect = top->expect == YAMBLER_PX_FLOW_ENTRY_END ? YAMBLER_PX_FLOW_ENTRY : YAMBLER_PX_FLOW_KEY;
+      pop_char(parser, c);
+      return push_state(parser, YAMBLER_PS_STREAM);
+    }
+    if(!empty){
+      parser->error.message = "unexpected flow entry separator";
+      return YAMBLER_SYNTAX_ERROR;
+    }
+    break;
+  case SEQUENCE_END_CHAR:
+  case MAPPING_END_CHAR:
+    if(c == MAPPING_END_CHAR ? top->expect == YAMBLER_PX_FLOW_KEY || top->expect == YAMBLER_PX_FLOW_PAIR_END
+       : top->expect == YAMBLER_PX_FLOW_ENTRY || top->expect == YAMBLER_PX_FLOW_ENTRY_END){
+      pop_char(parser, c);
+      --parser->levels.length;
+      emit_event(parser, c == MAPPING_END_CHAR ? YAMBLER_PE_MAP_END : YAMBLER_PE_SEQUENCE_END);
+      top = top_level(parser);
+      if(top == NULL || !IS_FLOW(top)){
+        parser->inline_node = YAMBLER_PI_VALUE;
+      }
+      return push_state(parser, YAMBLER_PS_STREAM);
+    }
+    if(c == SEQUENCE_END_CHAR || !empty){
+      parser->error.message = "unexpected end of flow collection";
+      return YAMBLER_SYNTAX_ERROR;
+    }
+    break;
+  case MAPPING_VALUE_CHAR:
+    if(top->expect == YAMBLER_PX_FLOW_VALUE_INDICATOR){
+      pop_char(parser, c);
+      top->expect = YAMBLER_PX_FLOW_VALUE;
+      return push_state(parser, YAMBLER_PS_STREAM);
+    }
+    empty = top->expect == YAMBLER_PX_FLOW_KEY && (length == 1 || YAMBLER_CHAR_IS(span[1], YAMBLER_CLASS_BLANK | YAMBLER_CLASS_BREAK | YAMBLER_CLASS_FLOW_INDICATOR));
+    if(!empty){
+      return parse_flow_scalar(parser, c);
+    }
+    break;
+  case SEQUENCE_START_CHAR:
+  case MAPPING_START_CHAR:
+    if(top->expect == YAMBLER_PX_FLOW_ENTRY || top->expect == YAMBLER_PX_FLOW_VALUE){
+      return begin_flow(parser, c, parser->error.column);
+    }
+    parser->error.message = top->expect == YAMBLER_PX_FLOW_KEY ? "unsupported syntax" : "unexpected flow collection";
+    return YAMBLER_SYNTAX_ERROR;
   default:
-    parser->error.message = "unexpected character";
+    if(!starts_scalar(span, length, 1)){
+      parser->error.message = "unsupported syntax";
+      return YAMBLER_SYNTAX_ERROR;
+    }
+    return parse_flow_scalar(parser, c);
+  }
+  /* the indicator is read again once the empty node has been delivered */
+  emit_event(parser, YAMBLER_PE_SCALAR);
+  begin_node(parser);
+  return push_state(parser, YAMBLER_PS_STREAM);
+}
+
+static yambler_status parse_flow_scalar(yambler_parser_p parser, yambler_char first){
+  struct yambler_parser_level *top = top_level(parser);
+  if(top->expect != YAMBLER_PX_FLOW_ENTRY && top->expect != YAMBLER_PX_FLOW_KEY && top->expect != YAMBLER_PX_FLOW_VALUE){
+    parser->error.message = "unexpected scalar";
     return YAMBLER_SYNTAX_ERROR;
   }
-};
+  int key;
+  yambler_status status = capture_scalar(parser, first, 1, &key);
+  if(status){
+    return status;
+  }
+  if(key){
+    if(top->expect != YAMBLER_PX_FLOW_KEY){
+      /* single pair mappings within flow sequences are not supported */
+      parser->error.message = top->expect == YAMBLER_PX_FLOW_ENTRY ? "unsupported syntax" : "unexpected mapping key";
+      return YAMBLER_SYNTAX_ERROR;
+    }
+    pop_char(parser, MAPPING_VALUE_CHAR);
+    top->expect = YAMBLER_PX_FLOW_VALUE;
+  }else{
+    begin_node(parser);
+  }
+  emit_event(parser, YAMBLER_PE_SCALAR);
+  deliver_token(parser);
+  return push_state(parser, YAMBLER_PS_STREAM);
+}
+
+static yambler_status parse_stream_end(yambler_parser_p parser){
+  if(parser->levels.length){
+    close_level(parser);
+    return push_state(parser, YAMBLER_PS_STREAM);
+  }
+  return YAMBLER_OK;
+}
+
+static yambler_status parse_key(yambler_parser_p parser){
+  emit_event(parser, YAMBLER_PE_SCALAR);
+  deliver_token(parser);
+  parser->token_pending = 0;
+  return YAMBLER_OK;
+}
 
 static yambler_status parse_end(yambler_parser_p parser){
-  parser->event->type = YAMBLER_PE_DOCUMENT_END;
-  parser->event_ready = 1;
+  if(parser->document_open){
+    if(complete_root(parser)){
+      return push_state(parser, YAMBLER_PS_END);
+    }
+    end_document(parser);
+  }
   return YAMBLER_OK;
 }
@@ -1,6 +1,7 @@
 #ifndef YAMBLER_PARSER_H
 #define YAMBLER_PARSER_H
 
+#include "yambler_allocator.h"
 #include "yambler_decoder.h"
 #include "yambler_input_buffer.h"
 #include "yambler_type.h"
@@ -28,19 +29,42 @@ struct yambler_parser_error{
 	const char *message;
 };
 
+/*
+ * With fragments enabled a value may be delivered in several events of the same type, every one but the last
+ * has continued set. A value can be split at any character, the last fragment may be empty.
+ */
 struct yambler_parser_event{
   enum yambler_parser_event_type type;
   struct yambler_string value;
+  int continued;
 };
 
 typedef struct yambler_parser * yambler_parser_p;
 
-yambler_status yambler_parser_create(yambler_parser_p *dest);
+yambler_status yambler_parser_create(yambler_parser_p *dest, const struct yambler_allocator *allocator);
 
 yambler_status yambler_parser_open(yambler_parser_p parser, yambler_input_buffer_p input_buffer);
 
+/*
+ * The value of an event points into the input buffer or into memory of the parser and stays valid
+ * until the next call to yambler_parser_parse, yambler_parser_parse_batch, yambler_parser_close or yambler_parser_open.
+ */
 yambler_status yambler_parser_parse(yambler_parser_p parser, struct yambler_parser_event *event);
 
+/*
+ * Parses up to capacity events into events and sets count to the number parsed, the values of all of them stay valid
+ * as with yambler_parser_parse. A status other than YAMBLER_OK is returned for the event that would have followed
+ * the count events delivered before it, just as yambler_parser_parse returns it after these.
+ */
+yambler_status yambler_parser_parse_batch(yambler_parser_p parser, struct yambler_parser_event *events, size_t capacity, size_t *count);
+
+/*
+ * Enables or disables delivering values that continue past the buffered input as fragments. The parser then
+ * holds no more of a comment than the input buffer does. Plain and quoted scalars are always delivered whole, as
+ * whether one is a key is only known at its end. Fragments are disabled by default.
+ */
+void yambler_parser_set_fragments(yambler_parser_p parser, int fragments);
+
 int yambler_parser_get_error(yambler_parser_p parser, struct yambler_parser_error *error);
 
 void yambler_parser_close(yambler_parser_p parser);
@@ -0,0 +1,218 @@
+#include "yambler_read_ahead.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+#include <semaphore.h>
+
+/*
+ * The blocks form a single producer, single consumer ring. Ownership of a block is handed over
+ * through the two semaphores, so the ring itself needs no lock: the producer only touches head,
+ * the consumer only touches tail and offset. A semaphore is only waited on when the ring is
+ * full or empty, which parks the idle thread instead of spinning.
+ */
+
+struct yambler_read_ahead_block{
+	yambler_byte *data;
+	size_t length;
+	yambler_status status;
+};
+
+struct yambler_read_ahead{
+	const struct yambler_allocator *allocator;
+	struct yambler_read_ahead_block *blocks;
+	size_t block_size;
+	size_t block_count;
+
+	size_t head;
+	size_t tail;
+	size_t offset;
+	int holding;
+	int finished;
+	int stop;
+
+	sem_t filled;
+	sem_t available;
+	pthread_t thread;
+	int running;
+
+	yambler_decoder_state read_state;
+	yambler_decoder_read_callback read;
+	yambler_decoder_open_callback open;
+	yambler_decoder_close_callback close;
+};
+
+#define DEFAULT_BLOCK_SIZE 65536
+#define MIN_BLOCK_COUNT 2
+
+yambler_status yambler_read_ahead_create(yambler_read_ahead_p *dest, const struct yambler_allocator *allocator, size_t block_size, size_t block_count, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close){
+	assert(dest != NULL);
+	assert(read != NULL);
+
+	if(block_size == 0){
+		block_size = DEFAULT_BLOCK_SIZE;
+	}
+	if(block_count < MIN_BLOCK_COUNT){
+		block_count = MIN_BLOCK_COUNT;
+	}
+
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_read_ahead_p read_ahead = yambler_allocate(allocator, sizeof(struct yambler_read_ahead));
+	if(read_ahead == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	read_ahead->allocator = allocator;
+	read_ahead->blocks = yambler_allocate(allocator, sizeof(struct yambler_read_ahead_block) * block_count);
+	if(read_ahead->blocks == NULL){
+		yambler_release(allocator, read_ahead);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	for(size_t i = 0; i < block_count; ++i){
+		read_ahead->blocks[i].data = yambler_allocate(allocator, sizeof(yambler_byte) * block_size);
+		if(read_ahead->blocks[i].data == NULL){
+			while(i != 0){
+				yambler_release(allocator, read_ahead->blocks[--i].data);
+			}
+			yambler_release(allocator, read_ahead->blocks);
+			yambler_release(allocator, read_ahead);
+			return YAMBLER_ALLOC_ERROR;
+		}
+	}
+	read_ahead->block_size = block_size;
+	read_ahead->block_count = block_count;
+	read_ahead->running = 0;
+	read_ahead->read_state = state;
+	read_ahead->read = read;
+	read_ahead->open = open;
+	read_ahead->close = close;
+	*dest = read_ahead;
+	return YAMBLER_OK;
+}
+
+static void *produce(void *argument){
+	yambler_read_ahead_p read_ahead = (yambler_read_ahead_p)argument;
+	while(1){
+		sem_wait(&read_ahead->available);
+		if(__atomic_load_n(&read_ahead->stop, __ATOMIC_ACQUIRE)){
+			break;
+		}
+		struct yambler_read_ahead_block *block = read_ahead->blocks + (read_ahead->head % read_ahead->block_count);
+		size_t count = 0;
+		block->status = (*read_ahead->read)(read_ahead->read_state, block->data, read_ahead->block_size, &count);
+		block->length = block->status ? 0 : count;
+		++read_ahead->head;
+		sem_post(&read_ahead->filled);
+		if(block->length == 0){
+			break;
+		}
+	}
+	return NULL;
+}
+
+yambler_status yambler_read_ahead_open(yambler_decoder_state *state){
+	assert(state != NULL);
+	yambler_read_ahead_p read_ahead = (yambler_read_ahead_p)*state;
+	assert(read_ahead != NULL);
+
+	if(read_ahead->running){
+		yambler_read_ahead_close(state);
+	}
+
+	if(read_ahead->open){
+		yambler_status status = (*read_ahead->open)(&read_ahead->read_state);
+		if(status){
+			return status;
+		}
+	}
+	read_ahead->head = 0;
+	read_ahead->tail = 0;
+	read_ahead->offset = 0;
+	read_ahead->holding = 0;
+	read_ahead->finished = 0;
+	read_ahead->stop = 0;
+	sem_init(&read_ahead->filled, 0, 0);
+	sem_init(&read_ahead->available, 0, (unsigned int)read_ahead->block_count);
+	if(pthread_create(&read_ahead->thread, NULL, &produce, read_ahead)){
+		sem_destroy(&read_ahead->filled);
+		sem_destroy(&read_ahead->available);
+		if(read_ahead->close){
+			(*read_ahead->close)(&read_ahead->read_state);
+		}
+		return YAMBLER_ERROR;
+	}
+	read_ahead->running = 1;
+	return YAMBLER_OK;
+}
+
+yambler_status yambler_read_ahead_read(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count){
+	yambler_read_ahead_p read_ahead = (yambler_read_ahead_p)state;
+	assert(read_ahead != NULL);
+	assert(read_ahead->running);
+
+	*read_count = 0;
+	if(read_ahead->finished){
+		return YAMBLER_OK;
+	}
+	if(!read_ahead->holding){
+		sem_wait(&read_ahead->filled);
+		read_ahead->holding = 1;
+		read_ahead->offset = 0;
+	}
+	struct yambler_read_ahead_block *block = read_ahead->blocks + (read_ahead->tail % read_ahead->block_count);
+	if(block->length == 0){
+		read_ahead->finished = 1;
+		return block->status;
+	}
+	size_t count = block->length - read_ahead->offset;
+	if(count > buffer_size){
+		count = buffer_size;
+	}
+	memcpy(buffer, block->data + read_ahead->offset, count);
+	read_ahead->offset += count;
+	if(read_ahead->offset == block->length){
+		read_ahead->holding = 0;
+		++read_ahead->tail;
+		sem_post(&read_ahead->available);
+	}
+	*read_count = count;
+	return YAMBLER_OK;
+}
+
+void yambler_read_ahead_close(yambler_decoder_state *state){
+	assert(state != NULL);
+	yambler_read_ahead_p read_ahead = (yambler_read_ahead_p)*state;
+	assert(read_ahead != NULL);
+
+	if(read_ahead->running){
+		__atomic_store_n(&read_ahead->stop, 1, __ATOMIC_RELEASE);
+		sem_post(&read_ahead->available);
+		pthread_join(read_ahead->thread, NULL);
+		sem_destroy(&read_ahead->filled);
+		sem_destroy(&read_ahead->available);
+		if(read_ahead->close){
+			(*read_ahead->close)(&read_ahead->read_state);
+		}
+		read_ahead->running = 0;
+	}
+}
+
+void yambler_read_ahead_destroy(yambler_read_ahead_p *src){
+	assert(src != NULL);
+
+	yambler_read_ahead_p read_ahead = *src;
+
+	assert(read_ahead != NULL);
+
+	yambler_decoder_state state = read_ahead;
+	yambler_read_ahead_close(&state);
+
+	const struct yambler_allocator *allocator = read_ahead->allocator;
+	for(size_t i = 0; i < read_ahead->block_count; ++i){
+		yambler_release(allocator, read_ahead->blocks[i].data);
+	}
+	yambler_release(allocator, read_ahead->blocks);
+	yambler_release(allocator, read_ahead);
+	*src = NULL;
+}
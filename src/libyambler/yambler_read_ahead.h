@@ -0,0 +1,29 @@
+#ifndef YAMBLER_READ_AHEAD_H
+#define YAMBLER_READ_AHEAD_H
+
+#include "yambler_type.h"
+#include "yambler_allocator.h"
+#include "yambler_decoder.h"
+
+#include <stddef.h>
+
+/*
+ * Read-ahead wraps a decoder source so that a background thread keeps filling blocks while
+ * the decoder consumes the previous ones. The wrapper exposes the usual decoder callbacks.
+ */
+
+struct yambler_read_ahead;
+
+typedef struct yambler_read_ahead * yambler_read_ahead_p;
+
+yambler_status yambler_read_ahead_create(yambler_read_ahead_p *dest, const struct yambler_allocator *allocator, size_t block_size, size_t block_count, yambler_decoder_read_callback read, yambler_decoder_state state, yambler_decoder_open_callback open, yambler_decoder_close_callback close);
+
+yambler_status yambler_read_ahead_open(yambler_decoder_state *state);
+
+yambler_status yambler_read_ahead_read(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count);
+
+void yambler_read_ahead_close(yambler_decoder_state *state);
+
+void yambler_read_ahead_destroy(yambler_read_ahead_p *src);
+
+#endif
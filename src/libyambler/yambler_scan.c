@@ -0,0 +1,365 @@
+#include "yambler_scan.h"
+
+#include <assert.h>
+
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define YAMBLER_SCAN_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Scan kernels return the length of the leading run of characters whose membership of the set differs from member,
+ * so a member of 1 stops at the first character in the set and a member of 0 at the first one outside it.
+ * The vector kernels compare a block against every character of the set and leave the block holding the match
+ * to the scalar kernel, which looks the characters up in the class table.
+ */
+
+typedef size_t (*scan_kernel)(const struct yambler_scan_set *, const yambler_char *, size_t, int);
+
+/*
+ * Index kernels fill the bitmap a word of 64 characters at a time and leave the last, partial word to the scalar kernel.
+ */
+
+typedef void (*index_kernel)(const struct yambler_scan_set *, const yambler_char *, size_t, uint64_t *);
+
+void yambler_scan_set_init(struct yambler_scan_set *set, yambler_char_class mask){
+	assert(set != NULL);
+
+	set->mask = mask;
+	set->vector = !(mask & YAMBLER_CLASS_WIDE);
+	set->count = 0;
+	for(yambler_char c = 0; c < 0x80 && set->vector; ++c){
+		if(YAMBLER_CHAR_IS(c, mask)){
+			if(set->count == YAMBLER_SCAN_SET_SIZE){
+				set->vector = 0;
+			}else{
+				set->chars[set->count++] = c;
+			}
+		}
+	}
+}
+
+static size_t scan_scalar(const struct yambler_scan_set *set, const yambler_char *in, size_t length, int member){
+	size_t i = 0;
+	while(i < length && YAMBLER_CHAR_IS(in[i], set->mask) != member){
+		++i;
+	}
+	return i;
+}
+
+static void index_scalar(const struct yambler_scan_set *set, const yambler_char *in, size_t length, uint64_t *bitmap){
+	for(size_t i = 0; i < length; i += 64){
+		size_t count = length - i < 64 ? length - i : 64;
+		uint64_t bits = 0;
+		for(size_t j = 0; j < count; ++j){
+			bits |= (uint64_t)YAMBLER_CHAR_IS(in[i + j], set->mask) << j;
+		}
+		bitmap[i / 64] = bits;
+	}
+}
+
+#ifdef YAMBLER_SCAN_X86
+
+#ifdef YAMBLER_UTF8_CHARS
+
+__attribute__((target("sse2")))
+static size_t scan_sse2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, int member){
+	__m128i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm_set1_epi8((char)set->chars[j]);
+	}
+	const int none = member ? 0 : 0xFFFF;
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m128i block = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i hits = _mm_setzero_si128();
+		for(size_t j = 0; j < set->count; ++j){
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, chars[j]));
+		}
+		if(_mm_movemask_epi8(hits) != none){
+			break;
+		}
+		i += 16;
+	}
+	return i + scan_scalar(set, in + i, length - i, member);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, int member){
+	__m256i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm256_set1_epi8((char)set->chars[j]);
+	}
+	const int none = member ? 0 : -1;
+	size_t i = 0;
+	while(i + 32 <= length){
+		__m256i block = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i hits = _mm256_setzero_si256();
+		for(size_t j = 0; j < set->count; ++j){
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, chars[j]));
+		}
+		if(_mm256_movemask_epi8(hits) != none){
+			break;
+		}
+		i += 32;
+	}
+	return i + scan_scalar(set, in + i, length - i, member);
+}
+
+__attribute__((target("sse2")))
+static void index_sse2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, uint64_t *bitmap){
+	__m128i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm_set1_epi8((char)set->chars[j]);
+	}
+	size_t i = 0;
+	while(i + 64 <= length){
+		uint64_t bits = 0;
+		for(int k = 0; k < 4; ++k){
+			__m128i block = _mm_loadu_si128((const __m128i *)(in + i + 16 * k));
+			__m128i hits = _mm_setzero_si128();
+			for(size_t j = 0; j < set->count; ++j){
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, chars[j]));
+			}
+			bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(hits) << (16 * k);
+		}
+		bitmap[i / 64] = bits;
+		i += 64;
+	}
+	index_scalar(set, in + i, length - i, bitmap + i / 64);
+}
+
+__attribute__((target("avx2")))
+static void index_avx2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, uint64_t *bitmap){
+	__m256i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm256_set1_epi8((char)set->chars[j]);
+	}
+	size_t i = 0;
+	while(i + 64 <= length){
+		__m256i low = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i high = _mm256_loadu_si256((const __m256i *)(in + i + 32));
+		__m256i low_hits = _mm256_setzero_si256();
+		__m256i high_hits = _mm256_setzero_si256();
+		for(size_t j = 0; j < set->count; ++j){
+			low_hits = _mm256_or_si256(low_hits, _mm256_cmpeq_epi8(low, chars[j]));
+			high_hits = _mm256_or_si256(high_hits, _mm256_cmpeq_epi8(high, chars[j]));
+		}
+		bitmap[i / 64] = (uint64_t)(uint32_t)_mm256_movemask_epi8(low_hits) | (uint64_t)(uint32_t)_mm256_movemask_epi8(high_hits) << 32;
+		i += 64;
+	}
+	index_scalar(set, in + i, length - i, bitmap + i / 64);
+}
+
+#else
+
+__attribute__((target("sse2")))
+static size_t scan_sse2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, int member){
+	__m128i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm_set1_epi32((int)set->chars[j]);
+	}
+	const int none = member ? 0 : 0xF;
+	size_t i = 0;
+	while(i + 8 <= length){
+		__m128i low = _mm_loadu_si128((const __m128i *)(in + i));
+		__m128i high = _mm_loadu_si128((const __m128i *)(in + i + 4));
+		__m128i low_hits = _mm_setzero_si128();
+		__m128i high_hits = _mm_setzero_si128();
+		for(size_t j = 0; j < set->count; ++j){
+			low_hits = _mm_or_si128(low_hits, _mm_cmpeq_epi32(low, chars[j]));
+			high_hits = _mm_or_si128(high_hits, _mm_cmpeq_epi32(high, chars[j]));
+		}
+		if(_mm_movemask_ps(_mm_castsi128_ps(low_hits)) != none || _mm_movemask_ps(_mm_castsi128_ps(high_hits)) != none){
+			break;
+		}
+		i += 8;
+	}
+	return i + scan_scalar(set, in + i, length - i, member);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, int member){
+	__m256i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm256_set1_epi32((int)set->chars[j]);
+	}
+	const int none = member ? 0 : 0xFF;
+	size_t i = 0;
+	while(i + 16 <= length){
+		__m256i low = _mm256_loadu_si256((const __m256i *)(in + i));
+		__m256i high = _mm256_loadu_si256((const __m256i *)(in + i + 8));
+		__m256i low_hits = _mm256_setzero_si256();
+		__m256i high_hits = _mm256_setzero_si256();
+		for(size_t j = 0; j < set->count; ++j){
+			low_hits = _mm256_or_si256(low_hits, _mm256_cmpeq_epi32(low, chars[j]));
+			high_hits = _mm256_or_si256(high_hits, _mm256_cmpeq_epi32(high, chars[j]));
+		}
+		if(_mm256_movemask_ps(_mm256_castsi256_ps(low_hits)) != none || _mm256_movemask_ps(_mm256_castsi256_ps(high_hits)) != none){
+			break;
+		}
+		i += 16;
+	}
+	return i + scan_scalar(set, in + i, length - i, member);
+}
+
+/*
+ * The index kernels narrow the characters to bytes with saturating packs before comparing them, characters past 0xFF
+ * saturating to 0xFF or 0x00, neither of which is a set character.
+ */
+
+__attribute__((target("sse2")))
+static __m128i narrow_sse2(const yambler_char *in){
+	__m128i low = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128((const __m128i *)(in + 4)));
+	__m128i high = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)(in + 8)), _mm_loadu_si128((const __m128i *)(in + 12)));
+	return _mm_packus_epi16(low, high);
+}
+
+__attribute__((target("sse2")))
+static void index_sse2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, uint64_t *bitmap){
+	__m128i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm_set1_epi8((char)set->chars[j]);
+	}
+	size_t i = 0;
+	while(i + 64 <= length){
+		uint64_t bits = 0;
+		for(int k = 0; k < 4; ++k){
+			__m128i block = narrow_sse2(in + i + 16 * k);
+			__m128i hits = _mm_setzero_si128();
+			for(size_t j = 0; j < set->count; ++j){
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, chars[j]));
+			}
+			bits |= (uint64_t)(uint32_t)_mm_movemask_epi8(hits) << (16 * k);
+		}
+		bitmap[i / 64] = bits;
+		i += 64;
+	}
+	index_scalar(set, in + i, length - i, bitmap + i / 64);
+}
+
+__attribute__((target("avx2")))
+static __m256i narrow_avx2(const yambler_char *in){
+	__m256i low = _mm256_packs_epi32(_mm256_loadu_si256((const __m256i *)in), _mm256_loadu_si256((const __m256i *)(in + 8)));
+	__m256i high = _mm256_packs_epi32(_mm256_loadu_si256((const __m256i *)(in + 16)), _mm256_loadu_si256((const __m256i *)(in + 24)));
+	/* The packs work within each 128-bit lane, leaving the groups of four characters interleaved across the lanes. */
+	return _mm256_permutevar8x32_epi32(_mm256_packus_epi16(low, high), _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+__attribute__((target("avx2")))
+static void index_avx2(const struct yambler_scan_set *set, const yambler_char *in, size_t length, uint64_t *bitmap){
+	__m256i chars[YAMBLER_SCAN_SET_SIZE];
+	for(size_t j = 0; j < set->count; ++j){
+		chars[j] = _mm256_set1_epi8((char)set->chars[j]);
+	}
+	size_t i = 0;
+	while(i + 64 <= length){
+		__m256i low = narrow_avx2(in + i);
+		__m256i high = narrow_avx2(in + i + 32);
+		__m256i low_hits = _mm256_setzero_si256();
+		__m256i high_hits = _mm256_setzero_si256();
+		for(size_t j = 0; j < set->count; ++j){
+			low_hits = _mm256_or_si256(low_hits, _mm256_cmpeq_epi8(low, chars[j]));
+			high_hits = _mm256_or_si256(high_hits, _mm256_cmpeq_epi8(high, chars[j]));
+		}
+		bitmap[i / 64] = (uint64_t)(uint32_t)_mm256_movemask_epi8(low_hits) | (uint64_t)(uint32_t)_mm256_movemask_epi8(high_hits) << 32;
+		i += 64;
+	}
+	index_scalar(set, in + i, length - i, bitmap + i / 64);
+}
+
+#endif
+
+#endif
+
+static scan_kernel scan = NULL;
+
+static index_kernel index_bits = NULL;
+
+/* the kernels are selected once, so that several threads may scan at the same time */
+static pthread_once_t kernel_selected = PTHREAD_ONCE_INIT;
+
+static void select_kernel(){
+	scan_kernel kernel = &scan_scalar;
+	index_kernel indexer = &index_scalar;
+#ifdef YAMBLER_SCAN_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")){
+		kernel = &scan_avx2;
+		indexer = &index_avx2;
+	}else if(__builtin_cpu_supports("sse2")){
+		kernel = &scan_sse2;
+		indexer = &index_sse2;
+	}
+#endif
+	index_bits = indexer;
+	scan = kernel;
+}
+
+size_t yambler_scan_until(const struct yambler_scan_set *set, const yambler_char *begin, size_t length){
+	assert(set != NULL);
+	assert(begin != NULL || length == 0);
+
+	if(!set->vector){
+		return scan_scalar(set, begin, length, 1);
+	}
+	pthread_once(&kernel_selected, &select_kernel);
+	return (*scan)(set, begin, length, 1);
+}
+
+size_t yambler_scan_while(const struct yambler_scan_set *set, const yambler_char *begin, size_t length){
+	assert(set != NULL);
+	assert(begin != NULL || length == 0);
+
+	if(!set->vector){
+		return scan_scalar(set, begin, length, 0);
+	}
+	pthread_once(&kernel_selected, &select_kernel);
+	return (*scan)(set, begin, length, 0);
+}
+
+void yambler_scan_index(const struct yambler_scan_set *set, const yambler_char *begin, size_t length, uint64_t *bitmap){
+	assert(set != NULL);
+	assert(begin != NULL || length == 0);
+	assert(bitmap != NULL || length == 0);
+
+	if(!set->vector){
+		index_scalar(set, begin, length, bitmap);
+		return;
+	}
+	pthread_once(&kernel_selected, &select_kernel);
+	(*index_bits)(set, begin, length, bitmap);
+}
+
+static size_t count_trailing_zeros(uint64_t bits){
+#ifdef __GNUC__
+	return (size_t)__builtin_ctzll(bits);
+#else
+	size_t count = 0;
+	while(!(bits & 1)){
+		bits >>= 1;
+		++count;
+	}
+	return count;
+#endif
+}
+
+size_t yambler_scan_next_bit(const uint64_t *bitmap, size_t from, size_t length){
+	assert(bitmap != NULL || length == 0);
+
+	if(from >= length){
+		return length;
+	}
+	size_t word = from / 64;
+	size_t words = YAMBLER_SCAN_INDEX_WORDS(length);
+	uint64_t bits = bitmap[word] & (~(uint64_t)0 << (from % 64));
+	while(bits == 0){
+		if(++word == words){
+			return length;
+		}
+		bits = bitmap[word];
+	}
+	return word * 64 + count_trailing_zeros(bits);
+}
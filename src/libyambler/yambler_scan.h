@@ -0,0 +1,58 @@
+#ifndef YAMBLER_SCAN_H
+#define YAMBLER_SCAN_H
+
+#include "yambler_type.h"
+#include "yambler_char_class.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Scanning of native character buffers for the characters of a class mask, such as the blanks, line breaks
+ * and indicators that end a token. Each call searches a whole buffer, a block of characters at a time on
+ * processors with SSE2 or AVX2 when the mask has at most YAMBLER_SCAN_SET_SIZE members, all of them ASCII.
+ * Other masks are scanned through the class table.
+ */
+
+#define YAMBLER_SCAN_SET_SIZE 16
+
+struct yambler_scan_set{
+	yambler_char_class mask;
+	int vector;
+	size_t count;
+	yambler_char chars[YAMBLER_SCAN_SET_SIZE];
+};
+
+/*
+ * Initializes a set from a mask of character classes.
+ */
+void yambler_scan_set_init(struct yambler_scan_set *set, yambler_char_class mask);
+
+/*
+ * Returns the offset of the first character in the set, or length when there is none.
+ */
+size_t yambler_scan_until(const struct yambler_scan_set *set, const yambler_char *begin, size_t length);
+
+/*
+ * Returns the offset of the first character not in the set, or length when there is none.
+ */
+size_t yambler_scan_while(const struct yambler_scan_set *set, const yambler_char *begin, size_t length);
+
+/*
+ * Indexing marks every character of the set in a bitmap, so that a parser can go from one marked character to the
+ * next without looking at the characters in between. Bit i of word w stands for the character at offset 64 * w + i.
+ */
+
+#define YAMBLER_SCAN_INDEX_WORDS(length) (((length) + 63) / 64)
+
+/*
+ * Fills the YAMBLER_SCAN_INDEX_WORDS(length) words of bitmap, the bits past length are cleared.
+ */
+void yambler_scan_index(const struct yambler_scan_set *set, const yambler_char *begin, size_t length, uint64_t *bitmap);
+
+/*
+ * Returns the offset of the first bit set at or after from, or length when there is none.
+ */
+size_t yambler_scan_next_bit(const uint64_t *bitmap, size_t from, size_t length);
+
+#endif
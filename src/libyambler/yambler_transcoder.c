@@ -0,0 +1,288 @@
+#define _GNU_SOURCE
+
+#include "yambler_transcoder.h"
+
+#include "yambler_codec.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define DEFAULT_BUFFER_SIZE 4096
+#define MIN_BUFFER_SIZE 4
+#define DETECTION_SIZE 4
+#define COPY_SIZE (64 * 1024 * 1024)
+#define PIPE_SIZE 65536
+
+/*
+ * The first bytes of the input are read up front to detect its encoding, the source hands them out again
+ * before reading on from the descriptor.
+ */
+
+struct yambler_transcode_source{
+	int fd;
+	yambler_byte prefix[DETECTION_SIZE];
+	size_t prefix_length;
+	size_t prefix_offset;
+};
+
+static yambler_status read_fd(int fd, yambler_byte *buffer, size_t buffer_size, size_t *read_count){
+	ssize_t result;
+	do{
+		result = read(fd, buffer, buffer_size);
+	}while(result == -1 && errno == EINTR);
+	if(result == -1){
+		return YAMBLER_ERROR;
+	}
+	*read_count = (size_t)result;
+	return YAMBLER_OK;
+}
+
+static yambler_status write_fd(int fd, const yambler_byte *buffer, size_t buffer_size){
+	while(buffer_size != 0){
+		ssize_t result = write(fd, buffer, buffer_size);
+		if(result == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			return YAMBLER_ERROR;
+		}
+		buffer += result;
+		buffer_size -= (size_t)result;
+	}
+	return YAMBLER_OK;
+}
+
+static yambler_status read_source(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count){
+	struct yambler_transcode_source *source = (struct yambler_transcode_source *)state;
+	if(source->prefix_offset < source->prefix_length){
+		size_t count = source->prefix_length - source->prefix_offset;
+		if(count > buffer_size){
+			count = buffer_size;
+		}
+		memcpy(buffer, source->prefix + source->prefix_offset, count);
+		source->prefix_offset += count;
+		*read_count = count;
+		return YAMBLER_OK;
+	}
+	return read_fd(source->fd, buffer, buffer_size, read_count);
+}
+
+static yambler_status write_target(yambler_encoder_state state, const yambler_byte *buffer, size_t buffer_size, size_t *write_count){
+	int fd = *(int *)state;
+	yambler_status status = write_fd(fd, buffer, buffer_size);
+	*write_count = status ? 0 : buffer_size;
+	return status;
+}
+
+yambler_status yambler_transcode(const struct yambler_allocator *allocator, yambler_decoder_p decoder, yambler_encoder_p encoder, size_t buffer_size){
+	assert(decoder != NULL);
+	assert(encoder != NULL);
+
+	if(buffer_size == 0){
+		buffer_size = DEFAULT_BUFFER_SIZE;
+	}else if(buffer_size < MIN_BUFFER_SIZE){
+		return YAMBLER_BOUNDS_ERROR;
+	}
+
+	allocator = yambler_allocator_or_default(allocator);
+	yambler_char *buffer = yambler_allocate(allocator, sizeof(yambler_char) * buffer_size);
+	if(buffer == NULL){
+		return YAMBLER_ALLOC_ERROR;
+	}
+
+	yambler_status status;
+	size_t length = 0;
+	while(1){
+		size_t count;
+		status = yambler_decoder_decode(decoder, buffer + length, buffer_size - length, &count);
+		if(status){
+			break;
+		}
+		if(count == 0){
+			if(length != 0){
+				status = YAMBLER_ENCODING_ERROR;
+			}
+			break;
+		}
+		length += count;
+		size_t write_count;
+		status = yambler_encoder_encode(encoder, buffer, length, &write_count);
+		if(status){
+			break;
+		}
+		/* only a character split by the end of the buffer is left behind */
+		length -= write_count;
+		memmove(buffer, buffer + write_count, length * sizeof(yambler_char));
+	}
+	yambler_release(allocator, buffer);
+	if(status == YAMBLER_OK){
+		status = yambler_encoder_flush(encoder);
+	}
+	return status;
+}
+
+static yambler_status splice_bytes(int in, int out, int *unsupported){
+	int pipe_fds[2];
+	if(pipe(pipe_fds) == -1){
+		return YAMBLER_ERROR;
+	}
+	yambler_status status = YAMBLER_OK;
+	int first = 1;
+	while(1){
+		ssize_t count = splice(in, NULL, pipe_fds[1], NULL, PIPE_SIZE, SPLICE_F_MOVE);
+		if(count == -1 && errno == EINTR){
+			continue;
+		}
+		if(count == -1 && first && errno == EINVAL){
+			*unsupported = 1;
+		}
+		if(count <= 0){
+			status = count == 0 ? YAMBLER_OK : YAMBLER_ERROR;
+			break;
+		}
+		first = 0;
+		while(count != 0){
+			ssize_t moved = splice(pipe_fds[0], NULL, out, NULL, (size_t)count, SPLICE_F_MOVE);
+			if(moved == -1 && errno == EINTR){
+				continue;
+			}
+			if(moved <= 0){
+				status = YAMBLER_ERROR;
+				break;
+			}
+			count -= moved;
+		}
+		if(status){
+			break;
+		}
+	}
+	close(pipe_fds[0]);
+	close(pipe_fds[1]);
+	return status;
+}
+
+static yambler_status copy_bytes(int in, int out){
+	int first = 1;
+	while(1){
+		ssize_t count = copy_file_range(in, NULL, out, NULL, COPY_SIZE, 0);
+		if(count == -1){
+			if(errno == EINTR){
+				continue;
+			}
+			/* copy_file_range only handles regular files, nothing has moved yet so splice can take over */
+			if(first && (errno == EINVAL || errno == EXDEV || errno == ENOSYS || errno == EBADF || errno == EOPNOTSUPP)){
+				break;
+			}
+			return YAMBLER_ERROR;
+		}
+		if(count == 0){
+			return YAMBLER_OK;
+		}
+		first = 0;
+	}
+	int unsupported = 0;
+	yambler_status status = splice_bytes(in, out, &unsupported);
+	if(!unsupported){
+		return status;
+	}
+	yambler_byte buffer[PIPE_SIZE];
+	while(1){
+		size_t count;
+		status = read_fd(in, buffer, PIPE_SIZE, &count);
+		if(status){
+			return status;
+		}
+		if(count == 0){
+			return YAMBLER_OK;
+		}
+		status = write_fd(out, buffer, count);
+		if(status){
+			return status;
+		}
+	}
+}
+
+static yambler_status pass_through(const struct yambler_allocator *allocator, struct yambler_transcode_source *source, int out, enum yambler_encoding encoding, yambler_encoder_flag options){
+	if(options & YAMBLER_ENCODER_INCLUDE_BOM){
+		/* the encoder writes the byte order mark on open */
+		yambler_encoder_p encoder;
+		yambler_status status = yambler_encoder_create(&encoder, allocator, 0, encoding, options, &write_target, &out, NULL, NULL);
+		if(status){
+			return status;
+		}
+		status = yambler_encoder_open(encoder);
+		if(status == YAMBLER_OK){
+			status = yambler_encoder_flush(encoder);
+			yambler_encoder_close(encoder);
+		}
+		yambler_encoder_destroy(&encoder);
+		if(status){
+			return status;
+		}
+	}
+	yambler_status status = write_fd(out, source->prefix + source->prefix_offset, source->prefix_length - source->prefix_offset);
+	if(status){
+		return status;
+	}
+	return copy_bytes(source->fd, out);
+}
+
+yambler_status yambler_transcode_fd(const struct yambler_allocator *allocator, int in, enum yambler_encoding input_encoding, int out, enum yambler_encoding output_encoding, yambler_encoder_flag options, size_t buffer_size){
+	struct yambler_transcode_source source;
+	source.fd = in;
+	source.prefix_length = 0;
+	source.prefix_offset = 0;
+	while(source.prefix_length < DETECTION_SIZE){
+		size_t count;
+		yambler_status status = read_fd(in, source.prefix + source.prefix_length, DETECTION_SIZE - source.prefix_length, &count);
+		if(status){
+			return status;
+		}
+		if(count == 0){
+			break;
+		}
+		source.prefix_length += count;
+	}
+	if(input_encoding == YAMBLER_ENCODING_DETECT){
+		input_encoding = yambler_codec_detect_encoding(source.prefix, source.prefix_length, &source.prefix_offset);
+	}else if(options & YAMBLER_ENCODER_INCLUDE_BOM){
+		/* the encoder writes a byte order mark of its own, one leading the input is dropped rather than doubled */
+		size_t bom_size;
+		if(yambler_codec_detect_encoding(source.prefix, source.prefix_length, &bom_size) == input_encoding){
+			source.prefix_offset = bom_size;
+		}
+	}
+
+	if(input_encoding == output_encoding){
+		return pass_through(allocator, &source, out, output_encoding, options);
+	}
+
+	yambler_decoder_p decoder;
+	yambler_status status = yambler_decoder_create(&decoder, allocator, buffer_size, input_encoding, &read_source, &source, NULL, NULL);
+	if(status){
+		return status;
+	}
+	yambler_encoder_p encoder;
+	status = yambler_encoder_create(&encoder, allocator, buffer_size, output_encoding, options, &write_target, &out, NULL, NULL);
+	if(status){
+		yambler_decoder_destroy(&decoder);
+		return status;
+	}
+	status = yambler_decoder_open(decoder);
+	if(status == YAMBLER_OK){
+		status = yambler_encoder_open(encoder);
+		if(status == YAMBLER_OK){
+			status = yambler_transcode(allocator, decoder, encoder, buffer_size);
+			yambler_encoder_close(encoder);
+		}
+		yambler_decoder_close(decoder);
+	}
+	yambler_encoder_destroy(&encoder);
+	yambler_decoder_destroy(&decoder);
+	return status;
+}
@@ -0,0 +1,25 @@
+#ifndef YAMBLER_TRANSCODER_H
+#define YAMBLER_TRANSCODER_H
+
+#include "yambler_type.h"
+#include "yambler_allocator.h"
+#include "yambler_decoder.h"
+#include "yambler_encoder.h"
+
+#include <stddef.h>
+
+/*
+ * Streams characters from an open decoder into an open encoder through a buffer of buffer_size native characters.
+ * The encoder is flushed when the decoder is exhausted, neither of them is closed.
+ */
+yambler_status yambler_transcode(const struct yambler_allocator *allocator, yambler_decoder_p decoder, yambler_encoder_p encoder, size_t buffer_size);
+
+/*
+ * Transcodes everything that remains on the input descriptor to the output descriptor.
+ * When the input is already in the output encoding the bytes are handed over by the kernel, through copy_file_range
+ * or splice, without being decoded. Only the byte order mark is adjusted to the encoder options: a detected one is
+ * always dropped, one of an explicit input encoding only when YAMBLER_ENCODER_INCLUDE_BOM adds its own.
+ */
+yambler_status yambler_transcode_fd(const struct yambler_allocator *allocator, int in, enum yambler_encoding input_encoding, int out, enum yambler_encoding output_encoding, yambler_encoder_flag options, size_t buffer_size);
+
+#endif
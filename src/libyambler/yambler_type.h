@@ -6,10 +6,20 @@
 
 typedef char yambler_byte;
 
+typedef uint32_t yambler_code_point;
+
+/*
+ * Characters are UTF-32 code points by default, or UTF-8 code units when built with YAMBLER_UTF8_CHARS
+ */
+
+#ifdef YAMBLER_UTF8_CHARS
+typedef uint8_t yambler_char;
+#else
 typedef uint32_t yambler_char;
+#endif
 
 struct yambler_string{
-	yambler_char *begin;
+	const yambler_char *begin;
 	size_t length;
 };
 
@@ -1,7 +1,9 @@
 #include "yambler_utility.h"
 
+#include <assert.h>
 #include <limits.h>
 #include <stdint.h>
+#include <strings.h>
 
 #if CHAR_BIT != 8
 
@@ -9,12 +11,19 @@
 
 #endif
 
+#ifndef YAMBLER_UTF8_CHARS
+
 static const union{
 	char byte_value[4];
 	uint32_t numeric_value;
 } endianness_test = {{0x01, 0x02, 0x03, 0x04}};
 
+#endif
+
 const char *yambler_native_encoding_name(){
+#ifdef YAMBLER_UTF8_CHARS
+	return "UTF-8";
+#else
 	if(endianness_test.numeric_value == 0x01020304ul){
 		//big endian
 		return "UTF-32BE";
@@ -22,6 +31,7 @@ const char *yambler_native_encoding_name(){
 		//little endian
 		return "UTF-32LE";
 	}
+#endif
 }
 
 const char *yambler_encoding_name(enum yambler_encoding encoding){
@@ -38,3 +48,69 @@ const char *yambler_encoding_name(enum yambler_encoding encoding){
 		return "UTF-8";
 	}
 }
+
+yambler_status yambler_encoding_from_name(const char *name, enum yambler_encoding *dest){
+	assert(name != NULL);
+	assert(dest != NULL);
+
+	static const enum yambler_encoding encodings[] = {
+		YAMBLER_ENCODING_UTF_8,
+		YAMBLER_ENCODING_UTF_16LE,
+		YAMBLER_ENCODING_UTF_16BE,
+		YAMBLER_ENCODING_UTF_32LE,
+		YAMBLER_ENCODING_UTF_32BE
+	};
+	for(size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]); ++i){
+		if(strcasecmp(name, yambler_encoding_name(encodings[i])) == 0){
+			*dest = encodings[i];
+			return YAMBLER_OK;
+		}
+	}
+	return YAMBLER_ERROR;
+}
+
+size_t yambler_string_code_points(struct yambler_string str, yambler_code_point *out, size_t out_size, size_t *consumed){
+	const yambler_char *in = str.begin;
+	size_t length = str.length;
+
+	assert(in != NULL || length == 0);
+	assert(out != NULL || out_size == 0);
+
+	size_t i = 0;
+	size_t count = 0;
+	while(i < length && count < out_size){
+#ifdef YAMBLER_UTF8_CHARS
+		yambler_code_point c = in[i];
+		size_t size = 1;
+		if(c >= 0x80){
+			/* the content of native strings has been validated by the decoder */
+			if(c >= 0xF0){
+				size = 4;
+				c &= 0x07;
+			}else if(c >= 0xE0){
+				size = 3;
+				c &= 0x0F;
+			}else{
+				size = 2;
+				c &= 0x1F;
+			}
+			if(i + size > length){
+				break;
+			}
+			for(size_t j = 1; j < size; ++j){
+				c = (c << 6) | (in[i + j] & 0x3F);
+			}
+		}
+		out[count] = c;
+		i += size;
+#else
+		out[count] = in[i];
+		++i;
+#endif
+		++count;
+	}
+	if(consumed){
+		*consumed = i;
+	}
+	return count;
+}
@@ -7,4 +7,8 @@ const char *yambler_native_encoding_name();
 
 const char *yambler_encoding_name(enum yambler_encoding encoding);
 
+yambler_status yambler_encoding_from_name(const char *name, enum yambler_encoding *dest);
+
+size_t yambler_string_code_points(struct yambler_string str, yambler_code_point *dest, size_t dest_size, size_t *consumed);
+
 #endif
@@ -0,0 +1,215 @@
+#include "yambler_validator.h"
+
+#include "yambler_codec.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define YAMBLER_VALIDATOR_X86
+#include <immintrin.h>
+#endif
+
+#define LINE_FEED_CHAR 0x0A
+#define CARRIAGE_RETURN_CHAR 0x0D
+
+/*
+ * Block kernels: return the length of a prefix of the input that is known to be valid.
+ * The prefix always ends on a character boundary; the remainder is checked by the scalar validator.
+ */
+
+typedef size_t (*validation_kernel)(const unsigned char *, size_t);
+
+static size_t validate_blocks_scalar(const unsigned char *in, size_t length){
+	(void)in;
+	(void)length;
+	return 0;
+}
+
+#ifdef YAMBLER_VALIDATOR_X86
+
+/*
+ * Lookup table validation after Keiser and Lemire, "Validating UTF-8 in less than one instruction per byte".
+ * Every pair of adjacent bytes is classified through three nibble lookups; any bit that survives the
+ * conjunction of the three lookups marks an invalid pair.
+ */
+
+#define TOO_SHORT (1 << 0)
+#define TOO_LONG (1 << 1)
+#define OVERLONG_3 (1 << 2)
+#define TOO_LARGE (1 << 3)
+#define SURROGATE (1 << 4)
+#define OVERLONG_2 (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4 (1 << 6)
+#define TWO_CONTS (1 << 7)
+#define CARRY (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+#define TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+__attribute__((target("avx2")))
+static inline __m256i shift_in(__m256i input, __m256i previous, int count){
+	__m256i joined = _mm256_permute2x128_si256(previous, input, 0x21);
+	switch(count){
+	case 1:
+		return _mm256_alignr_epi8(input, joined, 15);
+	case 2:
+		return _mm256_alignr_epi8(input, joined, 14);
+	default:
+		return _mm256_alignr_epi8(input, joined, 13);
+	}
+}
+
+__attribute__((target("avx2")))
+static inline __m256i high_nibbles(__m256i input){
+	return _mm256_and_si256(_mm256_srli_epi16(input, 4), _mm256_set1_epi8(0x0F));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i check_block(__m256i input, __m256i previous){
+	const __m256i byte_1_high_table = TABLE(
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		TOO_SHORT | OVERLONG_2,
+		TOO_SHORT,
+		TOO_SHORT | OVERLONG_3 | SURROGATE,
+		TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+	const __m256i byte_1_low_table = TABLE(
+		CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		CARRY | OVERLONG_2,
+		CARRY,
+		CARRY,
+		CARRY | TOO_LARGE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+		CARRY | TOO_LARGE | TOO_LARGE_1000,
+		CARRY | TOO_LARGE | TOO_LARGE_1000);
+	const __m256i byte_2_high_table = TABLE(
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+		TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+	__m256i previous_1 = shift_in(input, previous, 1);
+	__m256i special_cases = _mm256_and_si256(
+		_mm256_and_si256(
+			_mm256_shuffle_epi8(byte_1_high_table, high_nibbles(previous_1)),
+			_mm256_shuffle_epi8(byte_1_low_table, _mm256_and_si256(previous_1, _mm256_set1_epi8(0x0F)))),
+		_mm256_shuffle_epi8(byte_2_high_table, high_nibbles(input)));
+
+	__m256i previous_2 = shift_in(input, previous, 2);
+	__m256i previous_3 = shift_in(input, previous, 3);
+	__m256i third_byte = _mm256_subs_epu8(previous_2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+	__m256i fourth_byte = _mm256_subs_epu8(previous_3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+	__m256i must_continue = _mm256_and_si256(_mm256_or_si256(third_byte, fourth_byte), _mm256_set1_epi8((char)0x80));
+	return _mm256_xor_si256(must_continue, special_cases);
+}
+
+__attribute__((target("avx2")))
+static size_t validate_blocks_avx2(const unsigned char *in, size_t length){
+	const __m256i incomplete_limits = _mm256_setr_epi8(
+		(char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF,
+		(char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF,
+		(char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF,
+		(char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)0xFF, (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+	__m256i previous = _mm256_setzero_si256();
+	size_t i = 0;
+	while(i + 32 <= length){
+		__m256i input = _mm256_loadu_si256((const __m256i *)(in + i));
+		if(_mm256_movemask_epi8(input) == 0){
+			/* an ASCII block is valid by itself, but a sequence left open by the previous block is not */
+			__m256i incomplete = _mm256_subs_epu8(previous, incomplete_limits);
+			if(!_mm256_testz_si256(incomplete, incomplete)){
+				break;
+			}
+		}else{
+			__m256i errors = check_block(input, previous);
+			if(!_mm256_testz_si256(errors, errors)){
+				break;
+			}
+		}
+		previous = input;
+		i += 32;
+	}
+	if(i == 0){
+		return 0;
+	}
+	/* the last block may end inside a sequence, back up to its lead byte */
+	size_t back = 0;
+	while(back < 3 && (in[i - 1 - back] & 0xC0) == 0x80){
+		++back;
+	}
+	if((in[i - 1 - back] & 0xC0) == 0xC0){
+		return i - 1 - back;
+	}
+	return i - back;
+}
+
+#endif
+
+static validation_kernel validate_blocks = NULL;
+
+/* the kernel is selected once, as documents may be validated on several threads at the same time */
+static pthread_once_t kernel_selected = PTHREAD_ONCE_INIT;
+
+static void select_kernel(){
+	validation_kernel kernel = &validate_blocks_scalar;
+#ifdef YAMBLER_VALIDATOR_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")){
+		kernel = &validate_blocks_avx2;
+	}
+#endif
+	validate_blocks = kernel;
+}
+
+static void locate(const unsigned char *in, size_t offset, struct yambler_validation_error *error){
+	size_t line = 0;
+	size_t line_begin = 0;
+	for(size_t i = 0; i < offset; ++i){
+		if(in[i] == LINE_FEED_CHAR || (in[i] == CARRIAGE_RETURN_CHAR && (i + 1 == offset || in[i + 1] != LINE_FEED_CHAR))){
+			++line;
+			line_begin = i + 1;
+		}
+	}
+	size_t column = 0;
+	for(size_t i = line_begin; i < offset; ++i){
+		if((in[i] & 0xC0) != 0x80){
+			++column;
+		}
+	}
+	error->offset = offset;
+	error->line = line;
+	error->column = column;
+}
+
+yambler_status yambler_validate(const yambler_byte *data, size_t length, struct yambler_validation_error *error){
+	assert(data != NULL || length == 0);
+
+	pthread_once(&kernel_selected, &select_kernel);
+
+	const unsigned char *in = (const unsigned char *)data;
+	size_t valid = (*validate_blocks)(in, length);
+	size_t remainder;
+	enum yambler_codec_result result = yambler_codec_validate_utf8(data + valid, length - valid, &remainder);
+	if(result == YAMBLER_CODEC_OK){
+		return YAMBLER_OK;
+	}
+	if(error){
+		locate(in, valid + remainder, error);
+	}
+	return YAMBLER_ENCODING_ERROR;
+}
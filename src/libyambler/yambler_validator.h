@@ -0,0 +1,16 @@
+#ifndef YAMBLER_VALIDATOR_H
+#define YAMBLER_VALIDATOR_H
+
+#include "yambler_type.h"
+
+#include <stddef.h>
+
+struct yambler_validation_error{
+	size_t offset;
+	size_t line;
+	size_t column;
+};
+
+yambler_status yambler_validate(const yambler_byte *data, size_t length, struct yambler_validation_error *error);
+
+#endif
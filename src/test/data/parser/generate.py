@@ -0,0 +1,303 @@
+#!/usr/bin/env python3
+#
+# Generates the parser test cases. The expected events of every case come from PyYAML, which serves as the
+# reference the parser is compared against. Each case is a .yaml input next to a .events transcript in the format
+# written by test_parser.c, invalid cases have no transcript. Run from this directory, the output is deterministic.
+#
+
+import json
+import os
+import random
+import yaml
+
+EVENT_NAMES = {
+    'DocumentStartEvent': 'document begin',
+    'DocumentEndEvent': 'document end',
+    'MappingStartEvent': 'map begin',
+    'MappingEndEvent': 'map end',
+    'SequenceStartEvent': 'sequence begin',
+    'SequenceEndEvent': 'sequence end',
+}
+
+
+def escape(value):
+    out = []
+    for c in value:
+        if c == '\\':
+            out.append('\\\\')
+        elif c == '\n':
+            out.append('\\n')
+        elif c == '\t':
+            out.append('\\t')
+        elif c == '\r':
+            out.append('\\r')
+        elif ord(c) < 0x20 or ord(c) == 0x7F:
+            out.append('\\x%02x' % ord(c))
+        else:
+            out.append(c)
+    return ''.join(out)
+
+
+def reference_events(text):
+    lines = []
+    for event in yaml.parse(text):
+        name = type(event).__name__
+        if name in EVENT_NAMES:
+            lines.append(EVENT_NAMES[name])
+        elif name == 'ScalarEvent':
+            # the reference keeps the halves of an escaped surrogate pair, which the parser joins as JSON does
+            value = event.value.encode('utf-16-le', 'surrogatepass').decode('utf-16-le')
+            lines.append('scalar: ' + escape(value))
+    return lines
+
+
+def write_case(group, name, text, events):
+    os.makedirs(group, exist_ok=True)
+    with open(os.path.join(group, name + '.yaml'), 'w', encoding='utf-8', newline='') as f:
+        f.write(text)
+    if events is not None:
+        with open(os.path.join(group, name + '.events'), 'w', encoding='utf-8', newline='') as f:
+            f.write(''.join(line + '\n' for line in events))
+
+
+def write_valid(group, cases):
+    for name, text in cases:
+        write_case(group, name, text, reference_events(text))
+
+
+def write_invalid(group, cases):
+    for name, text in cases:
+        try:
+            reference_events(text)
+        except yaml.YAMLError:
+            write_case(group, name, text, None)
+            continue
+        raise SystemExit('%s/%s is accepted by the reference' % (group, name))
+
+
+# block collections and plain scalars
+
+BLOCK_WORDS = ['a', 'bb', 'key', 'x y', '-1', '-x', 'a:b', 'http://h/p', 'v#1', '\u00e9', '1.5', '?q', ':w',
+               '\u00fc \u00df', '\u4e2d\u6587', '\U0001F600']
+
+
+def block_node(words, indent, depth, lines, prefix):
+    r = random.random()
+    if depth > 4 or r < 0.35 or prefix.endswith(': '):
+        lines.append(prefix + random.choice(words) + random.choice(['', '  ', ' # c']))
+        return
+    if r < 0.7:
+        keys = random.sample(['k%d' % i for i in range(20)], random.randint(1, 4))
+        for i, key in enumerate(keys):
+            line = (prefix if i == 0 else ' ' * indent) + key + ':'
+            t = random.random()
+            if t < 0.1:
+                lines.append(line)
+                continue
+            if t < 0.5:
+                block_node(words, indent, depth + 1, lines, line + ' ')
+                continue
+            lines.append(line + random.choice(['', ' # kc']))
+            if random.random() < 0.2:
+                lines.append(' ' * (indent + 1) + '# inner')
+            if random.random() < 0.3:
+                block_sequence(words, indent + random.choice([0, 2]), depth + 1, lines, '')
+            else:
+                inner = indent + random.randint(1, 3)
+                block_node(words, inner, depth + 1, lines, ' ' * inner)
+    else:
+        block_sequence(words, indent, depth, lines, prefix)
+
+
+def block_sequence(words, indent, depth, lines, prefix):
+    for i in range(random.randint(1, 4)):
+        line = (prefix if i == 0 else ' ' * indent) or ' ' * indent
+        if random.random() < 0.1:
+            lines.append(line + '-')
+            continue
+        block_node(words, indent + 2, depth + 1, lines, line + '- ')
+
+
+def block_stream(words):
+    text = ''
+    for i in range(random.randint(1, 3)):
+        lines = []
+        block_node(words, 0, 0, lines, '')
+        if i or random.random() < 0.3:
+            text += '---\n'
+        text += '\n'.join(lines) + '\n'
+        if random.random() < 0.3:
+            text += '...\n'
+    if random.random() < 0.5:
+        text = text.rstrip('\n')
+    return text
+
+
+def random_cases(prefix, count, generate):
+    cases = []
+    seed = 0
+    while len(cases) < count:
+        random.seed(prefix + str(seed))
+        seed += 1
+        text = generate()
+        try:
+            reference_events(text)
+        except yaml.YAMLError:
+            continue
+        cases.append(('%s_%03d' % (prefix, len(cases)), text))
+    return cases
+
+
+BLOCK_CASES = [
+    ('empty', ''),
+    ('comments_only', '# a\n  # b\n'),
+    ('scalar_root', 'just a scalar\n'),
+    ('explicit_documents', '--- a\n--- b\n...\n---\nc: d\n'),
+    ('explicit_empty_documents', '---\n--- # c\n...\n---'),
+    ('empty_values', 'a:\nb:\n- \n-\nc: d\n'),
+    ('sequence_in_mapping', 'a:\n- 1\n- 2\nb:\n  - 3\n'),
+    ('nested_sequences', '- - a\n  - b\n- - - c\n'),
+    ('mapping_in_sequence', '- a: 1\n  b: 2\n- c: 3\n'),
+    ('trailing_blanks', 'a: b   \nc:    d  \n'),
+    ('crlf', 'a: b\r\nc:\r\n  - d\r\n'),
+    ('colon_in_plain', 'url: http://h:80/p\nt: 12:30\n'),
+    ('hash_in_plain', 'a: b#c\nd: e # comment\n'),
+]
+
+BLOCK_INVALID = [
+    ('nested_value', 'a: b: c\n'),
+    ('sequence_then_key', '- a\nb: c\n'),
+    ('bad_indentation', 'a:\n  b: 1\n c: 2\n'),
+    ('key_then_sequence', 'a: 1\n- b\n'),
+]
+
+
+# flow collections, written as JSON and as by the flow style of the emitter
+
+def random_string():
+    # a raw line or paragraph separator would be a line break to the reference, as in YAML 1.1
+    chars = []
+    for _ in range(random.randint(0, 12)):
+        r = random.random()
+        if r < 0.6:
+            chars.append(random.choice('abc xyz,[]{}:#\'/-'))
+        elif r < 0.7:
+            chars.append(random.choice('"\\\t\n\b\f\r'))
+        elif r < 0.8:
+            chars.append(chr(random.randint(0xA0, 0xFF)))
+        elif r < 0.9:
+            chars.append(chr(random.choice([0x20AC, 0x4E2D, 0x1F600, 0x10FFFF])))
+        else:
+            chars.append(chr(random.randint(1, 0x1F)))
+    return ''.join(chars)
+
+
+def random_value(depth):
+    r = random.random()
+    if depth > 4 or r < 0.4:
+        t = random.random()
+        if t < 0.5:
+            return random_string()
+        if t < 0.7:
+            return random.choice([1, -2.5e3, True, False, None, 0])
+        return random.choice(['plain', 'a b', 'x-y', 'a#b'])
+    if r < 0.7:
+        return [random_value(depth + 1) for _ in range(random.randint(0, 5))]
+    return {random_string(): random_value(depth + 1) for _ in range(random.randint(0, 5))}
+
+
+def json_text(value, ascii_only):
+    if isinstance(value, list):
+        separator = random.choice([',', ', ', ' ,\n  ', ',\n'])
+        return ('[' + random.choice(['', ' ', '\n ']) + separator.join(json_text(v, ascii_only) for v in value)
+                + random.choice(['', ' ', '\n']) + ']')
+    if isinstance(value, dict):
+        separator = random.choice([',', ', ', ' ,\n  ', ',\n'])
+        return ('{' + random.choice(['', ' ']) + separator.join(
+            json.dumps(k, ensure_ascii=ascii_only) + random.choice([': ', ' : ']) + json_text(v, ascii_only)
+            for k, v in value.items()) + '}')
+    return json.dumps(value, ensure_ascii=ascii_only)
+
+
+def simple_keys(value, leaf=lambda v: v):
+    # the emitter writes empty keys and keys with line breaks as explicit keys, which the parser does not read
+    if isinstance(value, list):
+        return [simple_keys(v, leaf) for v in value]
+    if isinstance(value, dict):
+        return {(k.translate({ord(c): ' ' for c in '\n\r\x85\u2028\u2029'}) or 'k'): simple_keys(v, leaf)
+                for k, v in value.items()}
+    return leaf(value)
+
+
+def flow_document():
+    value = random_value(0)
+    if not isinstance(value, (list, dict)):
+        value = [value]
+    if random.random() < 0.5:
+        text = json_text(value, random.random() < 0.5)
+    else:
+        text = yaml.dump(simple_keys(value), default_flow_style=True, allow_unicode=random.random() < 0.5,
+                         width=random.randint(20, 80))
+    if random.random() < 0.3:
+        text = 'doc: ' + text
+    return text + random.choice(['', '\n'])
+
+
+FLOW_CASES = [
+    ('empty_collections', '[]\n---\n{}\n---\n[[], {}, [{}]]\n'),
+    ('nested', '{a: [b, {c: d}], e: {f: [g]}}\n'),
+    ('trailing_comma', '[a, b, ]\n--- {a: b, }\n'),
+    ('multi_line', '[\n  a,\n  b\n]\n'),
+    ('comments', '[a, # first\n b # second\n]\n'),
+    ('empty_value', '{a: , b: c}\n'),
+    ('in_block', 'k: [a, b]\nl:\n  - {c: d}\n  - [e]\n'),
+    ('plain_with_indicators', '[a-b, c:d, e#f, http://h/p]\n'),
+]
+
+FLOW_INVALID = [
+    ('unterminated_sequence', '[a, b\n'),
+    ('unterminated_mapping', '{a: b\n'),
+    ('mismatched_end', '{a: b]\n'),
+    ('extra_end', '[a]]\n'),
+]
+
+
+# quoted scalars, folded by the emitter at various widths
+
+def quoted_document():
+    value = random_value(1)
+    if not isinstance(value, (list, dict)):
+        value = {random_string(): value}
+    # other values than strings are written with tags
+    return yaml.dump(simple_keys(value, str), default_style=random.choice(['"', "'"]), default_flow_style=random.random() < 0.3,
+                     allow_unicode=random.random() < 0.5, width=random.randint(10, 60))
+
+
+QUOTED_CASES = [
+    ('double_escapes', '"\\0\\a\\b\\t\\n\\v\\f\\r\\e\\ \\"\\/\\\\\\N\\_\\L\\P"\n'),
+    ('double_hex_escapes', '- "\\x41\\xe9"\n- "\\u00e9\\u4e2d"\n- "\\U0001F600"\n- "\\ud83d\\ude00"\n'),
+    ('double_folding', 'a: "one\n  two\n\n  three \\\n  four"\n'),
+    ('single_quotes', "a: 'it''s'\nb: ''\n'c': 'one\n  two\n\n  three'\n"),
+    ('quoted_keys', '"a b": 1\n\'c: d\': 2\n"": 3\n'),
+    ('quoted_in_sequence', '- "a"\n- \'b\'\n- "c" # comment\n'),
+    ('adjacent_value', '{"a":b, "c":[d]}\n'),
+]
+
+QUOTED_INVALID = [
+    ('unterminated_double', 'a: "b\n'),
+    ('unterminated_single', "a: 'b\n"),
+    ('bad_escape', '"\\q"\n'),
+    ('text_after_quote', '"a" b\n'),
+]
+
+
+def main():
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    write_valid('block', BLOCK_CASES + random_cases('block', 60, lambda: block_stream(BLOCK_WORDS)))
+    write_valid('flow', FLOW_CASES + random_cases('flow', 60, flow_document))
+    write_valid('quoted', QUOTED_CASES + random_cases('quoted', 60, quoted_document))
+    write_invalid('invalid', BLOCK_INVALID + FLOW_INVALID + QUOTED_INVALID)
+
+
+if __name__ == '__main__':
+    main()
@@ -8,5 +8,16 @@ int test_test(){
 
 int main(int arg_count, const char **args){
 	add_test("test", &test_test);
+	add_codec_tests();
+	add_scan_tests();
+	add_arena_tests();
+	add_allocator_tests();
+	add_input_buffer_tests();
+	add_validator_tests();
+	add_parallel_decoder_tests();
+	add_encoder_tests();
+	add_transcoder_tests();
+	add_parser_tests();
+	add_batch_tests();
 	return test_main(arg_count, args);
 }
@@ -0,0 +1,311 @@
+#include "test.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <iconv.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "data"
+#endif
+
+#define TESTS_SIZE 64
+
+struct test{
+	const char *name;
+	test_function function;
+};
+
+static struct test tests[TESTS_SIZE];
+
+static size_t test_count = 0;
+
+static const char *current_test = NULL;
+
+static uint32_t state = 1;
+
+void add_test(const char *name, test_function test){
+	assert(test_count < TESTS_SIZE);
+	tests[test_count].name = name;
+	tests[test_count].function = test;
+	++test_count;
+}
+
+static int is_selected(const char *name, int arg_count, const char **args){
+	if(arg_count < 2){
+		return 1;
+	}
+	for(int i = 1; i < arg_count; ++i){
+		if(strcmp(args[i], name) == 0){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int test_main(int arg_count, const char **args){
+	size_t failed = 0;
+	for(size_t i = 0; i < test_count; ++i){
+		if(!is_selected(tests[i].name, arg_count, args)){
+			continue;
+		}
+		current_test = tests[i].name;
+		test_seed(1);
+		int result = (*tests[i].function)();
+		printf("%s: %s\n", result ? "FAIL" : "PASS", tests[i].name);
+		if(result){
+			++failed;
+		}
+	}
+	current_test = NULL;
+	return failed ? 1 : 0;
+}
+
+int test_fail(const char *format, ...){
+	va_list arguments;
+	va_start(arguments, format);
+	fprintf(stderr, "%s: ", current_test ? current_test : "test");
+	vfprintf(stderr, format, arguments);
+	fputc('\n', stderr);
+	va_end(arguments);
+	return 1;
+}
+
+void test_seed(uint32_t seed){
+	state = seed ? seed : 1;
+}
+
+uint32_t test_random(uint32_t limit){
+	/* xorshift32 */
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return limit ? state % limit : state;
+}
+
+int test_text_append(struct test_text *text, const char *data, size_t length){
+	if(text->length + length + 1 > text->size){
+		size_t size = text->size ? text->size * 2 : 256;
+		while(size < text->length + length + 1){
+			size *= 2;
+		}
+		char *grown = realloc(text->data, size);
+		if(grown == NULL){
+			return test_fail("unable to allocate %zu bytes of text", size);
+		}
+		text->data = grown;
+		text->size = size;
+	}
+	memcpy(text->data + text->length, data, length);
+	text->length += length;
+	text->data[text->length] = '\0';
+	return 0;
+}
+
+int test_text_append_string(struct test_text *text, const char *data){
+	return test_text_append(text, data, strlen(data));
+}
+
+void test_text_free(struct test_text *text){
+	free(text->data);
+	text->data = NULL;
+	text->length = 0;
+	text->size = 0;
+}
+
+int test_read_file(const char *path, struct test_text *dest){
+	char full_path[1024];
+	snprintf(full_path, sizeof(full_path), "%s/%s", TEST_DATA_DIR, path);
+	FILE *file = fopen(full_path, "rb");
+	if(file == NULL){
+		return test_fail("unable to open %s", full_path);
+	}
+	int result = test_text_append(dest, "", 0);
+	char buffer[4096];
+	size_t count;
+	while(!result && (count = fread(buffer, 1, sizeof(buffer), file)) > 0){
+		result = test_text_append(dest, buffer, count);
+	}
+	if(!result && ferror(file)){
+		result = test_fail("unable to read %s", full_path);
+	}
+	fclose(file);
+	return result;
+}
+
+static int compare_names(const void *a, const void *b){
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+int test_list_files(const char *directory, const char *suffix, char ***dest, size_t *count){
+	char full_path[1024];
+	snprintf(full_path, sizeof(full_path), "%s/%s", TEST_DATA_DIR, directory);
+	DIR *dir = opendir(full_path);
+	if(dir == NULL){
+		return test_fail("unable to open %s", full_path);
+	}
+	char **list = NULL;
+	size_t list_count = 0;
+	size_t list_size = 0;
+	size_t suffix_length = strlen(suffix);
+	int result = 0;
+	struct dirent *entry;
+	while(!result && (entry = readdir(dir)) != NULL){
+		size_t length = strlen(entry->d_name);
+		if(length <= suffix_length || strcmp(entry->d_name + length - suffix_length, suffix) != 0){
+			continue;
+		}
+		if(list_count == list_size){
+			list_size = list_size ? list_size * 2 : 64;
+			char **grown = realloc(list, sizeof(char *) * list_size);
+			if(grown == NULL){
+				result = test_fail("unable to allocate the list of %s", full_path);
+				break;
+			}
+			list = grown;
+		}
+		char *name = malloc(length - suffix_length + 1);
+		if(name == NULL){
+			result = test_fail("unable to allocate the list of %s", full_path);
+			break;
+		}
+		memcpy(name, entry->d_name, length - suffix_length);
+		name[length - suffix_length] = '\0';
+		list[list_count++] = name;
+	}
+	closedir(dir);
+	if(result){
+		test_free_list(list, list_count);
+		return result;
+	}
+	if(list_count == 0){
+		free(list);
+		return test_fail("%s holds no %s files", full_path, suffix);
+	}
+	qsort(list, list_count, sizeof(char *), &compare_names);
+	*dest = list;
+	*count = list_count;
+	return 0;
+}
+
+void test_free_list(char **list, size_t count){
+	for(size_t i = 0; i < count; ++i){
+		free(list[i]);
+	}
+	free(list);
+}
+
+static int append_utf8(struct test_text *text, yambler_code_point c){
+	char units[4];
+	size_t length;
+	if(c < 0x80){
+		units[0] = (char)c;
+		length = 1;
+	}else if(c < 0x800){
+		units[0] = (char)(0xC0 | (c >> 6));
+		units[1] = (char)(0x80 | (c & 0x3F));
+		length = 2;
+	}else if(c < 0x10000){
+		units[0] = (char)(0xE0 | (c >> 12));
+		units[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+		units[2] = (char)(0x80 | (c & 0x3F));
+		length = 3;
+	}else{
+		units[0] = (char)(0xF0 | (c >> 18));
+		units[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+		units[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+		units[3] = (char)(0x80 | (c & 0x3F));
+		length = 4;
+	}
+	return test_text_append(text, units, length);
+}
+
+int test_text_append_native(struct test_text *text, yambler_code_point c){
+#ifdef YAMBLER_UTF8_CHARS
+	return append_utf8(text, c);
+#else
+	yambler_char native = c;
+	return test_text_append(text, (const char *)&native, sizeof(native));
+#endif
+}
+
+int test_text_append_unit(struct test_text *text, uint32_t unit, size_t size, int big_endian){
+	char units[4];
+	for(size_t i = 0; i < size; ++i){
+		units[big_endian ? size - 1 - i : i] = (char)(unit >> (8 * i));
+	}
+	return test_text_append(text, units, size);
+}
+
+int test_text_append_encoded(struct test_text *text, yambler_code_point c, enum yambler_encoding encoding){
+	int big_endian = encoding == YAMBLER_ENCODING_UTF_16BE || encoding == YAMBLER_ENCODING_UTF_32BE;
+	if(encoding == YAMBLER_ENCODING_UTF_8){
+		return append_utf8(text, c);
+	}else if(encoding == YAMBLER_ENCODING_UTF_32LE || encoding == YAMBLER_ENCODING_UTF_32BE){
+		return test_text_append_unit(text, c, 4, big_endian);
+	}else if(c < 0x10000){
+		return test_text_append_unit(text, c, 2, big_endian);
+	}
+	c -= 0x10000;
+	return test_text_append_unit(text, 0xD800 | (c >> 10), 2, big_endian) || test_text_append_unit(text, 0xDC00 | (c & 0x3FF), 2, big_endian);
+}
+
+int test_iconv(const char *to, const char *from, const char *data, size_t length, struct test_text *dest){
+	iconv_t descriptor = iconv_open(to, from);
+	if(descriptor == (iconv_t)-1){
+		return test_fail("iconv does not convert %s to %s", from, to);
+	}
+	char *in = (char *)data;
+	size_t in_remainder = length;
+	int result = 0;
+	while(!result){
+		char buffer[256];
+		char *out = buffer;
+		size_t out_remainder = sizeof(buffer);
+		size_t converted = iconv(descriptor, &in, &in_remainder, &out, &out_remainder);
+		if(test_text_append(dest, buffer, sizeof(buffer) - out_remainder)){
+			result = -1;
+		}else if(converted != (size_t)-1){
+			break;
+		}else if(errno != E2BIG){
+			result = 1;
+		}
+	}
+	iconv_close(descriptor);
+	return result < 0 ? 1 : result;
+}
+
+yambler_code_point test_random_code_point(){
+	static const yambler_code_point bounds[] = {0x01, 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF, 0xE000, 0xFFFD, 0xFFFF, 0x10000, 0x10FFFF};
+	switch(test_random(8)){
+	case 0:
+		return bounds[test_random(sizeof(bounds) / sizeof(bounds[0]))];
+	case 1:
+		return 0x80 + test_random(0x780);
+	case 2:{
+		yambler_code_point c = 0x800 + test_random(0xF800);
+		return c >= 0xD800 && c <= 0xDFFF ? c + 0x800 : c;
+	}
+	case 3:
+		return 0x10000 + test_random(0x100000);
+	default:
+		return 0x20 + test_random(0x5F);
+	}
+}
+
+void test_random_code_points(yambler_code_point *dest, size_t max_count, size_t *count){
+	*count = test_random((uint32_t)max_count);
+	for(size_t i = 0; i < *count; ++i){
+		dest[i] = test_random_code_point();
+		if(dest[i] >= 0x20 && dest[i] < 0x80){
+			/* an ASCII run */
+			for(size_t run = test_random(80); run > 0 && i + 1 < *count; --run){
+				dest[++i] = 0x20 + test_random(0x5F);
+			}
+		}
+	}
+}
@@ -0,0 +1,132 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include "yambler_allocator.h"
+#include "yambler_input_buffer.h"
+#include "yambler_type.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A test returns 0 when it passes. Failures are reported through test_fail, which returns 1 so that a test can
+ * end with return test_fail(...).
+ */
+
+typedef int (*test_function)();
+
+void add_test(const char *name, test_function test);
+
+/*
+ * Runs the tests named by the arguments, or every test without arguments, and returns the exit status of the program
+ */
+int test_main(int arg_count, const char **args);
+
+int test_fail(const char *format, ...);
+
+/*
+ * A deterministic generator, so that a failing round can be repeated
+ */
+void test_seed(uint32_t seed);
+
+uint32_t test_random(uint32_t limit);
+
+/*
+ * Text that grows as it is appended to, a zeroed one is empty. The data is null terminated once anything was appended.
+ */
+struct test_text{
+	char *data;
+	size_t length;
+	size_t size;
+};
+
+int test_text_append(struct test_text *text, const char *data, size_t length);
+
+int test_text_append_string(struct test_text *text, const char *data);
+
+void test_text_free(struct test_text *text);
+
+/*
+ * Appends a code point as native characters
+ */
+int test_text_append_native(struct test_text *text, yambler_code_point c);
+
+/*
+ * Appends a code unit of size bytes in either byte order
+ */
+int test_text_append_unit(struct test_text *text, uint32_t unit, size_t size, int big_endian);
+
+/*
+ * Appends a code point in a Unicode encoding, without checking that it is a character
+ */
+int test_text_append_encoded(struct test_text *text, yambler_code_point c, enum yambler_encoding encoding);
+
+/*
+ * Converts data with iconv, returning 0 when all of it was converted
+ */
+int test_iconv(const char *to, const char *from, const char *data, size_t length, struct test_text *dest);
+
+/*
+ * A code point of any length, often one of the bounds of a length, or printable ASCII
+ */
+yambler_code_point test_random_code_point();
+
+/*
+ * Fills dest with fewer than max_count random code points, with runs of ASCII long enough for the vector kernels
+ */
+void test_random_code_points(yambler_code_point *dest, size_t max_count, size_t *count);
+
+/*
+ * Reads a file of the test data, path is relative to TEST_DATA_DIR
+ */
+int test_read_file(const char *path, struct test_text *dest);
+
+/*
+ * Lists the names of the files in a directory of the test data that end in suffix, without the suffix and in order
+ */
+int test_list_files(const char *directory, const char *suffix, char ***dest, size_t *count);
+
+void test_free_list(char **list, size_t count);
+
+/*
+ * Options of test_parse. A capacity of zero parses an event at a time, other capacities parse batches of up to
+ * that many events. Comments are left out of the transcript unless comments is set.
+ */
+struct test_parse_options{
+	size_t buffer_size;
+	size_t capacity;
+	int fragments;
+	int comments;
+	const struct yambler_allocator *allocator;
+};
+
+/*
+ * Parses UTF-8 data and appends the events to transcript, a line per event as in the .events files of the test data.
+ * Returns the status that ended parsing, which is YAMBLER_EMPTY once the input was parsed completely, and fills
+ * stats with the statistics of the input buffer if it is not NULL.
+ */
+yambler_status test_parse(const char *data, size_t length, const struct test_parse_options *options, struct test_text *transcript, struct yambler_input_buffer_stats *stats);
+
+void add_codec_tests();
+
+void add_scan_tests();
+
+void add_arena_tests();
+
+void add_allocator_tests();
+
+void add_input_buffer_tests();
+
+void add_validator_tests();
+
+void add_parallel_decoder_tests();
+
+void add_encoder_tests();
+
+void add_transcoder_tests();
+
+void add_parser_tests();
+
+void add_batch_tests();
+
+#endif
@@ -0,0 +1,256 @@
+#include "test.h"
+
+#include "yambler_allocator.h"
+#include "yambler_input_buffer.h"
+#include "yambler_parser.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+struct allocator_align_probe{
+	char c;
+	union{
+		long double float_value;
+		long long int_value;
+		void *pointer;
+	} value;
+};
+
+#define ALLOCATOR_ALIGNMENT offsetof(struct allocator_align_probe, value)
+
+#define ALLOCATOR_MAX_FAILURES 100
+
+/*
+ * An allocator on top of the default one that fails once remaining allocations and reallocations have succeeded
+ */
+struct failing_allocator{
+	struct yambler_allocator allocator;
+	size_t remaining;
+};
+
+static void *failing_allocate(void *state, size_t size){
+	struct failing_allocator *failing = (struct failing_allocator *)state;
+	if(failing->remaining == 0){
+		return NULL;
+	}
+	--failing->remaining;
+	return yambler_allocate(yambler_default_allocator(), size);
+}
+
+static void *failing_reallocate(void *state, void *data, size_t size){
+	struct failing_allocator *failing = (struct failing_allocator *)state;
+	if(failing->remaining == 0){
+		return NULL;
+	}
+	--failing->remaining;
+	return yambler_reallocate(yambler_default_allocator(), data, size);
+}
+
+static void failing_release(void *state, void *data){
+	(void)state;
+	yambler_release(yambler_default_allocator(), data);
+}
+
+static void failing_allocator_init(struct failing_allocator *failing, size_t remaining){
+	failing->allocator.allocate = &failing_allocate;
+	failing->allocator.reallocate = &failing_reallocate;
+	failing->allocator.release = &failing_release;
+	failing->allocator.state = failing;
+	failing->remaining = remaining;
+}
+
+static int check_stats(const struct yambler_allocator_stats *stats, const struct yambler_allocator_stats *expected, const char *what){
+	if(stats->allocations != expected->allocations || stats->reallocations != expected->reallocations || stats->releases != expected->releases){
+		return test_fail("%s: %zu allocations, %zu reallocations and %zu releases instead of %zu, %zu and %zu", what, stats->allocations, stats->reallocations, stats->releases, expected->allocations, expected->reallocations, expected->releases);
+	}
+	if(stats->bytes_in_use != expected->bytes_in_use || stats->peak_bytes_in_use != expected->peak_bytes_in_use || stats->total_bytes != expected->total_bytes){
+		return test_fail("%s: %zu bytes in use, a peak of %zu and %zu in total instead of %zu, %zu and %zu", what, stats->bytes_in_use, stats->peak_bytes_in_use, stats->total_bytes, expected->bytes_in_use, expected->peak_bytes_in_use, expected->total_bytes);
+	}
+	return 0;
+}
+
+enum allocator_operation{
+	ALLOCATOR_ALLOCATE,
+	ALLOCATOR_REALLOCATE,
+	ALLOCATOR_RELEASE
+};
+
+/*
+ * Runs a fixed sequence of calls through a counting allocator, on top of parent, and checks the statistics after
+ * each of them. A reallocation of NULL counts as an allocation, releasing NULL is not counted at all.
+ */
+static int run_counts(const struct yambler_allocator *parent, const char *what){
+	static const struct{
+		enum allocator_operation operation;
+		size_t block;
+		size_t size;
+		struct yambler_allocator_stats expected;
+	} steps[] = {
+		{ALLOCATOR_ALLOCATE, 0, 100, {1, 0, 0, 100, 100, 100}},
+		{ALLOCATOR_ALLOCATE, 1, 50, {2, 0, 0, 150, 150, 150}},
+		{ALLOCATOR_REALLOCATE, 0, 300, {2, 1, 0, 350, 350, 450}},
+		{ALLOCATOR_REALLOCATE, 2, 20, {3, 1, 0, 370, 370, 470}},
+		{ALLOCATOR_REALLOCATE, 0, 10, {3, 2, 0, 80, 370, 480}},
+		{ALLOCATOR_RELEASE, 1, 0, {3, 2, 1, 30, 370, 480}},
+		{ALLOCATOR_RELEASE, 3, 0, {3, 2, 1, 30, 370, 480}},
+		{ALLOCATOR_ALLOCATE, 1, 0, {4, 2, 1, 30, 370, 480}},
+		{ALLOCATOR_RELEASE, 0, 0, {4, 2, 2, 20, 370, 480}},
+		{ALLOCATOR_RELEASE, 2, 0, {4, 2, 3, 0, 370, 480}},
+		{ALLOCATOR_RELEASE, 1, 0, {4, 2, 4, 0, 370, 480}}
+	};
+	struct yambler_counting_allocator counter;
+	yambler_counting_allocator_init(&counter, parent);
+	unsigned char *blocks[4] = {NULL, NULL, NULL, NULL};
+	int result = 0;
+	for(size_t i = 0; i < sizeof(steps) / sizeof(steps[0]) && !result; ++i){
+		unsigned char **block = &blocks[steps[i].block];
+		switch(steps[i].operation){
+		case ALLOCATOR_ALLOCATE:
+			*block = yambler_allocate(&counter.allocator, steps[i].size);
+			break;
+		case ALLOCATOR_REALLOCATE:
+			*block = yambler_reallocate(&counter.allocator, *block, steps[i].size);
+			break;
+		default:
+			yambler_release(&counter.allocator, *block);
+			*block = NULL;
+			break;
+		}
+		char step_what[64];
+		snprintf(step_what, sizeof(step_what), "%s, step %zu", what, i);
+		if(steps[i].operation != ALLOCATOR_RELEASE){
+			if(*block == NULL){
+				result = test_fail("%s: the allocation failed", step_what);
+				break;
+			}
+			if((uintptr_t)*block % ALLOCATOR_ALIGNMENT != 0){
+				result = test_fail("%s: the allocation is not aligned", step_what);
+				break;
+			}
+			memset(*block, (int)i, steps[i].size);
+		}
+		result = check_stats(&counter.stats, &steps[i].expected, step_what);
+	}
+	for(size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); ++i){
+		yambler_release(&counter.allocator, blocks[i]);
+	}
+	return result;
+}
+
+/*
+ * The counts of a counting allocator are those of the calls made through it, whatever it is layered on. A counter
+ * below another one sees the same calls, only its sizes include the header of the counter above.
+ */
+static int test_allocator_counts(){
+	int result = run_counts(NULL, "default parent");
+	struct yambler_counting_allocator below;
+	yambler_counting_allocator_init(&below, NULL);
+	result = result || run_counts(&below.allocator, "counting parent");
+	if(!result && (below.stats.allocations != 4 || below.stats.reallocations != 2 || below.stats.releases != 4 || below.stats.bytes_in_use != 0)){
+		result = test_fail("the parent counted %zu allocations, %zu reallocations and %zu releases, %zu bytes are in use", below.stats.allocations, below.stats.reallocations, below.stats.releases, below.stats.bytes_in_use);
+	}
+	return result;
+}
+
+/*
+ * An allocation or reallocation the parent fails is not counted, and a failed reallocation leaves the block as it was
+ */
+static int test_allocator_parent_failure(){
+	struct failing_allocator failing;
+	failing_allocator_init(&failing, 1);
+	struct yambler_counting_allocator counter;
+	yambler_counting_allocator_init(&counter, &failing.allocator);
+	struct yambler_allocator_stats expected = {1, 0, 0, 40, 40, 40};
+	char *block = yambler_allocate(&counter.allocator, 40);
+	if(block == NULL){
+		return test_fail("the first allocation failed");
+	}
+	memcpy(block, "0123456789", 10);
+	int result = check_stats(&counter.stats, &expected, "allocation");
+	if(!result && yambler_allocate(&counter.allocator, 10) != NULL){
+		result = test_fail("an allocation succeeded although the parent failed");
+	}
+	result = result || check_stats(&counter.stats, &expected, "failed allocation");
+	if(!result && yambler_reallocate(&counter.allocator, block, 400) != NULL){
+		result = test_fail("a reallocation succeeded although the parent failed");
+	}
+	result = result || check_stats(&counter.stats, &expected, "failed reallocation");
+	if(!result && yambler_reallocate(&counter.allocator, NULL, 10) != NULL){
+		result = test_fail("a reallocation of NULL succeeded although the parent failed");
+	}
+	result = result || check_stats(&counter.stats, &expected, "failed reallocation of NULL");
+	if(!result && memcmp(block, "0123456789", 10) != 0){
+		result = test_fail("a failed reallocation changed the block");
+	}
+	yambler_release(&counter.allocator, block);
+	expected.releases = 1;
+	expected.bytes_in_use = 0;
+	return result || check_stats(&counter.stats, &expected, "release");
+}
+
+/*
+ * Creates and opens a parser on an input buffer with the allocator and parses the data, then destroys them again
+ */
+static yambler_status parse_with(const struct yambler_allocator *allocator, const char *data){
+	struct yambler_input_buffer_policy policy = {16, 0, 0, 0};
+	yambler_input_buffer_p buffer = NULL;
+	yambler_status status = yambler_input_buffer_create_from_memory(&buffer, allocator, &policy, (const yambler_byte *)data, strlen(data), YAMBLER_ENCODING_UTF_8);
+	if(status){
+		return status;
+	}
+	yambler_parser_p parser = NULL;
+	status = yambler_parser_create(&parser, allocator);
+	if(status){
+		yambler_input_buffer_destroy(&buffer);
+		return status;
+	}
+	status = yambler_parser_open(parser, buffer);
+	struct yambler_parser_event event;
+	while(status == YAMBLER_OK){
+		status = yambler_parser_parse(parser, &event);
+	}
+	yambler_parser_destroy_all(&parser, &buffer, NULL);
+	return status;
+}
+
+/*
+ * Everything the objects allocate goes through the allocator they were created with and is released when they are
+ * destroyed, also when an allocation fails on the way: the parent fails after every number of allocations in turn
+ */
+static int test_allocator_objects(){
+	static const char data[] = "key: value\nlist:\n  - first item of the list\n  - {a: 1, b: [2, 3]}\n";
+	struct yambler_counting_allocator counter;
+	yambler_counting_allocator_init(&counter, NULL);
+	yambler_status status = parse_with(&counter.allocator, data);
+	if(status != YAMBLER_EMPTY){
+		return test_fail("parsing ended with '%s'", yambler_status_message(status));
+	}
+	if(counter.stats.allocations == 0){
+		return test_fail("the objects made no allocations through the allocator");
+	}
+	if(counter.stats.releases != counter.stats.allocations || counter.stats.bytes_in_use != 0){
+		return test_fail("%zu of %zu allocations are released, %zu bytes are in use", counter.stats.releases, counter.stats.allocations, counter.stats.bytes_in_use);
+	}
+	size_t calls = counter.stats.allocations + counter.stats.reallocations;
+	int result = 0;
+	for(size_t i = 0; i < calls && i < ALLOCATOR_MAX_FAILURES && !result; ++i){
+		struct failing_allocator failing;
+		failing_allocator_init(&failing, i);
+		yambler_counting_allocator_init(&counter, &failing.allocator);
+		status = parse_with(&counter.allocator, data);
+		if(status != YAMBLER_ALLOC_ERROR){
+			result = test_fail("a failure after %zu allocations ended with '%s'", i, yambler_status_message(status));
+		}else if(counter.stats.releases != counter.stats.allocations || counter.stats.bytes_in_use != 0){
+			result = test_fail("a failure after %zu allocations leaves %zu bytes of %zu allocations unreleased", i, counter.stats.bytes_in_use, counter.stats.allocations - counter.stats.releases);
+		}
+	}
+	return result;
+}
+
+void add_allocator_tests(){
+	add_test("allocator_counts", &test_allocator_counts);
+	add_test("allocator_parent_failure", &test_allocator_parent_failure);
+	add_test("allocator_objects", &test_allocator_objects);
+}
@@ -0,0 +1,132 @@
+#include "test.h"
+
+#include "yambler_arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE 1024
+#define ARENA_ALLOCATIONS 500
+#define ARENA_MAX_SIZE 3000
+
+struct arena_align_probe{
+	char c;
+	union{
+		long double float_value;
+		long long int_value;
+		void *pointer;
+	} value;
+};
+
+#define ARENA_ALIGNMENT offsetof(struct arena_align_probe, value)
+
+struct arena_allocation{
+	unsigned char *data;
+	size_t size;
+};
+
+/*
+ * Allocates a mix of small sizes, empty ones and sizes past the block size, filling each allocation with a pattern
+ * of its own, and checks that they are aligned and that none of them overwrote another
+ */
+static int run_allocations(yambler_arena_p arena, struct arena_allocation *allocations, size_t count){
+	for(size_t i = 0; i < count; ++i){
+		uint32_t kind = test_random(10);
+		size_t size = kind == 0 ? 0 : kind == 1 ? ARENA_BLOCK_SIZE + test_random(ARENA_MAX_SIZE) : test_random(200);
+		unsigned char *data = yambler_arena_alloc(arena, size);
+		if(data == NULL){
+			return test_fail("allocation %zu of %zu bytes failed", i, size);
+		}
+		if((uintptr_t)data % ARENA_ALIGNMENT != 0){
+			return test_fail("allocation %zu is not aligned", i);
+		}
+		memset(data, (int)(i & 0xFF), size);
+		allocations[i].data = data;
+		allocations[i].size = size;
+	}
+	for(size_t i = 0; i < count; ++i){
+		for(size_t j = 0; j < allocations[i].size; ++j){
+			if(allocations[i].data[j] != (unsigned char)(i & 0xFF)){
+				return test_fail("allocation %zu was overwritten", i);
+			}
+		}
+		if(i != 0 && allocations[i].data == allocations[i - 1].data){
+			return test_fail("allocations %zu and %zu share an address", i - 1, i);
+		}
+	}
+	return 0;
+}
+
+static int test_arena_alloc(){
+	yambler_arena_p arena;
+	if(yambler_arena_create(&arena, NULL, ARENA_BLOCK_SIZE)){
+		return test_fail("unable to create arena");
+	}
+	static struct arena_allocation allocations[ARENA_ALLOCATIONS];
+	int result = run_allocations(arena, allocations, ARENA_ALLOCATIONS);
+	yambler_arena_destroy(&arena);
+	return result;
+}
+
+static int test_arena_resize(){
+	yambler_arena_p arena;
+	if(yambler_arena_create(&arena, NULL, ARENA_BLOCK_SIZE)){
+		return test_fail("unable to create arena");
+	}
+	int result = 0;
+	char *first = yambler_arena_alloc(arena, 16);
+	memcpy(first, "0123456789abcdef", 16);
+	char *grown = yambler_arena_resize(arena, first, 16, 400);
+	if(grown != first){
+		result = test_fail("the last allocation was not grown in place");
+	}
+	char *second = yambler_arena_alloc(arena, 8);
+	memcpy(second, "second", 7);
+	char *moved = result ? NULL : yambler_arena_resize(arena, first, 400, 500);
+	if(!result && (moved == first || memcmp(moved, "0123456789abcdef", 16) != 0)){
+		result = test_fail("an allocation that is not the last was not copied");
+	}
+	char *large = result ? NULL : yambler_arena_resize(arena, moved, 500, 4 * ARENA_BLOCK_SIZE);
+	if(!result && (large == NULL || memcmp(large, "0123456789abcdef", 16) != 0)){
+		result = test_fail("growing past the block size lost the contents");
+	}
+	if(!result && strcmp(second, "second") != 0){
+		result = test_fail("resizing overwrote another allocation");
+	}
+	yambler_arena_destroy(&arena);
+	return result;
+}
+
+static int test_arena_reset(){
+	/* after a reset the same allocations reuse the blocks instead of allocating again */
+	struct yambler_counting_allocator counter;
+	yambler_counting_allocator_init(&counter, NULL);
+	yambler_arena_p arena;
+	if(yambler_arena_create(&arena, &counter.allocator, ARENA_BLOCK_SIZE)){
+		return test_fail("unable to create arena");
+	}
+	static struct arena_allocation allocations[ARENA_ALLOCATIONS];
+	int result = 0;
+	size_t allocation_count = 0;
+	for(int round = 0; round < 3 && !result; ++round){
+		test_seed(7);
+		result = run_allocations(arena, allocations, ARENA_ALLOCATIONS);
+		if(!result && round != 0 && counter.stats.allocations != allocation_count){
+			result = test_fail("round %d allocated %zu blocks after a reset", round, counter.stats.allocations - allocation_count);
+		}
+		allocation_count = counter.stats.allocations;
+		yambler_arena_reset(arena);
+	}
+	yambler_arena_destroy(&arena);
+	if(!result && counter.stats.bytes_in_use != 0){
+		result = test_fail("%zu bytes were not released", counter.stats.bytes_in_use);
+	}
+	return result;
+}
+
+void add_arena_tests(){
+	add_test("arena_alloc", &test_arena_alloc);
+	add_test("arena_resize", &test_arena_resize);
+	add_test("arena_reset", &test_arena_reset);
+}
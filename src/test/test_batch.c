@@ -0,0 +1,190 @@
+#include "test.h"
+
+#include "yambler_allocator.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Batches hold the values of all their events at once, so the input buffer retires the blocks they point into
+ * when it refills, and reuses them as spares once the batch is given up. The transcripts of batches have to match
+ * those of events parsed one at a time, which the small buffers make refill in the middle of most batches.
+ */
+
+#define BATCH_ROUNDS 40
+#define BATCH_MAX_ENTRIES 40
+#define BATCH_DOCUMENTS 6
+
+static const struct test_parse_options batch_reference = {1024, 0, 0, 1, NULL};
+
+static const struct test_parse_options batch_configurations[] = {
+	{5, 1, 0, 1, NULL},
+	{5, 64, 1, 1, NULL},
+	{13, 7, 0, 1, NULL},
+	{16, 64, 0, 1, NULL},
+	{64, 3, 1, 1, NULL}
+};
+
+#define BATCH_CONFIGURATION_COUNT (sizeof(batch_configurations) / sizeof(batch_configurations[0]))
+
+static const char *batch_words[] = {"a", "value", "x y", "-1", "http://h/p", "\xC3\xA9t\xC3\xA9", "\xE4\xB8\xAD\xE6\x96\x87"};
+
+#define BATCH_WORD_COUNT (sizeof(batch_words) / sizeof(batch_words[0]))
+
+static int append_comment(struct test_text *text){
+	int result = test_text_append_string(text, "#");
+	size_t length = test_random(60);
+	for(size_t i = 0; i < length && !result; ++i){
+		result = test_text_append_string(text, batch_words[test_random(BATCH_WORD_COUNT)]);
+	}
+	return result ? result : test_text_append(text, "\n", 1);
+}
+
+/*
+ * A mapping of scalars and short sequences, with comments of their own lines and after the values
+ */
+static int generate_document(struct test_text *text){
+	char key[32];
+	size_t count = 1 + test_random(BATCH_MAX_ENTRIES);
+	int result = test_text_append_string(text, "---\n");
+	for(size_t i = 0; i < count && !result; ++i){
+		snprintf(key, sizeof(key), "k%zu:", i);
+		switch(test_random(4)){
+		case 0:
+			result = append_comment(text);
+			break;
+		case 1:
+			result = test_text_append_string(text, key);
+			for(uint32_t j = test_random(3) + 1; j > 0 && !result; --j){
+				result = test_text_append_string(text, "\n  - ");
+				if(!result){
+					result = test_text_append_string(text, batch_words[test_random(BATCH_WORD_COUNT)]);
+				}
+			}
+			if(!result){
+				result = test_text_append(text, "\n", 1);
+			}
+			continue;
+		default:
+			break;
+		}
+		if(!result){
+			result = test_text_append_string(text, key);
+		}
+		if(!result){
+			result = test_text_append(text, " ", 1);
+		}
+		if(!result){
+			result = test_text_append_string(text, batch_words[test_random(BATCH_WORD_COUNT)]);
+		}
+		if(!result){
+			result = test_random(2) ? test_text_append_string(text, " ") : test_text_append(text, "\n", 1);
+		}
+		if(!result && text->data[text->length - 1] == ' '){
+			result = append_comment(text);
+		}
+	}
+	return result;
+}
+
+static int compare_parse(const struct test_text *input, const struct test_parse_options *options, const struct test_text *expected, const char *what){
+	struct test_text transcript = {NULL, 0, 0};
+	yambler_status status = test_parse(input->data, input->length, options, &transcript, NULL);
+	int result = 0;
+	if(status != YAMBLER_EMPTY){
+		result = test_fail("%s: parsing ended with '%s'", what, yambler_status_message(status));
+	}else if(transcript.length != expected->length || memcmp(transcript.data, expected->data, expected->length) != 0){
+		result = test_fail("%s: the transcript differs from the one of single events", what);
+	}
+	test_text_free(&transcript);
+	return result;
+}
+
+static int test_batch_transcripts(){
+	int result = 0;
+	for(int round = 0; round < BATCH_ROUNDS && !result; ++round){
+		struct test_text input = {NULL, 0, 0};
+		struct test_text expected = {NULL, 0, 0};
+		result = generate_document(&input);
+		if(!result && test_parse(input.data, input.length, &batch_reference, &expected, NULL) != YAMBLER_EMPTY){
+			result = test_fail("round %d: the document was not parsed", round);
+		}
+		for(size_t i = 0; i < BATCH_CONFIGURATION_COUNT && !result; ++i){
+			char what[64];
+			snprintf(what, sizeof(what), "round %d, configuration %zu", round, i);
+			result = compare_parse(&input, &batch_configurations[i], &expected, what);
+		}
+		test_text_free(&input);
+		test_text_free(&expected);
+	}
+	return result;
+}
+
+/*
+ * Parses a stream of copies of one document in batches of capacity events, returning the allocations it took and
+ * the blocks retired
+ */
+static int parse_copies(const struct test_text *document, size_t copies, size_t capacity, size_t *allocations, size_t *retire_count){
+	struct test_text input = {NULL, 0, 0};
+	int result = 0;
+	for(size_t i = 0; i < copies && !result; ++i){
+		result = test_text_append(&input, document->data, document->length);
+	}
+	struct yambler_counting_allocator counter;
+	yambler_counting_allocator_init(&counter, NULL);
+	struct test_parse_options options = {16, capacity, 0, 1, &counter.allocator};
+	struct test_text transcript = {NULL, 0, 0};
+	struct yambler_input_buffer_stats stats;
+	if(!result && test_parse(input.data, input.length, &options, &transcript, &stats) != YAMBLER_EMPTY){
+		result = test_fail("a stream of %zu documents was not parsed", copies);
+	}
+	if(!result && counter.stats.bytes_in_use != 0){
+		result = test_fail("%zu bytes were not released", counter.stats.bytes_in_use);
+	}
+	*allocations = counter.stats.allocations;
+	*retire_count = stats.retire_count;
+	test_text_free(&transcript);
+	test_text_free(&input);
+	return result;
+}
+
+static int test_batch_spares(){
+	/*
+	 * A batch holds the events of a document, so every batch after the first few retires the same blocks, which
+	 * the previous batch left as spares, and parsing more copies allocates no more
+	 */
+	int result = 0;
+	for(int round = 0; round < BATCH_ROUNDS / 4 && !result; ++round){
+		struct test_text document = {NULL, 0, 0};
+		struct test_text transcript = {NULL, 0, 0};
+		result = generate_document(&document);
+		if(!result && test_parse(document.data, document.length, &batch_reference, &transcript, NULL) != YAMBLER_EMPTY){
+			result = test_fail("round %d: the document was not parsed", round);
+		}
+		size_t capacity = 0;
+		for(size_t i = 0; i < transcript.length; ++i){
+			capacity += transcript.data[i] == '\n';
+		}
+		size_t allocations, more_allocations, retire_count, more_retire_count;
+		if(!result){
+			result = parse_copies(&document, BATCH_DOCUMENTS, capacity, &allocations, &retire_count);
+		}
+		if(!result){
+			result = parse_copies(&document, 2 * BATCH_DOCUMENTS, capacity, &more_allocations, &more_retire_count);
+		}
+		if(!result && more_retire_count <= retire_count){
+			result = test_fail("round %d: no blocks were retired in the later documents", round);
+		}
+		if(!result && more_allocations != allocations){
+			result = test_fail("round %d: %d documents allocated %zu times, %d documents %zu times", round, BATCH_DOCUMENTS, allocations, 2 * BATCH_DOCUMENTS, more_allocations);
+		}
+		test_text_free(&transcript);
+		test_text_free(&document);
+	}
+	return result;
+}
+
+void add_batch_tests(){
+	add_test("batch_transcripts", &test_batch_transcripts);
+	add_test("batch_spares", &test_batch_spares);
+}
@@ -0,0 +1,308 @@
+#include "test.h"
+
+#include "yambler_codec.h"
+#include "yambler_decoder.h"
+#include "yambler_utility.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The native codecs are checked against iconv. Input is decoded through a decoder with a small buffer, whose reads
+ * return a few bytes at a time, so that characters are split across refills. Valid input has to decode to the
+ * characters iconv produces, and input iconv rejects has to end in YAMBLER_ENCODING_ERROR after a prefix of them.
+ */
+
+#define CODEC_ROUNDS 400
+#define CODEC_MAX_CHARS 300
+
+/* a call with less room than the next character decodes none, UTF-8 characters take up to 4 */
+#ifdef YAMBLER_UTF8_CHARS
+#define CODEC_MIN_ROOM 4
+#else
+#define CODEC_MIN_ROOM 1
+#endif
+
+struct codec_source{
+	const char *data;
+	size_t length;
+	size_t position;
+	size_t chunk;
+};
+
+static yambler_status read_chunk(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count){
+	struct codec_source *source = (struct codec_source *)state;
+	size_t count = 1 + test_random((uint32_t)source->chunk);
+	if(count > buffer_size){
+		count = buffer_size;
+	}
+	if(count > source->length - source->position){
+		count = source->length - source->position;
+	}
+	memcpy(buffer, source->data + source->position, count);
+	source->position += count;
+	*read_count = count;
+	return YAMBLER_OK;
+}
+
+/*
+ * Decodes data with a decoder of buffer_size bytes into calls of a few characters, appending the characters to dest
+ */
+static yambler_status decode_chunks(const char *data, size_t length, enum yambler_encoding encoding, size_t buffer_size, size_t chunk, struct test_text *dest){
+	struct codec_source source = {data, length, 0, chunk};
+	yambler_decoder_p decoder;
+	yambler_status status = yambler_decoder_create(&decoder, NULL, buffer_size, encoding, &read_chunk, &source, NULL, NULL);
+	if(status){
+		return status;
+	}
+	status = yambler_decoder_open(decoder);
+	yambler_char buffer[8];
+	size_t count = 1;
+	while(status == YAMBLER_OK && count != 0){
+		size_t room = CODEC_MIN_ROOM + test_random(sizeof(buffer) / sizeof(buffer[0]) + 1 - CODEC_MIN_ROOM);
+		status = yambler_decoder_decode(decoder, buffer, room, &count);
+		if(status == YAMBLER_OK && test_text_append(dest, (const char *)buffer, count * sizeof(yambler_char))){
+			status = YAMBLER_ALLOC_ERROR;
+		}
+	}
+	yambler_decoder_close(decoder);
+	yambler_decoder_destroy(&decoder);
+	return status;
+}
+
+/*
+ * Converts the UTF-32LE output of iconv to native characters, iconv's conversion to UTF-8 lets values past U+10FFFF
+ * through
+ */
+static int append_native(struct test_text *text, const struct test_text *code_points){
+	int result = test_text_append(text, "", 0);
+	for(size_t i = 0; i + 4 <= code_points->length && !result; i += 4){
+		const unsigned char *units = (const unsigned char *)code_points->data + i;
+		yambler_code_point c = units[0] | ((yambler_code_point)units[1] << 8) | ((yambler_code_point)units[2] << 16) | ((yambler_code_point)units[3] << 24);
+		result = test_text_append_native(text, c);
+	}
+	return result;
+}
+
+/*
+ * Decodes data in several configurations and compares the characters with those of iconv, what tells whether
+ * iconv took the input
+ */
+static int compare_decode(const char *data, size_t length, enum yambler_encoding encoding, const char *what){
+	struct test_text code_points = {NULL, 0, 0};
+	struct test_text expected = {NULL, 0, 0};
+	int rejected = test_iconv("UTF-32LE", yambler_encoding_name(encoding), data, length, &code_points);
+	int result = append_native(&expected, &code_points);
+	test_text_free(&code_points);
+	static const size_t configurations[][2] = {{4, 1}, {5, 3}, {7, 7}, {64, 13}, {4096, 4096}};
+	for(size_t i = 0; i < sizeof(configurations) / sizeof(configurations[0]) && !result; ++i){
+		struct test_text decoded = {NULL, 0, 0};
+		yambler_status status = decode_chunks(data, length, encoding, configurations[i][0], configurations[i][1], &decoded);
+		if(rejected && status != YAMBLER_ENCODING_ERROR){
+			result = test_fail("%s, buffer %zu: iconv rejects the input, the decoder ended with '%s'", what, configurations[i][0], yambler_status_message(status));
+		}else if(!rejected && status != YAMBLER_OK){
+			result = test_fail("%s, buffer %zu: decoding ended with '%s'", what, configurations[i][0], yambler_status_message(status));
+		}else if(!rejected && (decoded.length != expected.length || memcmp(decoded.data, expected.data, expected.length) != 0)){
+			result = test_fail("%s, buffer %zu: the characters differ from those of iconv", what, configurations[i][0]);
+		}else if(rejected && (decoded.length > expected.length || (decoded.length && memcmp(decoded.data, expected.data, decoded.length) != 0))){
+			result = test_fail("%s, buffer %zu: the characters before the error differ from those of iconv", what, configurations[i][0]);
+		}
+		test_text_free(&decoded);
+	}
+	test_text_free(&expected);
+	return result;
+}
+
+static int test_codec_utf8(){
+	int result = 0;
+	for(int round = 0; round < CODEC_ROUNDS && !result; ++round){
+		yambler_code_point code_points[CODEC_MAX_CHARS];
+		size_t count;
+		struct test_text text = {NULL, 0, 0};
+		test_random_code_points(code_points, CODEC_MAX_CHARS, &count);
+		result = test_text_append(&text, "", 0);
+		for(size_t i = 0; i < count && !result; ++i){
+			result = test_text_append_encoded(&text, code_points[i], YAMBLER_ENCODING_UTF_8);
+		}
+		char what[64];
+		snprintf(what, sizeof(what), "round %d", round);
+		if(!result){
+			result = compare_decode(text.data, text.length, YAMBLER_ENCODING_UTF_8, what);
+		}
+		test_text_free(&text);
+	}
+	return result;
+}
+
+/*
+ * Overlong forms, surrogates, values past U+10FFFF, stray and missing continuation bytes and sequences cut off by
+ * the end of the input, each put into valid text at a random position
+ */
+static const char *invalid_utf8[] = {
+	"\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF", "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF",
+	"\xED\xA0\x80", "\xED\xAF\xBF", "\xED\xB0\x80", "\xED\xBF\xBF",
+	"\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF7\xBF\xBF\xBF", "\xF8\x88\x80\x80\x80", "\xFE", "\xFF",
+	"\x80", "\xBF", "\xC3", "\xC3\x41", "\xE2\x82", "\xE2\x82\x41", "\xF0\x9F\x98", "\xF0\x9F\x41\x80"
+};
+
+static int test_codec_utf8_invalid(){
+	int result = 0;
+	for(size_t i = 0; i < sizeof(invalid_utf8) / sizeof(invalid_utf8[0]) && !result; ++i){
+		for(int round = 0; round < CODEC_ROUNDS / 10 && !result; ++round){
+			yambler_code_point code_points[CODEC_MAX_CHARS];
+			size_t count;
+			struct test_text text = {NULL, 0, 0};
+			test_random_code_points(code_points, CODEC_MAX_CHARS, &count);
+			/* the last rounds end in the sequence, so that a truncated one is cut off by the end of the input */
+			size_t position = round % 4 == 0 ? count : test_random((uint32_t)count + 1);
+			for(size_t j = 0; j <= count && !result; ++j){
+				if(j == position){
+					result = test_text_append_string(&text, invalid_utf8[i]);
+				}
+				if(!result && j < count){
+					result = test_text_append_encoded(&text, code_points[j], YAMBLER_ENCODING_UTF_8);
+				}
+			}
+			char what[64];
+			snprintf(what, sizeof(what), "sequence %zu, round %d", i, round);
+			if(!result){
+				result = compare_decode(text.data, text.length, YAMBLER_ENCODING_UTF_8, what);
+			}
+			test_text_free(&text);
+		}
+	}
+	return result;
+}
+
+static const enum yambler_encoding wide_encodings[] = {YAMBLER_ENCODING_UTF_16LE, YAMBLER_ENCODING_UTF_16BE, YAMBLER_ENCODING_UTF_32LE, YAMBLER_ENCODING_UTF_32BE};
+
+#define WIDE_ENCODING_COUNT (sizeof(wide_encodings) / sizeof(wide_encodings[0]))
+
+static int test_codec_wide(){
+	/* the reads of a byte or a few split code units and surrogate pairs across refills */
+	int result = 0;
+	for(size_t i = 0; i < WIDE_ENCODING_COUNT && !result; ++i){
+		for(int round = 0; round < CODEC_ROUNDS / 4 && !result; ++round){
+			yambler_code_point code_points[CODEC_MAX_CHARS];
+			size_t count;
+			struct test_text text = {NULL, 0, 0};
+			test_random_code_points(code_points, CODEC_MAX_CHARS, &count);
+			result = test_text_append(&text, "", 0);
+			for(size_t j = 0; j < count && !result; ++j){
+				result = test_text_append_encoded(&text, code_points[j], wide_encodings[i]);
+			}
+			char what[64];
+			snprintf(what, sizeof(what), "%s, round %d", yambler_encoding_name(wide_encodings[i]), round);
+			if(!result){
+				result = compare_decode(text.data, text.length, wide_encodings[i], what);
+			}
+			test_text_free(&text);
+		}
+	}
+	return result;
+}
+
+/*
+ * Code units that are no character: lone high surrogates, which are cut off by the end of the input in the rounds
+ * that end in them, lone low ones, also before another low one, a high one before one that is not low, and in UTF-32
+ * surrogates and values past U+10FFFF. Zero ends a list.
+ */
+static const uint32_t invalid_utf16[][3] = {{0xD800, 0}, {0xDBFF, 0}, {0xDC00, 0}, {0xDFFF, 0}, {0xD83D, 0x0041, 0}, {0xD83D, 0xD83D, 0}, {0xDE00, 0xD83D, 0}, {0xDC00, 0xDC00, 0}};
+
+static const uint32_t invalid_utf32[][2] = {{0xD800, 0}, {0xDFFF, 0}, {0x110000, 0}, {0xFFFFFFFF, 0}};
+
+static int insert_invalid(enum yambler_encoding encoding, const uint32_t *units, size_t unit_size, int odd_byte, int round){
+	yambler_code_point code_points[CODEC_MAX_CHARS];
+	size_t count;
+	struct test_text text = {NULL, 0, 0};
+	test_random_code_points(code_points, CODEC_MAX_CHARS, &count);
+	int big_endian = encoding == YAMBLER_ENCODING_UTF_16BE || encoding == YAMBLER_ENCODING_UTF_32BE;
+	size_t position = round % 4 == 0 ? count : test_random((uint32_t)count + 1);
+	int result = test_text_append(&text, "", 0);
+	for(size_t j = 0; j <= count && !result; ++j){
+		if(j == position){
+			for(size_t k = 0; units[k] != 0 && !result; ++k){
+				result = test_text_append_unit(&text, units[k], unit_size, big_endian);
+			}
+			if(odd_byte && !result){
+				result = test_text_append(&text, "A", 1);
+			}
+		}
+		if(!result && j < count){
+			result = test_text_append_encoded(&text, code_points[j], encoding);
+		}
+	}
+	char what[64];
+	snprintf(what, sizeof(what), "%s, %s%04x, round %d", yambler_encoding_name(encoding), odd_byte ? "odd byte after " : "", (unsigned)units[0], round);
+	if(!result){
+		result = compare_decode(text.data, text.length, encoding, what);
+	}
+	test_text_free(&text);
+	return result;
+}
+
+static int test_codec_wide_invalid(){
+	static const uint32_t none[] = {0};
+	int result = 0;
+	for(int round = 0; round < CODEC_ROUNDS / 20 && !result; ++round){
+		for(size_t i = 0; i < 2 && !result; ++i){
+			for(size_t j = 0; j < sizeof(invalid_utf16) / sizeof(invalid_utf16[0]) && !result; ++j){
+				result = insert_invalid(wide_encodings[i], invalid_utf16[j], 2, 0, round);
+			}
+			/* a byte short of a code unit at the end of the input */
+			if(!result){
+				result = insert_invalid(wide_encodings[i], none, 2, round % 4 == 0, 0);
+			}
+		}
+		for(size_t i = 2; i < WIDE_ENCODING_COUNT && !result; ++i){
+			for(size_t j = 0; j < sizeof(invalid_utf32) / sizeof(invalid_utf32[0]) && !result; ++j){
+				result = insert_invalid(wide_encodings[i], invalid_utf32[j], 4, 0, round);
+			}
+		}
+	}
+	return result;
+}
+
+/*
+ * The codec itself leaves the high half of a pair for the next call and rejects lone halves
+ */
+static int test_codec_surrogates(){
+	static const struct{
+		const char *data;
+		size_t length;
+		enum yambler_codec_result result;
+		size_t consumed;
+		size_t produced;
+	} cases[] = {
+		{"\x3D\xD8", 2, YAMBLER_CODEC_INCOMPLETE, 0, 0},
+		{"\x3D\xD8\x00", 3, YAMBLER_CODEC_INCOMPLETE, 0, 0},
+		{"A\x00\x3D\xD8", 4, YAMBLER_CODEC_INCOMPLETE, 2, 1},
+		{"\x3D\xD8\x00\xDE", 4, YAMBLER_CODEC_OK, 4, 1},
+		{"\x00\xDE", 2, YAMBLER_CODEC_INVALID, 0, 0},
+		{"\x00\xDC\x00\xDC", 4, YAMBLER_CODEC_INVALID, 0, 0},
+		{"\x3D\xD8\x41\x00", 4, YAMBLER_CODEC_INVALID, 0, 0},
+		{"A\x00B", 3, YAMBLER_CODEC_INCOMPLETE, 2, 1}
+	};
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i){
+		yambler_char buffer[8];
+		const yambler_byte *in = cases[i].data;
+		size_t in_remainder = cases[i].length;
+		yambler_char *out = buffer;
+		size_t out_remainder = sizeof(buffer) / sizeof(buffer[0]);
+		enum yambler_codec_result result = yambler_codec_decode_utf16le(&in, &in_remainder, &out, &out_remainder);
+		size_t consumed = cases[i].length - in_remainder;
+		size_t produced = out == buffer ? 0 : 1;
+		if(result != cases[i].result || consumed != cases[i].consumed || produced != cases[i].produced){
+			return test_fail("case %zu: result %d after %zu bytes instead of %d after %zu", i, (int)result, consumed, (int)cases[i].result, cases[i].consumed);
+		}
+	}
+	return 0;
+}
+
+void add_codec_tests(){
+	add_test("codec_utf8", &test_codec_utf8);
+	add_test("codec_utf8_invalid", &test_codec_utf8_invalid);
+	add_test("codec_wide", &test_codec_wide);
+	add_test("codec_wide_invalid", &test_codec_wide_invalid);
+	add_test("codec_surrogates", &test_codec_surrogates);
+}
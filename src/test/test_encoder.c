@@ -0,0 +1,348 @@
+#include "test.h"
+
+#include "yambler_decoder.h"
+#include "yambler_encoder.h"
+#include "yambler_utility.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+/*
+ * The native encoders are checked against iconv. Characters are handed to an encoder with a small buffer a few at a
+ * time, in the UTF-8 build also in the middle of a character, and the bytes written have to be those iconv produces
+ * from the same code points, after the byte order mark when one is asked for.
+ */
+
+#define ENCODER_ROUNDS 100
+#define ENCODER_MAX_CHARS 300
+
+/* characters enough to grow the mapping of a file, which starts at 1 MB */
+#define ENCODER_LARGE_CHARS (1200 * 1024)
+
+static const enum yambler_encoding encodings[] = {YAMBLER_ENCODING_UTF_8, YAMBLER_ENCODING_UTF_16LE, YAMBLER_ENCODING_UTF_16BE, YAMBLER_ENCODING_UTF_32LE, YAMBLER_ENCODING_UTF_32BE};
+
+#define ENCODING_COUNT (sizeof(encodings) / sizeof(encodings[0]))
+
+static const struct{
+	const char *data;
+	size_t length;
+} boms[] = {{"\xEF\xBB\xBF", 3}, {"\xFF\xFE", 2}, {"\xFE\xFF", 2}, {"\xFF\xFE\x00\x00", 4}, {"\x00\x00\xFE\xFF", 4}};
+
+static const size_t buffer_sizes[] = {4, 5, 7, 64, 4096};
+
+#define BUFFER_SIZE_COUNT (sizeof(buffer_sizes) / sizeof(buffer_sizes[0]))
+
+static yambler_status write_text(yambler_encoder_state state, const yambler_byte *data, size_t length, size_t *write_count){
+	if(test_text_append((struct test_text *)state, (const char *)data, length)){
+		return YAMBLER_ALLOC_ERROR;
+	}
+	*write_count = length;
+	return YAMBLER_OK;
+}
+
+static yambler_status writev_text(yambler_encoder_state state, const struct iovec *vectors, int count, size_t *write_count){
+	*write_count = 0;
+	for(int i = 0; i < count; ++i){
+		if(test_text_append((struct test_text *)state, (const char *)vectors[i].iov_base, vectors[i].iov_len)){
+			return YAMBLER_ALLOC_ERROR;
+		}
+		*write_count += vectors[i].iov_len;
+	}
+	return YAMBLER_OK;
+}
+
+/*
+ * The targets an encoder writes to: a write callback, the default, a vectored write of several blocks, a mapped
+ * file, and spans of the caller
+ */
+enum encoder_target{
+	ENCODER_TARGET_CALLBACK,
+	ENCODER_TARGET_VECTORED,
+	ENCODER_TARGET_MAPPED,
+	ENCODER_TARGET_SPAN,
+	ENCODER_TARGET_COUNT
+};
+
+static const char *const target_names[] = {"callback", "vectored", "mapped", "span"};
+
+static yambler_status create_encoder(yambler_encoder_p *encoder, enum encoder_target target, enum yambler_encoding encoding, size_t buffer_size, yambler_encoder_flag options, const char *path, struct test_text *dest){
+	switch(target){
+	case ENCODER_TARGET_VECTORED:
+		return yambler_encoder_create_vectored(encoder, NULL, buffer_size, 3, encoding, options, &writev_text, dest, NULL, NULL);
+	case ENCODER_TARGET_MAPPED:
+		return yambler_encoder_create_to_file(encoder, NULL, path, encoding, options);
+	default:
+		return yambler_encoder_create(encoder, NULL, buffer_size, encoding, options, &write_text, dest, NULL, NULL);
+	}
+}
+
+/*
+ * Hands a few characters to the encoder, or encodes them into a span of a few bytes that is appended to dest.
+ * Fewer characters are taken when the last of them is cut off, and none while the span fills with buffered bytes.
+ */
+static yambler_status encode_some(yambler_encoder_p encoder, enum encoder_target target, const yambler_char *chars, size_t count, size_t *read_count, int *progress, struct test_text *dest){
+	if(target != ENCODER_TARGET_SPAN){
+		yambler_status status = yambler_encoder_encode(encoder, chars, count, read_count);
+		*progress = *read_count != 0;
+		return status;
+	}
+	/* a span of four bytes takes any character */
+	yambler_byte span[20];
+	size_t write_count;
+	yambler_status status = yambler_encoder_encode_span(encoder, chars, count, read_count, span, 4 + test_random(sizeof(span) - 3), &write_count);
+	if(status == YAMBLER_OK && test_text_append(dest, (const char *)span, write_count)){
+		status = YAMBLER_ALLOC_ERROR;
+	}
+	*progress = *read_count != 0 || write_count != 0;
+	return status;
+}
+
+static int read_file(const char *path, struct test_text *dest){
+	FILE *file = fopen(path, "rb");
+	if(file == NULL){
+		return 1;
+	}
+	int result = test_text_append(dest, "", 0);
+	while(!result){
+		char buffer[4096];
+		size_t count = fread(buffer, 1, sizeof(buffer), file);
+		if(count == 0){
+			result = ferror(file);
+			break;
+		}
+		result = test_text_append(dest, buffer, count);
+	}
+	fclose(file);
+	return result;
+}
+
+/*
+ * Encodes the characters in calls of a few at a time, handing a character that was cut off to the next call
+ */
+static yambler_status encode_chunks(enum encoder_target target, const yambler_char *chars, size_t length, enum yambler_encoding encoding, size_t buffer_size, yambler_encoder_flag options, struct test_text *dest){
+	char path[] = "/tmp/yambler_test_XXXXXX";
+	if(target == ENCODER_TARGET_MAPPED){
+		int fd = mkstemp(path);
+		if(fd == -1){
+			return YAMBLER_ERROR;
+		}
+		close(fd);
+	}
+	yambler_encoder_p encoder;
+	yambler_status status = create_encoder(&encoder, target, encoding, buffer_size, options, path, dest);
+	if(status){
+		if(target == ENCODER_TARGET_MAPPED){
+			unlink(path);
+		}
+		return status;
+	}
+	status = yambler_encoder_open(encoder);
+	size_t position = 0;
+	while(status == YAMBLER_OK && position < length){
+		size_t count = 1 + test_random(9);
+		if(count > length - position){
+			count = length - position;
+		}
+		size_t read_count;
+		int progress;
+		status = encode_some(encoder, target, chars + position, count, &read_count, &progress, dest);
+		if(status == YAMBLER_OK && !progress && position + count == length){
+			/* the characters end in the middle of one */
+			status = YAMBLER_ENCODING_ERROR;
+		}
+		position += status == YAMBLER_OK ? read_count : 0;
+	}
+	if(status == YAMBLER_OK || status == YAMBLER_ENCODING_ERROR){
+		yambler_status flushed = yambler_encoder_flush(encoder);
+		status = status ? status : flushed;
+	}
+	yambler_encoder_close(encoder);
+	yambler_encoder_destroy(&encoder);
+	if(target == ENCODER_TARGET_MAPPED){
+		if(read_file(path, dest) && status == YAMBLER_OK){
+			status = YAMBLER_ERROR;
+		}
+		unlink(path);
+	}
+	return status;
+}
+
+/*
+ * The bytes iconv encodes the code points to, after the byte order mark when bom is set
+ */
+static int expect_bytes(const yambler_code_point *code_points, size_t count, size_t encoding_index, int bom, struct test_text *dest){
+	struct test_text utf32 = {NULL, 0, 0};
+	int result = test_text_append(&utf32, "", 0) || test_text_append(dest, "", 0);
+	for(size_t i = 0; i < count && !result; ++i){
+		result = test_text_append_encoded(&utf32, code_points[i], YAMBLER_ENCODING_UTF_32LE);
+	}
+	if(bom && !result){
+		result = test_text_append(dest, boms[encoding_index].data, boms[encoding_index].length);
+	}
+	if(!result && test_iconv(yambler_encoding_name(encodings[encoding_index]), "UTF-32LE", utf32.data, utf32.length, dest)){
+		result = test_fail("iconv rejects the code points");
+	}
+	test_text_free(&utf32);
+	return result;
+}
+
+static int append_chars(struct test_text *chars, const yambler_code_point *code_points, size_t count){
+	int result = test_text_append(chars, "", 0);
+	for(size_t i = 0; i < count && !result; ++i){
+		result = test_text_append_native(chars, code_points[i]);
+	}
+	return result;
+}
+
+/*
+ * Decodes the encoded bytes after the byte order mark, which have to give back the characters
+ */
+static int decode_back(const struct test_text *encoded, size_t bom_length, enum yambler_encoding encoding, const struct test_text *chars, const char *what){
+	yambler_decoder_p decoder;
+	if(yambler_decoder_create_from_memory(&decoder, NULL, (const yambler_byte *)encoded->data + bom_length, encoded->length - bom_length, encoding) || yambler_decoder_open(decoder)){
+		return test_fail("%s: unable to open a decoder", what);
+	}
+	struct test_text decoded = {NULL, 0, 0};
+	int result = test_text_append(&decoded, "", 0);
+	yambler_status status = YAMBLER_OK;
+	while(!result){
+		yambler_char buffer[64];
+		size_t count;
+		status = yambler_decoder_decode(decoder, buffer, sizeof(buffer) / sizeof(buffer[0]), &count);
+		if(status || count == 0){
+			break;
+		}
+		result = test_text_append(&decoded, (const char *)buffer, sizeof(yambler_char) * count);
+	}
+	if(!result && (status || decoded.length != chars->length || memcmp(decoded.data, chars->data, chars->length) != 0)){
+		result = test_fail("%s: decoding the output does not give back the characters", what);
+	}
+	test_text_free(&decoded);
+	yambler_decoder_close(decoder);
+	yambler_decoder_destroy(&decoder);
+	return result;
+}
+
+static int test_encoder_round_trip(){
+	int result = 0;
+	for(size_t i = 0; i < ENCODING_COUNT && !result; ++i){
+		for(int round = 0; round < ENCODER_ROUNDS && !result; ++round){
+			yambler_code_point code_points[ENCODER_MAX_CHARS];
+			size_t count;
+			test_random_code_points(code_points, ENCODER_MAX_CHARS, &count);
+			int bom = round % 2;
+			struct test_text chars = {NULL, 0, 0};
+			struct test_text expected = {NULL, 0, 0};
+			result = append_chars(&chars, code_points, count) || expect_bytes(code_points, count, i, bom, &expected);
+			for(size_t j = 0; j < BUFFER_SIZE_COUNT && !result; ++j){
+				char what[64];
+				snprintf(what, sizeof(what), "%s, round %d, buffer %zu", yambler_encoding_name(encodings[i]), round, buffer_sizes[j]);
+				struct test_text encoded = {NULL, 0, 0};
+				yambler_status status = encode_chunks(ENCODER_TARGET_CALLBACK, (const yambler_char *)chars.data, chars.length / sizeof(yambler_char), encodings[i], buffer_sizes[j], bom ? YAMBLER_ENCODER_INCLUDE_BOM : 0, &encoded);
+				if(status){
+					result = test_fail("%s: encoding ended with '%s'", what, yambler_status_message(status));
+				}else if(encoded.length != expected.length || memcmp(encoded.data, expected.data, expected.length) != 0){
+					result = test_fail("%s: %zu bytes differ from the %zu of iconv", what, encoded.length, expected.length);
+				}else{
+					result = decode_back(&encoded, bom ? boms[i].length : 0, encodings[i], &chars, what);
+				}
+				test_text_free(&encoded);
+			}
+			test_text_free(&expected);
+			test_text_free(&chars);
+		}
+	}
+	return result;
+}
+
+/*
+ * A surrogate or a value past U+10FFFF among the characters ends encoding with YAMBLER_ENCODING_ERROR, after the
+ * characters before it were written
+ */
+static int test_encoder_invalid(){
+	static const yambler_code_point invalid[] = {0xD800, 0xDBFF, 0xDC00, 0xDFFF, 0x110000, 0x1FFFFF};
+	int result = 0;
+	for(size_t i = 0; i < ENCODING_COUNT && !result; ++i){
+		for(int round = 0; round < ENCODER_ROUNDS / 4 && !result; ++round){
+			yambler_code_point code_points[ENCODER_MAX_CHARS + 1];
+			size_t count;
+			test_random_code_points(code_points, ENCODER_MAX_CHARS, &count);
+			size_t position = test_random((uint32_t)count + 1);
+			memmove(code_points + position + 1, code_points + position, sizeof(yambler_code_point) * (count - position));
+			code_points[position] = invalid[test_random(sizeof(invalid) / sizeof(invalid[0]))];
+			int bom = round % 2;
+			struct test_text chars = {NULL, 0, 0};
+			struct test_text expected = {NULL, 0, 0};
+			result = append_chars(&chars, code_points, count + 1) || expect_bytes(code_points, position, i, bom, &expected);
+			for(size_t j = 0; j < BUFFER_SIZE_COUNT && !result; ++j){
+				struct test_text encoded = {NULL, 0, 0};
+				yambler_status status = encode_chunks(ENCODER_TARGET_CALLBACK, (const yambler_char *)chars.data, chars.length / sizeof(yambler_char), encodings[i], buffer_sizes[j], bom ? YAMBLER_ENCODER_INCLUDE_BOM : 0, &encoded);
+				if(status != YAMBLER_ENCODING_ERROR){
+					result = test_fail("%s, round %d, buffer %zu: U+%04X ended encoding with '%s'", yambler_encoding_name(encodings[i]), round, buffer_sizes[j], (unsigned)code_points[position], yambler_status_message(status));
+				}else if(encoded.length != expected.length || memcmp(encoded.data, expected.data, expected.length) != 0){
+					result = test_fail("%s, round %d, buffer %zu: the bytes before U+%04X differ from those of iconv", yambler_encoding_name(encodings[i]), round, buffer_sizes[j], (unsigned)code_points[position]);
+				}
+				test_text_free(&encoded);
+			}
+			test_text_free(&expected);
+			test_text_free(&chars);
+		}
+	}
+	return result;
+}
+
+/*
+ * The vectored, mapped and span targets write the same bytes as the write callback. The last round of each encoding
+ * writes more than the first mapping of a file holds, so that the mapping has to grow.
+ */
+static int test_encoder_targets(){
+	int result = 0;
+	for(size_t i = 0; i < ENCODING_COUNT && !result; ++i){
+		for(int round = 0; round <= ENCODER_ROUNDS / 4 && !result; ++round){
+			struct test_text chars = {NULL, 0, 0};
+			result = test_text_append(&chars, "", 0);
+			size_t total = 0;
+			size_t min_count = round == ENCODER_ROUNDS / 4 ? ENCODER_LARGE_CHARS : 0;
+			do{
+				yambler_code_point code_points[ENCODER_MAX_CHARS];
+				size_t count;
+				test_random_code_points(code_points, ENCODER_MAX_CHARS, &count);
+				result = append_chars(&chars, code_points, count);
+				total += count;
+			}while(total < min_count && !result);
+			size_t length = chars.length / sizeof(yambler_char);
+			size_t buffer_size = buffer_sizes[test_random(BUFFER_SIZE_COUNT)];
+			yambler_encoder_flag options = round % 2 ? YAMBLER_ENCODER_INCLUDE_BOM : 0;
+			struct test_text expected = {NULL, 0, 0};
+			yambler_status status = YAMBLER_OK;
+			if(!result){
+				status = encode_chunks(ENCODER_TARGET_CALLBACK, (const yambler_char *)chars.data, length, encodings[i], buffer_size, options, &expected);
+			}
+			for(int target = ENCODER_TARGET_VECTORED; target < ENCODER_TARGET_COUNT && !result && status == YAMBLER_OK; ++target){
+				struct test_text encoded = {NULL, 0, 0};
+				status = encode_chunks((enum encoder_target)target, (const yambler_char *)chars.data, length, encodings[i], buffer_size, options, &encoded);
+				if(status){
+					result = test_fail("%s, round %d, %s: encoding ended with '%s'", yambler_encoding_name(encodings[i]), round, target_names[target], yambler_status_message(status));
+				}else if(encoded.length != expected.length || memcmp(encoded.data, expected.data, expected.length) != 0){
+					result = test_fail("%s, round %d, %s: %zu bytes differ from the %zu written through the callback", yambler_encoding_name(encodings[i]), round, target_names[target], encoded.length, expected.length);
+				}
+				test_text_free(&encoded);
+			}
+			if(!result && status){
+				result = test_fail("%s, round %d: encoding through the callback ended with '%s'", yambler_encoding_name(encodings[i]), round, yambler_status_message(status));
+			}
+			test_text_free(&expected);
+			test_text_free(&chars);
+		}
+	}
+	return result;
+}
+
+void add_encoder_tests(){
+	add_test("encoder_round_trip", &test_encoder_round_trip);
+	add_test("encoder_invalid", &test_encoder_invalid);
+	add_test("encoder_targets", &test_encoder_targets);
+}
@@ -0,0 +1,302 @@
+#include "test.h"
+
+#include "yambler_input_buffer.h"
+#include "yambler_input_buffer_impl.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define INPUT_ROUNDS 200
+#define INPUT_MAX_CHARS 400
+
+/*
+ * Characters of one to four UTF-8 bytes, which are decoded into as many characters in the UTF-8 build
+ */
+static const struct{
+	const char *utf8;
+	yambler_code_point code_point;
+} input_chars[] = {{"a", 'a'}, {"\n", '\n'}, {"\xC3\xA9", 0xE9}, {"\xE2\x82\xAC", 0x20AC}, {"\xF0\x9F\x98\x80", 0x1F600}};
+
+#define INPUT_CHAR_KINDS (sizeof(input_chars) / sizeof(input_chars[0]))
+
+/*
+ * Generates UTF-8 text and the characters it decodes into
+ */
+static int generate_input(struct test_text *utf8, yambler_char *expected, size_t *expected_length){
+	size_t count = 1 + test_random(INPUT_MAX_CHARS);
+	*expected_length = 0;
+	int result = test_text_append(utf8, "", 0);
+	for(size_t i = 0; i < count && !result; ++i){
+		size_t kind = test_random(INPUT_CHAR_KINDS);
+		const char *bytes = input_chars[kind].utf8;
+		result = test_text_append_string(utf8, bytes);
+#ifdef YAMBLER_UTF8_CHARS
+		for(size_t j = 0; bytes[j] != '\0'; ++j){
+			expected[(*expected_length)++] = (yambler_char)bytes[j];
+		}
+#else
+		expected[(*expected_length)++] = input_chars[kind].code_point;
+#endif
+	}
+	return result;
+}
+
+/*
+ * Reads the text through spans of random minimum lengths, consuming a random part of each. A span must be as long
+ * as requested until the characters run out, also when the next character does not fit behind the buffered ones.
+ */
+static int read_spans(yambler_input_buffer_p buffer, const yambler_char *expected, size_t expected_length, int hold){
+	size_t position = 0;
+	while(1){
+		if(hold && test_random(8) == 0){
+			if(test_random(2)){
+				yambler_input_buffer_hold(buffer);
+			}else{
+				yambler_input_buffer_release(buffer);
+			}
+		}
+		size_t min_length = 1 + test_random(12);
+		const yambler_char *span;
+		size_t length;
+		yambler_status status = yambler_input_buffer_span(buffer, min_length, &span, &length);
+		if(status == YAMBLER_EMPTY && position == expected_length){
+			break;
+		}
+		if(status){
+			return test_fail("span at %zu ended with '%s'", position, yambler_status_message(status));
+		}
+		size_t left = expected_length - position;
+		if(length > left || (length < min_length && length != left)){
+			return test_fail("span of %zu at %zu holds %zu characters with %zu left", min_length, position, length, left);
+		}
+		if(memcmp(span, expected + position, sizeof(yambler_char) * length) != 0){
+			return test_fail("span at %zu differs from the text", position);
+		}
+		size_t count = 1 + test_random((uint32_t)length);
+		yambler_input_buffer_consume_n(buffer, count);
+		position += count;
+	}
+	yambler_input_buffer_release(buffer);
+	return 0;
+}
+
+static int test_input_buffer_spans(){
+	static yambler_char expected[INPUT_MAX_CHARS * 4];
+	for(int round = 0; round < INPUT_ROUNDS; ++round){
+		struct test_text utf8 = {NULL, 0, 0};
+		size_t expected_length;
+		int result = generate_input(&utf8, expected, &expected_length);
+		/* small buffers leave a few characters of room behind the buffered ones, too few for most characters */
+		struct yambler_input_buffer_policy policy = {8 + test_random(16), 0, 0, 0};
+		yambler_input_buffer_p buffer = NULL;
+		if(!result && yambler_input_buffer_create_from_memory(&buffer, NULL, &policy, (const yambler_byte *)utf8.data, utf8.length, YAMBLER_ENCODING_UTF_8)){
+			result = test_fail("unable to create the buffer");
+		}
+		if(!result && yambler_input_buffer_open(buffer)){
+			result = test_fail("unable to open the buffer");
+		}
+		if(!result){
+			result = read_spans(buffer, expected, expected_length, round % 2);
+			if(result){
+				fprintf(stderr, "round %d, buffer of %zu\n", round, policy.initial_size);
+			}
+		}
+		if(buffer){
+			yambler_input_buffer_close(buffer);
+			yambler_input_buffer_destroy(&buffer);
+		}
+		test_text_free(&utf8);
+		if(result){
+			return result;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Seven characters fill a buffer of eight up to a euro sign, which takes three characters in the UTF-8 build.
+ * Once two of them are consumed the other five still fit where they are for a span of six, which has to move them
+ * to the front all the same to make room for the sign.
+ */
+static int test_input_buffer_char_at_end(){
+	static const char text[] = "abcdefg\xE2\x82\xAC" "xyz";
+	struct yambler_input_buffer_policy policy = {8, 0, 0, 0};
+	yambler_input_buffer_p buffer;
+	if(yambler_input_buffer_create_from_memory(&buffer, NULL, &policy, (const yambler_byte *)text, sizeof(text) - 1, YAMBLER_ENCODING_UTF_8)){
+		return test_fail("unable to create the buffer");
+	}
+	int result = 0;
+	const yambler_char *span;
+	size_t length;
+	if(yambler_input_buffer_open(buffer) || yambler_input_buffer_span(buffer, 1, &span, &length)){
+		result = test_fail("unable to read the buffer");
+	}else{
+		yambler_input_buffer_consume_n(buffer, 2);
+		yambler_status status = yambler_input_buffer_span(buffer, 6, &span, &length);
+		if(status || length < 6 || span[0] != 'c'){
+			result = test_fail("span of six after the second character ended with '%s' and %zu characters", yambler_status_message(status), length);
+		}
+	}
+	yambler_input_buffer_close(buffer);
+	yambler_input_buffer_destroy(&buffer);
+	return result;
+}
+
+/*
+ * Reads text of ASCII letters, which are a character each in either build, through a buffer with the given policy
+ */
+static int open_letters(yambler_input_buffer_p *buffer, const struct yambler_input_buffer_policy *policy, char *text, size_t length){
+	for(size_t i = 0; i < length; ++i){
+		text[i] = (char)('a' + i % 26);
+	}
+	if(yambler_input_buffer_create_from_memory(buffer, NULL, policy, (const yambler_byte *)text, length, YAMBLER_ENCODING_UTF_8)){
+		return test_fail("unable to create the buffer");
+	}
+	if(yambler_input_buffer_open(*buffer)){
+		yambler_input_buffer_destroy(buffer);
+		return test_fail("unable to open the buffer");
+	}
+	return 0;
+}
+
+static void close_letters(yambler_input_buffer_p *buffer){
+	yambler_input_buffer_close(*buffer);
+	yambler_input_buffer_destroy(buffer);
+}
+
+/*
+ * Asks for a span of min_length characters at position of the text and checks its characters and the size of the
+ * buffer afterwards
+ */
+static int check_span(yambler_input_buffer_p buffer, const char *text, size_t position, size_t min_length, size_t size, const char *what){
+	const yambler_char *span;
+	size_t length;
+	yambler_status status = yambler_input_buffer_span(buffer, min_length, &span, &length);
+	if(status){
+		return test_fail("%s: span of %zu ended with '%s'", what, min_length, yambler_status_message(status));
+	}
+	if(length < min_length){
+		return test_fail("%s: span of %zu holds %zu characters", what, min_length, length);
+	}
+	for(size_t i = 0; i < length; ++i){
+		if(span[i] != (yambler_char)text[position + i]){
+			return test_fail("%s: span of %zu differs from the text at %zu", what, min_length, position + i);
+		}
+	}
+	struct yambler_input_buffer_stats stats;
+	yambler_input_buffer_get_stats(buffer, &stats);
+	if(stats.size != size){
+		return test_fail("%s: span of %zu left a buffer of %zu instead of %zu", what, min_length, stats.size, size);
+	}
+	return 0;
+}
+
+/*
+ * Requests beyond the size grow the buffer to growth_factor times its size, at least by min_growth and at least to
+ * the request, up to max_size. A request beyond max_size fails with YAMBLER_BOUNDS_ERROR.
+ */
+static int test_input_buffer_growth(){
+	static const struct{
+		const char *name;
+		struct yambler_input_buffer_policy policy;
+		size_t requests[5];
+		size_t sizes[5];
+	} cases[] = {
+		{"geometric", {16, 0, 2, 1}, {1, 17, 33, 100, 300}, {16, 32, 64, 128, 300}},
+		{"linear", {16, 0, 1, 10}, {1, 17, 27, 50, 51}, {16, 26, 36, 50, 60}},
+		{"min_growth", {16, 0, 2, 100}, {1, 17, 117, 200, 233}, {16, 116, 232, 232, 464}},
+		{"max_size", {16, 40, 2, 1}, {1, 17, 33, 40, 40}, {16, 32, 40, 40, 40}},
+		{"initial_size past max_size", {64, 40, 2, 1}, {1, 40, 40, 40, 40}, {40, 40, 40, 40, 40}}
+	};
+	static char text[1000];
+	int result = 0;
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && !result; ++i){
+		yambler_input_buffer_p buffer;
+		result = open_letters(&buffer, &cases[i].policy, text, sizeof(text));
+		if(result){
+			break;
+		}
+		size_t grow_count = 0;
+		for(size_t j = 0; j < 5 && !result; ++j){
+			result = check_span(buffer, text, 0, cases[i].requests[j], cases[i].sizes[j], cases[i].name);
+			grow_count += j != 0 && cases[i].sizes[j] != cases[i].sizes[j - 1];
+		}
+		struct yambler_input_buffer_stats stats;
+		yambler_input_buffer_get_stats(buffer, &stats);
+		if(!result && (stats.grow_count != grow_count || stats.high_water_size != cases[i].sizes[4])){
+			result = test_fail("%s: grew %zu times to %zu instead of %zu times to %zu", cases[i].name, stats.grow_count, stats.high_water_size, grow_count, cases[i].sizes[4]);
+		}
+		if(!result && cases[i].policy.max_size){
+			const yambler_char *span;
+			size_t length;
+			yambler_status status = yambler_input_buffer_span(buffer, cases[i].policy.max_size + 1, &span, &length);
+			if(status != YAMBLER_BOUNDS_ERROR){
+				result = test_fail("%s: span past max_size ended with '%s'", cases[i].name, yambler_status_message(status));
+			}
+		}
+		close_letters(&buffer);
+	}
+	return result;
+}
+
+/*
+ * The unread characters are moved to the front once more than half of the buffer was consumed, or when the space
+ * behind them is too small for a request. A held buffer moves them into another block instead.
+ */
+static int test_input_buffer_compaction(){
+	static const struct yambler_input_buffer_policy policy = {16, 0, 2, 1};
+	static char text[1000];
+	yambler_input_buffer_p buffer;
+	int result = open_letters(&buffer, &policy, text, sizeof(text));
+	if(result){
+		return result;
+	}
+	static const struct{
+		size_t consume;
+		size_t min_length;
+		size_t compact_count;
+		size_t compacted_length;
+		size_t retire_count;
+		int hold;
+	} steps[] = {
+		{0, 1, 0, 0, 0, 0},
+		/* ten of sixteen consumed, six to move */
+		{10, 8, 1, 6, 0, 0},
+		/* little consumed, but the thirteen left do not leave room for fourteen */
+		{3, 14, 2, 19, 0, 0},
+		/* nothing to move once everything was consumed */
+		{16, 1, 2, 19, 0, 0},
+		/* a held buffer retires its block instead */
+		{10, 8, 2, 19, 1, 1},
+		{6, 12, 2, 19, 2, 1}
+	};
+	size_t position = 0;
+	for(size_t i = 0; i < sizeof(steps) / sizeof(steps[0]) && !result; ++i){
+		if(steps[i].hold){
+			yambler_input_buffer_hold(buffer);
+		}
+		yambler_input_buffer_consume_n(buffer, steps[i].consume);
+		position += steps[i].consume;
+		char what[32];
+		snprintf(what, sizeof(what), "step %zu", i);
+		result = check_span(buffer, text, position, steps[i].min_length, 16, what);
+		struct yambler_input_buffer_stats stats;
+		yambler_input_buffer_get_stats(buffer, &stats);
+		if(!result && (stats.compact_count != steps[i].compact_count || stats.compacted_length != steps[i].compacted_length || stats.retire_count != steps[i].retire_count)){
+			result = test_fail("%s: %zu compactions of %zu characters and %zu retired blocks instead of %zu of %zu and %zu", what, stats.compact_count, stats.compacted_length, stats.retire_count, steps[i].compact_count, steps[i].compacted_length, steps[i].retire_count);
+		}
+		if(!result && (stats.grow_count != 0 || stats.high_water_length != 16)){
+			result = test_fail("%s: grew %zu times and buffered up to %zu characters", what, stats.grow_count, stats.high_water_length);
+		}
+	}
+	yambler_input_buffer_release(buffer);
+	close_letters(&buffer);
+	return result;
+}
+
+void add_input_buffer_tests(){
+	add_test("input_buffer_spans", &test_input_buffer_spans);
+	add_test("input_buffer_char_at_end", &test_input_buffer_char_at_end);
+	add_test("input_buffer_growth", &test_input_buffer_growth);
+	add_test("input_buffer_compaction", &test_input_buffer_compaction);
+}
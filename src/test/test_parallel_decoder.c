@@ -0,0 +1,107 @@
+#include "test.h"
+
+#include "yambler_parallel_decoder.h"
+#include "yambler_utility.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PARALLEL_ROUNDS 3
+
+/* the decoder splits input of this size and more into chunks of at least this many bytes */
+#define PARALLEL_CHUNK_SIZE 65536
+
+#define PARALLEL_MAX_CHUNKS 5
+
+static const size_t thread_counts[] = {1, 2, 4};
+
+#define THREAD_COUNT_COUNT (sizeof(thread_counts) / sizeof(thread_counts[0]))
+
+/*
+ * A random code point that takes length bytes in the encoding
+ */
+static yambler_code_point code_point_of_length(enum yambler_encoding encoding, size_t length){
+	if(encoding == YAMBLER_ENCODING_UTF_16LE || encoding == YAMBLER_ENCODING_UTF_16BE){
+		length = length == 4 ? 4 : 1 + test_random(3);
+	}
+	switch(length){
+	case 1:
+		return 0x20 + test_random(0x5F);
+	case 2:
+		return 0x80 + test_random(0x780);
+	case 3:{
+		yambler_code_point c = 0x800 + test_random(0xF800);
+		return c >= 0xD800 && c <= 0xDFFF ? c + 0x800 : c;
+	}
+	default:
+		return 0x10000 + test_random(0x100000);
+	}
+}
+
+/*
+ * Generates text that ends a character inside every multiple of the chunk size, the place where the decoder first
+ * tries to split the input: in a UTF-8 sequence at any of its continuation bytes, or between the halves of a UTF-16
+ * surrogate pair. UTF-32 characters cannot be split, as the chunk size is a multiple of four.
+ */
+static int generate_text(enum yambler_encoding encoding, struct test_text *data, struct test_text *expected){
+	static const size_t utf8_lengths[] = {1, 2, 3, 4};
+	static const size_t utf16_lengths[] = {2, 4};
+	static const size_t utf32_lengths[] = {4};
+	const size_t *lengths = encoding == YAMBLER_ENCODING_UTF_8 ? utf8_lengths : encoding == YAMBLER_ENCODING_UTF_16LE || encoding == YAMBLER_ENCODING_UTF_16BE ? utf16_lengths : utf32_lengths;
+	size_t length_count = encoding == YAMBLER_ENCODING_UTF_8 ? 4 : encoding == YAMBLER_ENCODING_UTF_16LE || encoding == YAMBLER_ENCODING_UTF_16BE ? 2 : 1;
+	size_t target = (PARALLEL_MAX_CHUNKS - 2) * PARALLEL_CHUNK_SIZE + test_random(2 * PARALLEL_CHUNK_SIZE);
+	int result = test_text_append(data, "", 0) || test_text_append(expected, "", 0);
+	while(data->length < target && !result){
+		size_t gap = PARALLEL_CHUNK_SIZE - data->length % PARALLEL_CHUNK_SIZE;
+		size_t length = lengths[test_random((uint32_t)length_count)];
+		/* a character that would end right at the split is replaced by one that ends before or after it */
+		while(length == gap && length_count > 1){
+			length = lengths[test_random((uint32_t)length_count)];
+		}
+		yambler_code_point c = code_point_of_length(encoding, length);
+		result = test_text_append_encoded(data, c, encoding) || test_text_append_native(expected, c);
+	}
+	return result;
+}
+
+static yambler_status write_text(yambler_decoder_state state, const yambler_char *data, size_t length){
+	struct test_text *text = (struct test_text *)state;
+	return test_text_append(text, (const char *)data, sizeof(yambler_char) * length) ? YAMBLER_ALLOC_ERROR : YAMBLER_OK;
+}
+
+static int test_parallel_decoder_splits(){
+	static const enum yambler_encoding encodings[] = {YAMBLER_ENCODING_UTF_8, YAMBLER_ENCODING_UTF_16LE, YAMBLER_ENCODING_UTF_16BE, YAMBLER_ENCODING_UTF_32LE};
+	int result = 0;
+	for(size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]) && !result; ++i){
+		for(int round = 0; round < PARALLEL_ROUNDS && !result; ++round){
+			struct test_text data = {NULL, 0, 0};
+			struct test_text expected = {NULL, 0, 0};
+			struct test_text single = {NULL, 0, 0};
+			result = generate_text(encodings[i], &data, &expected);
+			for(size_t j = 0; j < THREAD_COUNT_COUNT && !result; ++j){
+				struct test_text decoded = {NULL, 0, 0};
+				yambler_status status = yambler_decode_parallel(NULL, (const yambler_byte *)data.data, data.length, encodings[i], thread_counts[j], &write_text, &decoded);
+				if(status){
+					result = test_fail("%s, round %d, %zu threads: decoding ended with '%s'", yambler_encoding_name(encodings[i]), round, thread_counts[j], yambler_status_message(status));
+				}else if(j == 0 && (decoded.length != expected.length || memcmp(decoded.data, expected.data, expected.length) != 0)){
+					result = test_fail("%s, round %d: one thread decodes other characters than those encoded", yambler_encoding_name(encodings[i]), round);
+				}else if(j != 0 && (decoded.length != single.length || memcmp(decoded.data, single.data, single.length) != 0)){
+					result = test_fail("%s, round %d: %zu threads decode other characters than one", yambler_encoding_name(encodings[i]), round, thread_counts[j]);
+				}
+				if(j == 0){
+					single = decoded;
+				}else{
+					test_text_free(&decoded);
+				}
+			}
+			test_text_free(&single);
+			test_text_free(&expected);
+			test_text_free(&data);
+		}
+	}
+	return result;
+}
+
+void add_parallel_decoder_tests(){
+	add_test("parallel_decoder_splits", &test_parallel_decoder_splits);
+}
@@ -0,0 +1,285 @@
+#include "test.h"
+
+#include "yambler_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The cases under data/parser were generated by generate.py, their transcripts hold the events of the reference
+ * parser. Every case is parsed with small buffers, so that values and indicators straddle refills, an event at a
+ * time and in batches, with and without fragments, and all of these have to produce the same transcript.
+ */
+
+static const struct test_parse_options parser_configurations[] = {
+	{1024, 0, 0, 0, NULL},
+	{5, 0, 0, 0, NULL},
+	{13, 0, 1, 0, NULL},
+	{5, 1, 1, 0, NULL},
+	{64, 7, 0, 0, NULL},
+	{13, 64, 1, 0, NULL}
+};
+
+#define PARSER_CONFIGURATION_COUNT (sizeof(parser_configurations) / sizeof(parser_configurations[0]))
+
+static const char *event_names[] = {
+	"document begin",
+	"map begin",
+	"map end",
+	"document end",
+	"sequence begin",
+	"sequence end",
+	"scalar: ",
+	"alias: ",
+	"comment: ",
+	"directive: "
+};
+
+static int append_char(struct test_text *transcript, yambler_char c){
+	char buffer[8];
+	size_t length = 0;
+	if(c == '\\'){
+		return test_text_append(transcript, "\\\\", 2);
+	}else if(c == '\n'){
+		return test_text_append(transcript, "\\n", 2);
+	}else if(c == '\t'){
+		return test_text_append(transcript, "\\t", 2);
+	}else if(c == '\r'){
+		return test_text_append(transcript, "\\r", 2);
+	}else if(c < 0x20 || c == 0x7F){
+		snprintf(buffer, sizeof(buffer), "\\x%02x", (unsigned)c);
+		return test_text_append_string(transcript, buffer);
+	}
+#ifdef YAMBLER_UTF8_CHARS
+	buffer[length++] = (char)c;
+#else
+	/* the transcripts are UTF-8, as the input of the cases */
+	if(c < 0x80){
+		buffer[length++] = (char)c;
+	}else if(c < 0x800){
+		buffer[length++] = (char)(0xC0 | (c >> 6));
+		buffer[length++] = (char)(0x80 | (c & 0x3F));
+	}else if(c < 0x10000){
+		buffer[length++] = (char)(0xE0 | (c >> 12));
+		buffer[length++] = (char)(0x80 | ((c >> 6) & 0x3F));
+		buffer[length++] = (char)(0x80 | (c & 0x3F));
+	}else{
+		buffer[length++] = (char)(0xF0 | (c >> 18));
+		buffer[length++] = (char)(0x80 | ((c >> 12) & 0x3F));
+		buffer[length++] = (char)(0x80 | ((c >> 6) & 0x3F));
+		buffer[length++] = (char)(0x80 | (c & 0x3F));
+	}
+#endif
+	return test_text_append(transcript, buffer, length);
+}
+
+/*
+ * Appends an event, a value continued by the following events is written once its last fragment arrives
+ */
+static int append_event(struct test_text *transcript, const struct yambler_parser_event *event, int *continuing, enum yambler_parser_event_type *continued_type){
+	if(*continuing && event->type != *continued_type){
+		return test_fail("a fragment of type %d continues a value of type %d", (int)event->type, (int)*continued_type);
+	}
+	int has_value = event->type == YAMBLER_PE_SCALAR || event->type == YAMBLER_PE_ALIAS || event->type == YAMBLER_PE_COMMENT || event->type == YAMBLER_PE_DIRECTIVE;
+	if(!has_value && event->continued){
+		return test_fail("an event of type %d without a value is continued", (int)event->type);
+	}
+	int result = 0;
+	if(!*continuing){
+		if((size_t)event->type >= sizeof(event_names) / sizeof(event_names[0])){
+			return test_fail("unknown event type %d", (int)event->type);
+		}
+		result = test_text_append_string(transcript, event_names[event->type]);
+	}
+	for(size_t i = 0; i < event->value.length && has_value && !result; ++i){
+		result = append_char(transcript, event->value.begin[i]);
+	}
+	if(!result && !event->continued){
+		result = test_text_append(transcript, "\n", 1);
+	}
+	*continuing = event->continued;
+	*continued_type = event->type;
+	return result;
+}
+
+yambler_status test_parse(const char *data, size_t length, const struct test_parse_options *options, struct test_text *transcript, struct yambler_input_buffer_stats *stats){
+	struct yambler_input_buffer_policy policy = {options->buffer_size, 0, 0, 0};
+	yambler_input_buffer_p buffer = NULL;
+	yambler_status status = yambler_input_buffer_create_from_memory(&buffer, options->allocator, &policy, (const yambler_byte *)data, length, YAMBLER_ENCODING_UTF_8);
+	if(status){
+		test_fail("unable to create input buffer");
+		return status;
+	}
+	yambler_parser_p parser = NULL;
+	status = yambler_parser_create(&parser, options->allocator);
+	if(status){
+		test_fail("unable to create parser");
+		yambler_input_buffer_destroy(&buffer);
+		return status;
+	}
+	yambler_parser_set_fragments(parser, options->fragments);
+	status = yambler_parser_open(parser, buffer);
+	if(status){
+		test_fail("unable to open parser");
+		yambler_parser_destroy_all(&parser, &buffer, NULL);
+		return status;
+	}
+
+	size_t capacity = options->capacity ? options->capacity : 1;
+	struct yambler_parser_event *events = malloc(sizeof(struct yambler_parser_event) * capacity);
+	if(events == NULL){
+		test_fail("unable to allocate events");
+		yambler_parser_destroy_all(&parser, &buffer, NULL);
+		return YAMBLER_ALLOC_ERROR;
+	}
+	int continuing = 0;
+	enum yambler_parser_event_type continued_type = YAMBLER_PE_SCALAR;
+	size_t count;
+	do{
+		if(options->capacity){
+			status = yambler_parser_parse_batch(parser, events, capacity, &count);
+		}else{
+			status = yambler_parser_parse(parser, events);
+			count = status == YAMBLER_OK;
+		}
+		for(size_t i = 0; i < count; ++i){
+			if(events[i].type == YAMBLER_PE_COMMENT && !options->comments){
+				continuing = events[i].continued;
+				continued_type = events[i].type;
+				continue;
+			}
+			if(append_event(transcript, &events[i], &continuing, &continued_type)){
+				status = YAMBLER_ERROR;
+				break;
+			}
+		}
+	}while(status == YAMBLER_OK);
+
+	struct yambler_parser_error error;
+	if(status == YAMBLER_EMPTY && continuing){
+		test_fail("the input ended in a continued value");
+		status = YAMBLER_ERROR;
+	}else if(status == YAMBLER_SYNTAX_ERROR && !yambler_parser_get_error(parser, &error)){
+		test_fail("a syntax error was returned without an error");
+		status = YAMBLER_ERROR;
+	}
+	if(stats){
+		yambler_input_buffer_get_stats(buffer, stats);
+	}
+	free(events);
+	yambler_parser_destroy_all(&parser, &buffer, NULL);
+	return status;
+}
+
+/*
+ * Reports the first line in which the transcript differs from the expected one
+ */
+static int compare_transcript(const char *name, size_t configuration, const struct test_text *transcript, const struct test_text *expected){
+	if(transcript->length == expected->length && memcmp(transcript->data, expected->data, expected->length) == 0){
+		return 0;
+	}
+	const char *got = transcript->data ? transcript->data : "";
+	const char *wanted = expected->data;
+	size_t line = 1;
+	while(*got != '\0' && *got == *wanted){
+		if(*got == '\n'){
+			++line;
+		}
+		++got;
+		++wanted;
+	}
+	while(got > transcript->data && got[-1] != '\n'){
+		--got;
+		--wanted;
+	}
+	return test_fail("%s, configuration %zu, line %zu: got '%.*s' instead of '%.*s'", name, configuration, line, (int)strcspn(got, "\n"), got, (int)strcspn(wanted, "\n"), wanted);
+}
+
+static int run_case(const char *group, const char *name){
+	char path[512];
+	struct test_text input = {NULL, 0, 0};
+	struct test_text expected = {NULL, 0, 0};
+	snprintf(path, sizeof(path), "parser/%s/%s.yaml", group, name);
+	int result = test_read_file(path, &input);
+	snprintf(path, sizeof(path), "parser/%s/%s.events", group, name);
+	if(!result){
+		result = test_read_file(path, &expected);
+	}
+	for(size_t i = 0; i < PARSER_CONFIGURATION_COUNT && !result; ++i){
+		struct test_text transcript = {NULL, 0, 0};
+		yambler_status status = test_parse(input.data, input.length, &parser_configurations[i], &transcript, NULL);
+		if(status != YAMBLER_EMPTY){
+			result = test_fail("%s/%s, configuration %zu: parsing ended with '%s'", group, name, i, yambler_status_message(status));
+		}else{
+			snprintf(path, sizeof(path), "%s/%s", group, name);
+			result = compare_transcript(path, i, &transcript, &expected);
+		}
+		test_text_free(&transcript);
+	}
+	test_text_free(&input);
+	test_text_free(&expected);
+	return result;
+}
+
+static int run_group(const char *group){
+	char directory[256];
+	snprintf(directory, sizeof(directory), "parser/%s", group);
+	char **names;
+	size_t count;
+	if(test_list_files(directory, ".yaml", &names, &count)){
+		return 1;
+	}
+	size_t failed = 0;
+	for(size_t i = 0; i < count; ++i){
+		failed += run_case(group, names[i]) != 0;
+	}
+	test_free_list(names, count);
+	return failed ? test_fail("%zu of %zu cases in %s failed", failed, count, group) : 0;
+}
+
+static int test_parser_block(){
+	return run_group("block");
+}
+
+static int test_parser_flow(){
+	return run_group("flow");
+}
+
+static int test_parser_quoted(){
+	return run_group("quoted");
+}
+
+static int test_parser_invalid(){
+	/* every configuration has to reject the input, the events before the error are not checked */
+	char **names;
+	size_t count;
+	if(test_list_files("parser/invalid", ".yaml", &names, &count)){
+		return 1;
+	}
+	int result = 0;
+	for(size_t i = 0; i < count && !result; ++i){
+		char path[512];
+		struct test_text input = {NULL, 0, 0};
+		snprintf(path, sizeof(path), "parser/invalid/%s.yaml", names[i]);
+		result = test_read_file(path, &input);
+		for(size_t j = 0; j < PARSER_CONFIGURATION_COUNT && !result; ++j){
+			struct test_text transcript = {NULL, 0, 0};
+			yambler_status status = test_parse(input.data, input.length, &parser_configurations[j], &transcript, NULL);
+			if(status != YAMBLER_SYNTAX_ERROR){
+				result = test_fail("invalid/%s, configuration %zu: parsing ended with '%s'", names[i], j, yambler_status_message(status));
+			}
+			test_text_free(&transcript);
+		}
+		test_text_free(&input);
+	}
+	test_free_list(names, count);
+	return result;
+}
+
+void add_parser_tests(){
+	add_test("parser_block", &test_parser_block);
+	add_test("parser_flow", &test_parser_flow);
+	add_test("parser_quoted", &test_parser_quoted);
+	add_test("parser_invalid", &test_parser_invalid);
+}
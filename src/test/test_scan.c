@@ -0,0 +1,173 @@
+#include "test.h"
+
+#include "yambler_scan.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The vector kernels are checked against the scalar one, which a copy of the same set takes once vector is cleared.
+ * The buffers start at every alignment and mix members of the set with characters that only share their low byte
+ * with one, so that a kernel comparing too few bits of a character shows.
+ */
+
+#define SCAN_ROUNDS 3000
+#define SCAN_MAX_LENGTH 700
+#define SCAN_MAX_OFFSET 8
+
+static const yambler_char_class scan_masks[] = {
+	YAMBLER_CLASS_BREAK,
+	YAMBLER_CLASS_BLANK | YAMBLER_CLASS_BREAK,
+	YAMBLER_CLASS_BREAK | YAMBLER_CLASS_COMMENT | YAMBLER_CLASS_MAPPING_VALUE,
+	YAMBLER_CLASS_FLOW_INDICATOR | YAMBLER_CLASS_MAPPING_VALUE | YAMBLER_CLASS_COMMENT | YAMBLER_CLASS_QUOTE | YAMBLER_CLASS_BREAK
+};
+
+static const char scan_alphabet[] = " \t\r\n#:,[]{}\"'\\-ab";
+
+static yambler_char random_char(){
+	uint32_t kind = test_random(10);
+	if(kind < 6){
+		return (yambler_char)scan_alphabet[test_random(sizeof(scan_alphabet) - 1)];
+	}else if(kind < 8){
+		return (yambler_char)(0x80 + test_random(0x80));
+	}
+#ifdef YAMBLER_UTF8_CHARS
+	return (yambler_char)'a';
+#else
+	/* the low byte of these is an indicator or a break */
+	return (yambler_char)(scan_alphabet[test_random(sizeof(scan_alphabet) - 1)] + 0x100 * (1 + test_random(0x10FF)));
+#endif
+}
+
+/*
+ * Members are made rare in some rounds, so that the vector loops run over several blocks before they stop
+ */
+static void fill(yambler_char *buffer, size_t length, const struct yambler_scan_set *set){
+	uint32_t density = 1 + test_random(64);
+	for(size_t i = 0; i < length; ++i){
+		yambler_char c = random_char();
+		while(YAMBLER_CHAR_IS(c, set->mask) && test_random(density) != 0){
+			c = random_char();
+		}
+		buffer[i] = c;
+	}
+}
+
+static int test_scan_kernels(){
+	yambler_char *buffer = malloc(sizeof(yambler_char) * (SCAN_MAX_LENGTH + SCAN_MAX_OFFSET));
+	if(buffer == NULL){
+		return test_fail("unable to allocate buffer");
+	}
+	int result = 0;
+	for(size_t m = 0; m < sizeof(scan_masks) / sizeof(scan_masks[0]) && !result; ++m){
+		struct yambler_scan_set set;
+		yambler_scan_set_init(&set, scan_masks[m]);
+		if(!set.vector){
+			result = test_fail("mask 0x%04x is not scanned by the vector kernels", (unsigned)scan_masks[m]);
+			break;
+		}
+		struct yambler_scan_set scalar = set;
+		scalar.vector = 0;
+		for(int round = 0; round < SCAN_ROUNDS; ++round){
+			size_t offset = test_random(SCAN_MAX_OFFSET);
+			size_t length = test_random(SCAN_MAX_LENGTH + 1);
+			const yambler_char *begin = buffer + offset;
+			fill(buffer, offset + length, &set);
+
+			size_t until = yambler_scan_until(&set, begin, length);
+			size_t expected = yambler_scan_until(&scalar, begin, length);
+			if(until != expected){
+				result = test_fail("mask 0x%04x round %d: scan_until returned %zu instead of %zu", (unsigned)set.mask, round, until, expected);
+				break;
+			}
+			size_t skip = until < length ? until : 0;
+			size_t while_length = yambler_scan_while(&set, begin + skip, length - skip);
+			expected = yambler_scan_while(&scalar, begin + skip, length - skip);
+			if(while_length != expected){
+				result = test_fail("mask 0x%04x round %d: scan_while returned %zu instead of %zu", (unsigned)set.mask, round, while_length, expected);
+				break;
+			}
+		}
+	}
+	free(buffer);
+	return result;
+}
+
+static int test_scan_scalar(){
+	/* the scalar kernel itself against the class table, including a set with characters outside of ASCII */
+	struct yambler_scan_set set;
+	yambler_scan_set_init(&set, YAMBLER_CLASS_NON_SPACE);
+	if(set.vector){
+		return test_fail("a mask with characters outside of ASCII is scanned by the vector kernels");
+	}
+	yambler_char buffer[SCAN_MAX_LENGTH];
+	for(int round = 0; round < SCAN_ROUNDS; ++round){
+		size_t length = test_random(SCAN_MAX_LENGTH + 1);
+		fill(buffer, length, &set);
+		size_t expected = 0;
+		while(expected < length && !YAMBLER_CHAR_IS(buffer[expected], set.mask)){
+			++expected;
+		}
+		size_t until = yambler_scan_until(&set, buffer, length);
+		if(until != expected){
+			return test_fail("round %d: scan_until returned %zu instead of %zu", round, until, expected);
+		}
+	}
+	return 0;
+}
+
+/*
+ * The bitmaps start out filled, so that a word the index leaves unwritten or a bit it sets past length shows
+ */
+static int test_scan_index(){
+	yambler_char *buffer = malloc(sizeof(yambler_char) * (SCAN_MAX_LENGTH + SCAN_MAX_OFFSET));
+	if(buffer == NULL){
+		return test_fail("unable to allocate buffer");
+	}
+	uint64_t bitmap[YAMBLER_SCAN_INDEX_WORDS(SCAN_MAX_LENGTH)];
+	uint64_t expected[YAMBLER_SCAN_INDEX_WORDS(SCAN_MAX_LENGTH)];
+	int result = 0;
+	for(size_t m = 0; m < sizeof(scan_masks) / sizeof(scan_masks[0]) && !result; ++m){
+		struct yambler_scan_set set;
+		yambler_scan_set_init(&set, scan_masks[m]);
+		struct yambler_scan_set scalar = set;
+		scalar.vector = 0;
+		for(int round = 0; round < SCAN_ROUNDS && !result; ++round){
+			size_t offset = test_random(SCAN_MAX_OFFSET);
+			size_t length = test_random(SCAN_MAX_LENGTH + 1);
+			const yambler_char *begin = buffer + offset;
+			fill(buffer, offset + length, &set);
+			memset(bitmap, 0xFF, sizeof(bitmap));
+			memset(expected, 0xFF, sizeof(expected));
+			yambler_scan_index(&set, begin, length, bitmap);
+			yambler_scan_index(&scalar, begin, length, expected);
+			for(size_t i = 0; i < YAMBLER_SCAN_INDEX_WORDS(length) * 64 && !result; ++i){
+				int bit = (expected[i / 64] >> (i % 64)) & 1;
+				if(bit != (i < length && YAMBLER_CHAR_IS(begin[i], set.mask))){
+					result = test_fail("mask 0x%04x round %d: the scalar index is wrong at %zu of %zu", (unsigned)set.mask, round, i, length);
+				}else if(bit != (int)((bitmap[i / 64] >> (i % 64)) & 1)){
+					result = test_fail("mask 0x%04x round %d: the index is wrong at %zu of %zu", (unsigned)set.mask, round, i, length);
+				}
+			}
+			/* every offset is looked up once, the search must stop at the next marked character or at length */
+			size_t next = length;
+			for(size_t from = length + 1; from-- > 0 && !result; ){
+				if(from < length && YAMBLER_CHAR_IS(begin[from], set.mask)){
+					next = from;
+				}
+				size_t found = yambler_scan_next_bit(bitmap, from, length);
+				if(found != next){
+					result = test_fail("mask 0x%04x round %d: the next bit from %zu is %zu instead of %zu", (unsigned)set.mask, round, from, found, next);
+				}
+			}
+		}
+	}
+	free(buffer);
+	return result;
+}
+
+void add_scan_tests(){
+	add_test("scan_kernels", &test_scan_kernels);
+	add_test("scan_scalar", &test_scan_scalar);
+	add_test("scan_index", &test_scan_index);
+}
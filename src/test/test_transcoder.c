@@ -0,0 +1,218 @@
+#include "test.h"
+
+#include "yambler_transcoder.h"
+#include "yambler_utility.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#define TRANSCODER_ROUNDS 20
+#define TRANSCODER_MAX_CHARS 300
+
+static const struct{
+	enum yambler_encoding encoding;
+	const char *bom;
+	size_t bom_length;
+} targets[] = {
+	{YAMBLER_ENCODING_UTF_8, "\xEF\xBB\xBF", 3},
+	{YAMBLER_ENCODING_UTF_16LE, "\xFF\xFE", 2},
+	{YAMBLER_ENCODING_UTF_16BE, "\xFE\xFF", 2},
+	{YAMBLER_ENCODING_UTF_32LE, "\xFF\xFE\x00\x00", 4},
+	{YAMBLER_ENCODING_UTF_32BE, "\x00\x00\xFE\xFF", 4}
+};
+
+#define TARGET_COUNT (sizeof(targets) / sizeof(targets[0]))
+
+static int generate_utf8(struct test_text *dest){
+	yambler_code_point code_points[TRANSCODER_MAX_CHARS];
+	size_t count;
+	test_random_code_points(code_points, TRANSCODER_MAX_CHARS, &count);
+	int result = test_text_append(dest, "", 0);
+	for(size_t i = 0; i < count && !result; ++i){
+		result = test_text_append_encoded(dest, code_points[i], YAMBLER_ENCODING_UTF_8);
+	}
+	return result;
+}
+
+static int write_all(int fd, const char *data, size_t length){
+	while(length != 0){
+		ssize_t count = write(fd, data, length);
+		if(count <= 0){
+			return test_fail("unable to write the input");
+		}
+		data += count;
+		length -= (size_t)count;
+	}
+	return 0;
+}
+
+/*
+ * Transcodes data from a temporary file, or from a pipe when pipe_input is set, into another temporary file and
+ * reads back what was written
+ */
+static int transcode(const struct test_text *data, enum yambler_encoding input_encoding, enum yambler_encoding output_encoding, yambler_encoder_flag options, size_t buffer_size, int pipe_input, struct test_text *dest, yambler_status *status){
+	FILE *input = NULL;
+	int pipe_fds[2] = {-1, -1};
+	int in;
+	if(pipe_input){
+		/* the input is small enough to fit into the pipe */
+		if(pipe(pipe_fds) == -1){
+			return test_fail("unable to create a pipe");
+		}
+		if(write_all(pipe_fds[1], data->data, data->length)){
+			close(pipe_fds[0]);
+			close(pipe_fds[1]);
+			return 1;
+		}
+		close(pipe_fds[1]);
+		in = pipe_fds[0];
+	}else{
+		input = tmpfile();
+		if(input == NULL){
+			return test_fail("unable to create the input file");
+		}
+		in = fileno(input);
+		if(write_all(in, data->data, data->length) || lseek(in, 0, SEEK_SET) != 0){
+			fclose(input);
+			return 1;
+		}
+	}
+	FILE *output = tmpfile();
+	if(output == NULL){
+		if(input){
+			fclose(input);
+		}else{
+			close(pipe_fds[0]);
+		}
+		return test_fail("unable to create the output file");
+	}
+	int out = fileno(output);
+	*status = yambler_transcode_fd(NULL, in, input_encoding, out, output_encoding, options, buffer_size);
+	int result = lseek(out, 0, SEEK_SET) != 0 || test_text_append(dest, "", 0);
+	while(!result){
+		char buffer[4096];
+		ssize_t count = read(out, buffer, sizeof(buffer));
+		if(count <= 0){
+			result = count < 0;
+			break;
+		}
+		result = test_text_append(dest, buffer, (size_t)count);
+	}
+	fclose(output);
+	if(input){
+		fclose(input);
+	}else{
+		close(pipe_fds[0]);
+	}
+	return result ? test_fail("unable to read the output") : 0;
+}
+
+static int compare(const struct test_text *output, const struct test_text *expected, const char *what){
+	if(output->length != expected->length || memcmp(output->data, expected->data, expected->length) != 0){
+		return test_fail("%s: %zu bytes differ from the %zu expected", what, output->length, expected->length);
+	}
+	return 0;
+}
+
+/*
+ * UTF-8 is transcoded to the other encodings with buffers of a few characters, the bytes have to be those of iconv
+ */
+static int test_transcoder_utf8(){
+	static const size_t buffer_sizes[] = {4, 7, 0};
+	int result = 0;
+	for(int round = 0; round < TRANSCODER_ROUNDS && !result; ++round){
+		struct test_text data = {NULL, 0, 0};
+		result = generate_utf8(&data);
+		for(size_t i = 1; i < TARGET_COUNT && !result; ++i){
+			int bom = round % 2;
+			struct test_text expected = {NULL, 0, 0};
+			result = test_text_append(&expected, "", 0) || (bom && test_text_append(&expected, targets[i].bom, targets[i].bom_length));
+			if(!result && test_iconv(yambler_encoding_name(targets[i].encoding), "UTF-8", data.data, data.length, &expected)){
+				result = test_fail("iconv rejects the input");
+			}
+			for(size_t j = 0; j < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]) && !result; ++j){
+				char what[64];
+				snprintf(what, sizeof(what), "%s, round %d, buffer %zu", yambler_encoding_name(targets[i].encoding), round, buffer_sizes[j]);
+				struct test_text output = {NULL, 0, 0};
+				yambler_status status;
+				result = transcode(&data, YAMBLER_ENCODING_UTF_8, targets[i].encoding, bom ? YAMBLER_ENCODER_INCLUDE_BOM : 0, buffer_sizes[j], 0, &output, &status);
+				if(!result && status){
+					result = test_fail("%s: transcoding ended with '%s'", what, yambler_status_message(status));
+				}
+				result = result || compare(&output, &expected, what);
+				test_text_free(&output);
+			}
+			test_text_free(&expected);
+		}
+		test_text_free(&data);
+	}
+	return result;
+}
+
+/*
+ * Input that is already in the output encoding is copied byte for byte, from a file and from a pipe, except for the
+ * byte order mark: a detected one is dropped, one of an explicit encoding only when the encoder adds its own
+ */
+static int test_transcoder_pass_through(){
+	static const struct{
+		int input_bom;
+		int detect;
+		yambler_encoder_flag options;
+		int output_bom;
+	} cases[] = {
+		{0, 0, 0, 0},
+		{1, 0, 0, 1},
+		{0, 0, YAMBLER_ENCODER_INCLUDE_BOM, 1},
+		{1, 0, YAMBLER_ENCODER_INCLUDE_BOM, 1},
+		{1, 1, 0, 0},
+		{1, 1, YAMBLER_ENCODER_INCLUDE_BOM, 1}
+	};
+	static const size_t encodings[] = {0, 1, 4};
+	int result = 0;
+	for(int round = 0; round < TRANSCODER_ROUNDS && !result; ++round){
+		struct test_text utf8 = {NULL, 0, 0};
+		result = generate_utf8(&utf8);
+		for(size_t i = 0; i < sizeof(encodings) / sizeof(encodings[0]) && !result; ++i){
+			size_t target = encodings[i];
+			struct test_text body = {NULL, 0, 0};
+			result = test_text_append(&body, "", 0);
+			if(!result && test_iconv(yambler_encoding_name(targets[target].encoding), "UTF-8", utf8.data, utf8.length, &body)){
+				result = test_fail("iconv rejects the input");
+			}
+			for(size_t j = 0; j < sizeof(cases) / sizeof(cases[0]) && !result; ++j){
+				struct test_text data = {NULL, 0, 0};
+				struct test_text expected = {NULL, 0, 0};
+				result = test_text_append(&data, "", 0) || test_text_append(&expected, "", 0);
+				result = result || (cases[j].input_bom && test_text_append(&data, targets[target].bom, targets[target].bom_length));
+				result = result || test_text_append(&data, body.data, body.length);
+				result = result || (cases[j].output_bom && test_text_append(&expected, targets[target].bom, targets[target].bom_length));
+				result = result || test_text_append(&expected, body.data, body.length);
+				for(int pipe_input = 0; pipe_input < 2 && !result; ++pipe_input){
+					char what[80];
+					snprintf(what, sizeof(what), "%s, round %d, case %zu%s", yambler_encoding_name(targets[target].encoding), round, j, pipe_input ? ", pipe" : "");
+					struct test_text output = {NULL, 0, 0};
+					yambler_status status;
+					enum yambler_encoding input_encoding = cases[j].detect ? YAMBLER_ENCODING_DETECT : targets[target].encoding;
+					result = transcode(&data, input_encoding, targets[target].encoding, cases[j].options, 0, pipe_input, &output, &status);
+					if(!result && status){
+						result = test_fail("%s: transcoding ended with '%s'", what, yambler_status_message(status));
+					}
+					result = result || compare(&output, &expected, what);
+					test_text_free(&output);
+				}
+				test_text_free(&expected);
+				test_text_free(&data);
+			}
+			test_text_free(&body);
+		}
+		test_text_free(&utf8);
+	}
+	return result;
+}
+
+void add_transcoder_tests(){
+	add_test("transcoder_utf8", &test_transcoder_utf8);
+	add_test("transcoder_pass_through", &test_transcoder_pass_through);
+}
@@ -0,0 +1,142 @@
+#include "test.h"
+
+#include "yambler_validator.h"
+
+#include <stdio.h>
+
+#define VALIDATOR_ROUNDS 400
+#define VALIDATOR_MAX_CHARS 300
+
+/*
+ * Sequences that are no UTF-8: a stray continuation byte, an overlong, a surrogate, a value past U+10FFFF, a byte
+ * that never occurs and a sequence cut short by an ASCII byte. The last ones are only invalid at the end of the input.
+ */
+static const char *const invalid_sequences[] = {"\x80", "\xC0\xAF", "\xED\xA0\x80", "\xF4\x90\x80\x80", "\xFF", "\xE2\x82\x41", "\xC3", "\xE2\x82", "\xF0\x9F\x98"};
+
+#define INVALID_SEQUENCE_COUNT (sizeof(invalid_sequences) / sizeof(invalid_sequences[0]))
+
+#define TRUNCATED_SEQUENCE_COUNT 3
+
+static const char *const valid_chars[] = {"a", " ", "\n", "\r\n", "\r", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80"};
+
+#define VALID_CHAR_COUNT (sizeof(valid_chars) / sizeof(valid_chars[0]))
+
+struct validator_case{
+	struct test_text text;
+	size_t offset;
+	size_t line;
+	size_t column;
+};
+
+/*
+ * Appends a valid character and counts the line and column it leaves the text at
+ */
+static int append_valid(struct validator_case *c, const char *data){
+	if(data[0] == '\n' || data[0] == '\r'){
+		/* a line feed after a carriage return ends the line the carriage return ended already */
+		if(data[0] == '\r' || c->text.length == 0 || c->text.data[c->text.length - 1] != '\r'){
+			++c->line;
+		}
+		c->column = 0;
+	}else{
+		++c->column;
+	}
+	return test_text_append_string(&c->text, data);
+}
+
+static int check_case(const struct validator_case *c, int valid, const char *what){
+	struct yambler_validation_error error = {0, 0, 0};
+	yambler_status status = yambler_validate((const yambler_byte *)c->text.data, c->text.length, &error);
+	if(valid){
+		if(status != YAMBLER_OK){
+			return test_fail("%s: valid text of %zu bytes is rejected at %zu", what, c->text.length, error.offset);
+		}
+		return 0;
+	}
+	if(status != YAMBLER_ENCODING_ERROR){
+		return test_fail("%s: invalid text of %zu bytes ended with '%s'", what, c->text.length, yambler_status_message(status));
+	}
+	if(error.offset != c->offset || error.line != c->line || error.column != c->column){
+		return test_fail("%s: error at %zu, line %zu, column %zu instead of %zu, line %zu, column %zu", what, error.offset, error.line, error.column, c->offset, c->line, c->column);
+	}
+	return 0;
+}
+
+/*
+ * An invalid sequence right at the start, on either side of the end of a 32 byte block, after the last whole block
+ * where only the scalar validator looks, and a sequence cut off by the end of the input
+ */
+static int test_validator_positions(){
+	static const struct{
+		size_t offset;
+		const char *sequence;
+		int at_end;
+	} cases[] = {
+		{0, "\x80", 0}, {0, "\xFF", 0}, {0, "\xC3", 1},
+		{31, "\x80", 0}, {32, "\x80", 0}, {33, "\x80", 0}, {30, "\xE2\x82\x41", 0}, {31, "\xE2\x82\x41", 0}, {31, "\xF4\x90\x80\x80", 0},
+		{63, "\xED\xA0\x80", 0}, {64, "\xC0\xAF", 0},
+		{66, "\xFF", 0}, {70, "\xE2\x82\x41", 0},
+		{40, "\xF0\x9F\x98", 1}, {64, "\xE2\x82", 1}, {95, "\xC3", 1}
+	};
+	int result = 0;
+	for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && !result; ++i){
+		struct validator_case c = {{NULL, 0, 0}, cases[i].offset, 0, 0};
+		result = test_text_append(&c.text, "", 0);
+		/* a line break of two bytes early on, the rest of the line is ASCII up to the sequence */
+		while(!result && c.text.length < cases[i].offset){
+			result = append_valid(&c, c.text.length == 5 && cases[i].offset > 8 ? "\r\n" : "a");
+		}
+		result = result || test_text_append_string(&c.text, cases[i].sequence);
+		/* the input ends in a truncated sequence, other ones are followed by valid text across another block */
+		for(size_t j = 0; !cases[i].at_end && j < 40 && !result; ++j){
+			result = test_text_append_string(&c.text, j % 7 ? "b" : "\xE2\x82\xAC");
+		}
+		char what[32];
+		snprintf(what, sizeof(what), "case %zu", i);
+		result = result || check_case(&c, 0, what);
+		test_text_free(&c.text);
+	}
+	return result;
+}
+
+/*
+ * Random text of all kinds of characters and line breaks, valid or with one invalid sequence anywhere in it
+ */
+static int test_validator_random(){
+	int result = 0;
+	for(int round = 0; round < VALIDATOR_ROUNDS && !result; ++round){
+		struct validator_case c = {{NULL, 0, 0}, 0, 0, 0};
+		size_t count = test_random(VALIDATOR_MAX_CHARS);
+		size_t position = test_random((uint32_t)count + 1);
+		int valid = round % 5 == 0;
+		size_t sequence = test_random(INVALID_SEQUENCE_COUNT);
+		if(sequence >= INVALID_SEQUENCE_COUNT - TRUNCATED_SEQUENCE_COUNT){
+			position = count;
+		}
+		result = test_text_append(&c.text, "", 0);
+		for(size_t i = 0; i <= count && !result; ++i){
+			if(i == position && !valid){
+				c.offset = c.text.length;
+				result = test_text_append_string(&c.text, invalid_sequences[sequence]);
+				break;
+			}
+			if(i < count){
+				result = append_valid(&c, valid_chars[test_random(VALID_CHAR_COUNT)]);
+			}
+		}
+		/* the text after the sequence does not move the error, lines are only counted up to it */
+		for(size_t i = position; i < count && !valid && !result && sequence < INVALID_SEQUENCE_COUNT - TRUNCATED_SEQUENCE_COUNT; ++i){
+			result = test_text_append_string(&c.text, valid_chars[test_random(VALID_CHAR_COUNT)]);
+		}
+		char what[32];
+		snprintf(what, sizeof(what), "round %d", round);
+		result = result || check_case(&c, valid, what);
+		test_text_free(&c.text);
+	}
+	return result;
+}
+
+void add_validator_tests(){
+	add_test("validator_positions", &test_validator_positions);
+	add_test("validator_random", &test_validator_random);
+}
@@ -5,6 +5,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
 yambler_status open_binary_file_for_read(yambler_decoder_state *state){
 	FILE *file = fopen(input_path, "rb");
 	if(file == NULL){
@@ -41,8 +47,71 @@ yambler_status binary_read(yambler_decoder_state state, yambler_byte *buffer, si
 	return YAMBLER_OK;
 }
 
+yambler_status map_input_file(const yambler_byte **data, size_t *length){
+	int fd = open(input_path, O_RDONLY);
+	if(fd == -1){
+		fprintf(stderr, "unable to open file for read '%s'\n", input_path);
+		return YAMBLER_ERROR;
+	}
+	struct stat file_stat;
+	if(fstat(fd, &file_stat) == -1){
+		fprintf(stderr, "unable to stat file '%s'\n", input_path);
+		close(fd);
+		return YAMBLER_ERROR;
+	}
+	*length = (size_t)file_stat.st_size;
+	if(*length == 0){
+		*data = "";
+		close(fd);
+		return YAMBLER_OK;
+	}
+	void *mapping = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED){
+		fprintf(stderr, "unable to map file '%s'\n", input_path);
+		return YAMBLER_ERROR;
+	}
+	madvise(mapping, *length, MADV_SEQUENTIAL);
+	*data = (const yambler_byte *)mapping;
+	return YAMBLER_OK;
+}
+
+void unmap_input_file(const yambler_byte *data, size_t length){
+	if(length != 0){
+		munmap((void *)data, length);
+	}
+}
+
 yambler_status binary_write(yambler_encoder_state state, const yambler_byte *buffer, size_t buffer_size, size_t *write_count){
 	FILE *file = (FILE *)state;
 	*write_count = fwrite(buffer, sizeof(yambler_byte), buffer_size, file);
 	return *write_count == buffer_size ? YAMBLER_OK : YAMBLER_ERROR;
 }
+
+yambler_status binary_writev(yambler_encoder_state state, const struct iovec *vectors, int vector_count, size_t *write_count){
+	FILE *file = (FILE *)state;
+	if(fflush(file)){
+		return YAMBLER_ERROR;
+	}
+	int fd = fileno(file);
+	ssize_t count = writev(fd, vectors, vector_count);
+	if(count == -1){
+		return YAMBLER_ERROR;
+	}
+	size_t written = (size_t)count;
+	*write_count = 0;
+	for(int i = 0; i < vector_count; ++i){
+		/* a short write leaves the rest of the vectors to plain writes */
+		size_t offset = written < vectors[i].iov_len ? written : vectors[i].iov_len;
+		written -= offset;
+		while(offset != vectors[i].iov_len){
+			count = write(fd, (const char *)vectors[i].iov_base + offset, vectors[i].iov_len - offset);
+			if(count == -1){
+				return YAMBLER_ERROR;
+			}
+			offset += (size_t)count;
+		}
+		*write_count += offset;
+	}
+	return YAMBLER_OK;
+}
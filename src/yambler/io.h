@@ -15,6 +15,12 @@ void close_binary_file(yambler_decoder_state *state);
 
 yambler_status binary_read(yambler_decoder_state state, yambler_byte *buffer, size_t buffer_size, size_t *read_count);
 
+yambler_status map_input_file(const yambler_byte **data, size_t *length);
+
+void unmap_input_file(const yambler_byte *data, size_t length);
+
 yambler_status binary_write(yambler_encoder_state state, const yambler_byte *buffer, size_t buffer_size, size_t *write_count);
 
+yambler_status binary_writev(yambler_encoder_state state, const struct iovec *vectors, int vector_count, size_t *write_count);
+
 #endif
@@ -1,41 +1,73 @@
 #include "yambler_type.h"
 #include "yambler_encoder.h"
 #include "yambler_decoder.h"
+#include "yambler_async_file.h"
 #include "yambler_input_buffer.h"
 #include "yambler_parser.h"
+#include "yambler_parallel_decoder.h"
+#include "yambler_transcoder.h"
+#include "yambler_validator.h"
 
 #include "options.h"
 #include "io.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-yambler_status print_yambler_string(struct yambler_string str){
+#include <fcntl.h>
+#include <unistd.h>
+
+/* the parse action fetches this many events per call */
+#define EVENT_BATCH_SIZE 64
+
+/* every object is created with the counting allocator, the verbose mode reports its statistics */
+static struct yambler_counting_allocator counting_allocator;
+
+/* a continued value is printed without the line break, so that its fragments join up */
+yambler_status print_yambler_string(struct yambler_string str, int continued){
 	char *buffer = malloc(str.length + 1);
 	if(buffer == NULL){
 		return YAMBLER_ALLOC_ERROR;
 	}
 	for(size_t i = 0; i < str.length; ++i){
+#ifndef YAMBLER_UTF8_CHARS
 		if(str.begin[i] < 256){
 			buffer[i] = (char)str.begin[i];
 		}
+#else
+		buffer[i] = (char)str.begin[i];
+#endif
 	}
 	buffer[str.length] = '\n';
-	fwrite(buffer, sizeof(char), str.length + 1, stdout);
+	fwrite(buffer, sizeof(char), continued ? str.length : str.length + 1, stdout);
 	free(buffer);
 	return YAMBLER_OK;
 }
 
+yambler_status create_decoder(yambler_decoder_p *decoder){
+	if(memory_map){
+		return yambler_decoder_create_from_file(decoder, &counting_allocator.allocator, input_path, input_encoding);
+	}else if(async_file && input_path[0] != '\0'){
+		return yambler_decoder_create_from_async_file(decoder, &counting_allocator.allocator, buffer_size * 64, input_path, input_encoding, direct_io ? YAMBLER_ASYNC_FILE_DIRECT : 0);
+	}else if(read_ahead){
+		return yambler_decoder_create_with_read_ahead(decoder, &counting_allocator.allocator, buffer_size * 64, input_encoding, &binary_read, NULL, &open_binary_file_for_read, &close_binary_file);
+	}else{
+		return yambler_decoder_create(decoder, &counting_allocator.allocator, buffer_size * 4, input_encoding, &binary_read, NULL, &open_binary_file_for_read, &close_binary_file);
+	}
+}
+
 yambler_status parse(){
 	yambler_decoder_p decoder;
-	yambler_status status = yambler_decoder_create(&decoder, buffer_size * 4, input_encoding, &binary_read, NULL, &open_binary_file_for_read, &close_binary_file);
+	yambler_status status = create_decoder(&decoder);
 	if(status){
 		fprintf(stderr, "unable to create decoder\n");
 		return status;
 	}
 
+	struct yambler_input_buffer_policy policy = {buffer_size, 0, 0, 0};
 	yambler_input_buffer_p buffer = NULL;
-	status = yambler_input_buffer_create_with_decoder(&buffer, buffer_size, decoder);
+	status = yambler_input_buffer_create_with_decoder(&buffer, &counting_allocator.allocator, &policy, decoder);
 	if(status){
 		fprintf(stderr, "unable to create input buffer\n");
 		yambler_decoder_destroy(&decoder);
@@ -43,12 +75,13 @@ yambler_status parse(){
 	}
 	
 	yambler_parser_p parser = NULL;
-	status = yambler_parser_create(&parser);
+	status = yambler_parser_create(&parser, &counting_allocator.allocator);
 	if(status){
 		fprintf(stderr, "unable to create parser\n");
 		yambler_input_buffer_destroy_all(&buffer, &decoder);
 		return status;
 	}
+	yambler_parser_set_fragments(parser, fragments);
 	
 	status = yambler_parser_open(parser, buffer);
 	if(status){
@@ -57,24 +90,53 @@ yambler_status parse(){
 		return status;
 	}
 
-	struct yambler_parser_event event;
+	struct yambler_parser_event events[EVENT_BATCH_SIZE];
+	size_t count;
+	int continuing = 0;
 	
 	do{
-		status = yambler_parser_parse(parser, &event);
-		if(status){
-			break;
+		status = yambler_parser_parse_batch(parser, events, EVENT_BATCH_SIZE, &count);
+		for(size_t i = 0; i < count; ++i){
+			const struct yambler_parser_event *event = &events[i];
+			switch(event->type){
+			case YAMBLER_PE_DOCUMENT_BEGIN:
+				printf("document begin\n");
+				break;
+			case YAMBLER_PE_DOCUMENT_END:
+				printf("document end\n");
+				break;
+			case YAMBLER_PE_MAP_BEGIN:
+				printf("map begin\n");
+				break;
+			case YAMBLER_PE_MAP_END:
+				printf("map end\n");
+				break;
+			case YAMBLER_PE_SEQUENCE_BEGIN:
+				printf("sequence begin\n");
+				break;
+			case YAMBLER_PE_SEQUENCE_END:
+				printf("sequence end\n");
+				break;
+			case YAMBLER_PE_SCALAR:
+				printf("scalar: ");
+				print_yambler_string(event->value, 0);
+				break;
+			case YAMBLER_PE_COMMENT:
+				if(!continuing){
+					printf("comment: ");
+				}
+				print_yambler_string(event->value, event->continued);
+				break;
+			default:
+				printf("unknown type: %d\n", (int)event->type);
+				break;
+			}
+			continuing = event->continued;
+			if(!continuing){
+				printf("parser run\n");
+			}
 		}
-		switch(event.type){
-		case YAMBLER_PE_COMMENT:
-			printf("comment: ");
-			print_yambler_string(event.value);
-			break;
-		default:
-			printf("unknown type: %d\n", (int)event.type);
-			break;
-		}
-		printf("parser run\n");
-	}while(1);
+	}while(status == YAMBLER_OK);
 	if(status == YAMBLER_EMPTY){
 		status = YAMBLER_OK;
 		printf("parser finished\n");
@@ -83,13 +145,47 @@ yambler_status parse(){
 		yambler_parser_get_error(parser, &error);
 		fprintf(stderr, "parser error '%s' at line %d, column %d\n", error.message, error.line, error.column);
 	}
+	if(verbosity == VERBOSITY_VERBOSE){
+		struct yambler_input_buffer_stats stats;
+		yambler_input_buffer_get_stats(buffer, &stats);
+		fprintf(stderr, "input buffer: %zu characters, high water %zu characters holding %zu, %zu grows, %zu compactions moving %zu characters, %zu retired blocks\n", stats.size, stats.high_water_size, stats.high_water_length, stats.grow_count, stats.compact_count, stats.compacted_length, stats.retire_count);
+	}
 	yambler_parser_destroy_all(&parser, &buffer, &decoder);
 	return status;
 }
 
+yambler_status write_chars(yambler_decoder_state state, const yambler_char *buffer, size_t count){
+	FILE *file = (FILE *)state;
+	return fwrite(buffer, sizeof(yambler_char), count, file) == count ? YAMBLER_OK : YAMBLER_ERROR;
+}
+
+yambler_status decode_parallel(){
+	const yambler_byte *data;
+	size_t length;
+	yambler_status status = map_input_file(&data, &length);
+	if(status){
+		return status;
+	}
+	FILE *file = fopen(output_path, "wb");
+	if(file == NULL){
+		fprintf(stderr,"unable to open output file '%s'\n", output_path);
+		unmap_input_file(data, length);
+		return YAMBLER_ERROR;
+	}
+	status = yambler_decode_parallel(&counting_allocator.allocator, data, length, input_encoding, thread_count, &write_chars, file);
+	if(fclose(file) && status == YAMBLER_OK){
+		status = YAMBLER_ERROR;
+	}
+	unmap_input_file(data, length);
+	return status;
+}
+
 yambler_status decode(){
+	if(parallel){
+		return decode_parallel();
+	}
 	yambler_decoder_p decoder;
-	yambler_status status = yambler_decoder_create(&decoder, buffer_size * 4, input_encoding, &binary_read, NULL, &open_binary_file_for_read, &close_binary_file);
+	yambler_status status = create_decoder(&decoder);
 	if(status){
 		fprintf(stderr, "unable to create decoder\n");
 		return status;
@@ -132,13 +228,21 @@ yambler_status decode(){
 yambler_status encode(){
 	yambler_encoder_p encoder;
 
-	yambler_status status = yambler_encoder_create(&encoder, buffer_size * 4, output_encoding, encoder_flags, &binary_write, NULL, &open_binary_file_for_write , &close_binary_file);
+	yambler_status status;
+	if(memory_map){
+		status = yambler_encoder_create_to_file(&encoder, &counting_allocator.allocator, output_path, output_encoding, encoder_flags);
+	}else if(vectored_write){
+		status = yambler_encoder_create_vectored(&encoder, &counting_allocator.allocator, buffer_size * 4, 0, output_encoding, encoder_flags, &binary_writev, NULL, &open_binary_file_for_write, &close_binary_file);
+	}else{
+		status = yambler_encoder_create(&encoder, &counting_allocator.allocator, buffer_size * 4, output_encoding, encoder_flags, &binary_write, NULL, &open_binary_file_for_write , &close_binary_file);
+	}
 	if(status){
 		fprintf(stderr,"unable to create encoder\n");
 		return status;
 	}
 
-	yambler_char *buffer = malloc(sizeof(yambler_byte) * buffer_size * 4);
+	size_t buffer_length = buffer_size * 4;
+	yambler_char *buffer = malloc(sizeof(yambler_char) * buffer_length);
 	if(buffer == NULL){
 		fprintf(stderr, "unable to allocate buffer\n");
 		yambler_encoder_destroy(&encoder);
@@ -150,24 +254,39 @@ yambler_status encode(){
 		fprintf(stderr,"unable to open input file '%s'\n", input_path);
 		free(buffer);
 		yambler_encoder_destroy(&encoder);
+		return YAMBLER_ERROR;
 	}
 
 	status = yambler_encoder_open(encoder);
 	if(status){
 		fprintf(stderr, "unable to open encoder\n");
+		fclose(file);
+		free(buffer);
+		yambler_encoder_destroy(&encoder);
 		return status;
 	}
 	
+	size_t length = 0;
 	while(1){
-		size_t count = fread(buffer, sizeof(yambler_char) ,buffer_size * 4, file);
+		size_t count = fread(buffer + length, sizeof(yambler_char), buffer_length - length, file);
 		if(count == 0){
+			if(length != 0){
+				/* the input ends in the middle of a character */
+				status = YAMBLER_ENCODING_ERROR;
+			}
 			break;
 		}
+		length += count;
 		size_t write_count;
-		status = yambler_encoder_encode(encoder, buffer, count, &write_count);
-		if(status || write_count == 0){
+		status = yambler_encoder_encode(encoder, buffer, length, &write_count);
+		if(status){
 			break;
 		}
+		length -= write_count;
+		memmove(buffer, buffer + write_count, length * sizeof(yambler_char));
+	}
+	if(status == YAMBLER_OK){
+		status = yambler_encoder_flush(encoder);
 	}
 	yambler_encoder_close(encoder);
 	fclose(file);
@@ -176,6 +295,44 @@ yambler_status encode(){
 	return status;
 }
 
+yambler_status validate(){
+	const yambler_byte *data;
+	size_t length;
+	yambler_status status = map_input_file(&data, &length);
+	if(status){
+		return status;
+	}
+	struct yambler_validation_error error;
+	status = yambler_validate(data, length, &error);
+	if(status == YAMBLER_OK){
+		printf("valid UTF-8\n");
+	}else{
+		fprintf(stderr, "invalid UTF-8 at byte offset %zu, line %zu, column %zu\n", error.offset, error.line, error.column);
+	}
+	unmap_input_file(data, length);
+	return status;
+}
+
+yambler_status transcode(){
+	int in = open(input_path, O_RDONLY);
+	if(in == -1){
+		fprintf(stderr,"unable to open input file '%s'\n", input_path);
+		return YAMBLER_ERROR;
+	}
+	int out = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(out == -1){
+		fprintf(stderr,"unable to open output file '%s'\n", output_path);
+		close(in);
+		return YAMBLER_ERROR;
+	}
+	yambler_status status = yambler_transcode_fd(&counting_allocator.allocator, in, input_encoding, out, output_encoding, encoder_flags, buffer_size * 16);
+	if(close(out) && status == YAMBLER_OK){
+		status = YAMBLER_ERROR;
+	}
+	close(in);
+	return status;
+}
+
 yambler_status execute_action(){
 	switch(action){
 	case ACTION_DECODE:
@@ -184,6 +341,10 @@ yambler_status execute_action(){
 		return parse();
 	case ACTION_ENCODE:
 		return encode();
+	case ACTION_VALIDATE:
+		return validate();
+	case ACTION_TRANSCODE:
+		return transcode();
 	default:
 		return YAMBLER_ERROR;
 	}
@@ -203,10 +364,15 @@ int main(int arg_count, char * const args[]){
 	if(action == ACTION_NONE){
 		return 0;
 	}else{
+		yambler_counting_allocator_init(&counting_allocator, NULL);
 		status = execute_action();
 		if(status){
 			printf("error: %s\n", yambler_status_message(status));
 		}
+		if(verbosity == VERBOSITY_VERBOSE){
+			const struct yambler_allocator_stats *stats = &counting_allocator.stats;
+			fprintf(stderr, "memory: %zu allocations, %zu reallocations, %zu releases, %zu bytes allocated, peak %zu bytes, %zu bytes still in use\n", stats->allocations, stats->reallocations, stats->releases, stats->total_bytes, stats->peak_bytes_in_use, stats->bytes_in_use);
+		}
 		return (int)status;
 	}
 }
@@ -1,5 +1,7 @@
 #include "options.h"
 
+#include "yambler_utility.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,7 +25,23 @@ enum yambler_encoding output_encoding = YAMBLER_ENCODING_UTF_8;
 
 yambler_encoder_flag encoder_flags = 0;
 
-#define OPT_STRING "devbp"
+int memory_map = 0;
+
+int read_ahead = 0;
+
+int async_file = 0;
+
+int direct_io = 0;
+
+int vectored_write = 0;
+
+int parallel = 0;
+
+size_t thread_count = 0;
+
+int fragments = 0;
+
+#define OPT_STRING "devbpmcruDPj:tF:T:wf"
 
 static struct option options[] = {
 	{"decode",0,NULL,ACTION_DECODE},
@@ -31,6 +49,18 @@ static struct option options[] = {
 	{"verbose",0,NULL, VERBOSITY_VERBOSE},
 	{"bom",0,NULL,'b'},
 	{"parse",0, NULL, ACTION_PARSE},
+	{"mmap",0,NULL,'m'},
+	{"validate",0,NULL,ACTION_VALIDATE},
+	{"read-ahead",0,NULL,'r'},
+	{"uring",0,NULL,'u'},
+	{"direct",0,NULL,'D'},
+	{"parallel",0,NULL,'P'},
+	{"jobs",1,NULL,'j'},
+	{"transcode",0,NULL,ACTION_TRANSCODE},
+	{"from",1,NULL,'F'},
+	{"to",1,NULL,'T'},
+	{"writev",0,NULL,'w'},
+	{"fragments",0,NULL,'f'},
 	{NULL, 0, NULL, 0}
 };
 
@@ -46,6 +76,8 @@ yambler_status parse_options(int arg_count, char * const args[]){
 		case ACTION_DECODE:
 		case ACTION_ENCODE:
 		case ACTION_PARSE:
+		case ACTION_VALIDATE:
+		case ACTION_TRANSCODE:
 			action = result;
 			break;
 		case VERBOSITY_VERBOSE:
@@ -54,6 +86,51 @@ yambler_status parse_options(int arg_count, char * const args[]){
 		case 'b':
 			encoder_flags |= YAMBLER_ENCODER_INCLUDE_BOM;
 			break;
+		case 'm':
+			memory_map = 1;
+			break;
+		case 'r':
+			read_ahead = 1;
+			break;
+		case 'u':
+			async_file = 1;
+			break;
+		case 'D':
+			async_file = 1;
+			direct_io = 1;
+			break;
+		case 'P':
+			parallel = 1;
+			break;
+		case 'w':
+			vectored_write = 1;
+			break;
+		case 'f':
+			fragments = 1;
+			break;
+		case 'j':{
+			char *end;
+			long count = strtol(optarg, &end, 10);
+			if(*end != '\0' || count < 0){
+				fprintf(stderr, "invalid number of jobs: '%s'\n", optarg);
+				return YAMBLER_ERROR;
+			}
+			parallel = 1;
+			thread_count = (size_t)count;
+			break;
+		}
+		case 'F':
+			if(yambler_encoding_from_name(optarg, &input_encoding)){
+				fprintf(stderr, "unknown encoding: '%s'\n", optarg);
+				return YAMBLER_ERROR;
+			}
+			break;
+		case 'T':
+			if(yambler_encoding_from_name(optarg, &output_encoding)){
+				fprintf(stderr, "unknown encoding: '%s'\n", optarg);
+				return YAMBLER_ERROR;
+			}
+			break;
 		default:
 			return YAMBLER_ERROR;
 		}
@@ -117,12 +194,16 @@ void parse_interactive(){
 		printf("'d' : decode the input file and store the result into the output file\n");
 		printf("'e' : encode the input file and store the result into the output file\n");
 		printf("'p' : parse the input file and store the result into the output file\n");
+		printf("'c' : check that the input file is valid UTF-8\n");
+		printf("'t' : transcode the input file into the output encoding and store the result into the output file\n");
 			char *result = fgets(buffer, 3, stdin);
 			if(result != NULL && buffer[1] == '\n'){
 				switch(buffer[0]){
 				case ACTION_DECODE:
 				case ACTION_ENCODE:
 				case ACTION_PARSE:
+				case ACTION_VALIDATE:
+				case ACTION_TRANSCODE:
 					action = buffer[0];
 					retry = 0;
 					break;
@@ -151,6 +232,12 @@ void print_options(){
 	case ACTION_DECODE:
 		printf("action: decode\n");
 		break;
+	case ACTION_VALIDATE:
+		printf("action: validate\n");
+		break;
+	case ACTION_TRANSCODE:
+		printf("action: transcode from %s to %s\n", input_encoding == YAMBLER_ENCODING_DETECT ? "detected encoding" : yambler_encoding_name(input_encoding), yambler_encoding_name(output_encoding));
+		break;
 	}
 	if(input_path == NULL){
 		printf("input path: <to be supplied by user>\n");
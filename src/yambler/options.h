@@ -10,6 +10,8 @@
 #define ACTION_DECODE 'd'
 #define ACTION_ENCODE 'e'
 #define ACTION_PARSE 'p'
+#define ACTION_VALIDATE 'c'
+#define ACTION_TRANSCODE 't'
 
 extern int action;
 
@@ -35,6 +37,22 @@ extern enum yambler_encoding output_encoding;
 
 extern yambler_encoder_flag encoder_flags;
 
+extern int memory_map;
+
+extern int read_ahead;
+
+extern int async_file;
+
+extern int direct_io;
+
+extern int vectored_write;
+
+extern int parallel;
+
+extern size_t thread_count;
+
+extern int fragments;
+
 yambler_status parse_options(int arg_count, char * const args[]);
 
 void parse_interactive();